@@ -1,6 +1,7 @@
 import { Id } from '~selva/schema/index'
 
 import * as redis from '../redis'
+import { hget, hkeys } from './prefetch'
 import { GetResult } from '~selva/get/types'
 import {
   setNestedResult,
@@ -53,7 +54,7 @@ const number = (
   _merge?: boolean,
   _mergeProps?: any
 ): boolean => {
-  const v = redis.hget(id, field)
+  const v = hget(id, field)
   if (
     tryResolveSimpleRef(
       result,
@@ -97,7 +98,7 @@ const int = (
   _merge?: boolean,
   _mergeProps?: any
 ): boolean => {
-  const v = redis.hget(id, field)
+  const v = hget(id, field)
 
   if (
     tryResolveSimpleRef(
@@ -129,7 +130,7 @@ const boolean = (
   _merge?: boolean,
   _mergeProps?: any
 ): true => {
-  const v = redis.hget(id, field)
+  const v = hget(id, field)
 
   if (
     tryResolveSimpleRef(
@@ -160,7 +161,7 @@ const string = (
   _merge?: boolean,
   _mergeProps?: any
 ): boolean => {
-  const value = redis.hget(id, field) || ''
+  const value = hget(id, field) || ''
 
   if (
     tryResolveSimpleRef(
@@ -218,7 +219,7 @@ const json = (
   _merge?: boolean,
   _mergeProps?: any
 ): boolean => {
-  let value = redis.hget(id, field)
+  let value = hget(id, field)
 
   if (!value) {
     return false
@@ -260,7 +261,7 @@ const array = (
   _merge?: boolean,
   _mergeProps?: any
 ): boolean => {
-  const value = redis.hget(id, field)
+  const value = hget(id, field)
   let decoded: never[] | null =
     type(value) === 'string' ? cjson.decode(value) : null
   if (decoded === null) {
@@ -292,7 +293,7 @@ const object = (
   merge?: boolean,
   mergeProps?: any
 ): boolean => {
-  const keys = redis.hkeys(id)
+  const keys = hkeys(id, field)
 
   let isComplete = true
   let noKeys = true
@@ -374,7 +375,7 @@ const record = (
   merge?: boolean,
   mergeProps?: any
 ): boolean => {
-  const keys = redis.hkeys(id)
+  const keys = hkeys(id, field)
 
   table.sort(keys)
   let isComplete = true
@@ -459,13 +460,13 @@ const text = (
       return true
     }
   } else {
-    const value = redis.hget(id, field + '.' + language)
+    const value = hget(id, field + '.' + language)
     if (value && value !== '') {
       setNestedResult(result, field, value)
       return true
     } else if (schema.languages) {
       for (const lang of schema.languages) {
-        const value = redis.hget(id, field + '.' + lang)
+        const value = hget(id, field + '.' + lang)
         if (value && value !== '') {
           setNestedResult(result, field, value)
           return true
@@ -543,7 +544,7 @@ const geo = (
   _language?: string,
   _version?: string
 ): true => {
-  const coord = redis.hget(id, field)
+  const coord = hget(id, field)
   const [lon, lat] = splitString(coord, ',')
 
   setNestedResult(result, field, { lat: tonumber(lat), lon: tonumber(lon) })
@@ -624,7 +625,7 @@ function getByType(
 
   // TODO: remove: hackedy hack
   if (prop.type === 'record' || prop.type === 'object') {
-    const val = redis.hget(id, field)
+    const val = hget(id, field)
     if (val === '___selva_$set') {
       return false
     }
@@ -13,11 +13,37 @@ import makeNewGetOptions from './all'
 import getQuery from './query/index'
 import checkSingleReference from './reference'
 import * as r from '../redis'
+import { prefetch, resetPrefetch } from './prefetch'
 
 import global from '../globals'
 
 // add error handling
 
+// the plain fields of props are read with one selva.get instead of an hget each
+function prefetchFields(props: GetItem, id: Id, field?: string): void {
+  const paths: string[] = []
+  for (const key in props) {
+    if (key[0] !== '$') {
+      const value = props[key]
+      if (
+        value === true ||
+        (typeof value === 'object' &&
+          !isArray(value) &&
+          !value.$list &&
+          !value.$find &&
+          !value.$id &&
+          !value.$field &&
+          !value.$value)
+      ) {
+        paths[paths.length] =
+          field && field.length > 0 ? field + '.' + key : key
+      }
+    }
+  }
+
+  prefetch(id, paths)
+}
+
 function getField(
   props: GetItem,
   schema: Schema,
@@ -235,6 +261,8 @@ function getField(
         return true
       }
 
+      prefetchFields(props, id, field)
+
       for (const key in props) {
         if (key[0] !== '$') {
           hasKeys = true
@@ -424,6 +452,8 @@ function get(opts: GetOptions): GetResult {
   const schema = getSchema()
   const result: GetResult = {}
 
+  resetPrefetch()
+
   let {
     $version: version,
     $id: ids,
@@ -0,0 +1,108 @@
+import { Id } from '~selva/schema/index'
+import * as redis from '../redis'
+
+type Prefetched = {
+  paths: string[]
+  values: Record<string, string>
+}
+
+// scripts share one Lua state, so this has to be reset for every get
+let prefetched: Record<Id, Prefetched> = {}
+
+export function resetPrefetch(): void {
+  prefetched = {}
+}
+
+function flatten(
+  values: Record<string, string>,
+  reply: any[],
+  prefix: string
+): void {
+  for (let i = 0; i < reply.length; i += 2) {
+    const value = reply[i + 1]
+    if (reply[i] === '') {
+      // the value of an object that also has nested fields
+      values[string.sub(prefix, 1, prefix.length - 1)] = value
+    } else if (type(value) === 'table') {
+      flatten(values, value, prefix + reply[i] + '.')
+    } else {
+      values[prefix + reply[i]] = value
+    }
+  }
+}
+
+function isCovered(id: Id, field: string): Prefetched | undefined {
+  const fetched = prefetched[id]
+  if (!fetched) {
+    return undefined
+  }
+
+  for (const path of fetched.paths) {
+    if (field === path || field.indexOf(path + '.') === 0) {
+      return fetched
+    }
+  }
+
+  return undefined
+}
+
+// reads the fields under paths of id with one selva.get, the hget and hkeys
+// below answer from it for anything under those paths
+export function prefetch(id: Id, paths: string[]): void {
+  const missing: string[] = []
+  for (const path of paths) {
+    if (!isCovered(id, path)) {
+      missing[missing.length] = path
+    }
+  }
+
+  // a single field is cheaper to read with one hget
+  if (missing.length < 2) {
+    return
+  }
+
+  const reply = redis.selvaGet(id, table.concat(missing, ','))
+  const values: Record<string, string> = {}
+  if (reply) {
+    flatten(values, reply, '')
+  }
+
+  const fetched = prefetched[id]
+  if (fetched) {
+    for (const path of missing) {
+      fetched.paths[fetched.paths.length] = path
+    }
+    for (const key in values) {
+      fetched.values[key] = values[key]
+    }
+  } else {
+    prefetched[id] = { paths: missing, values }
+  }
+}
+
+export function hget(id: Id, field: string): string {
+  const fetched = isCovered(id, field)
+  if (fetched) {
+    return fetched.values[field]
+  }
+
+  return redis.hget(id, field)
+}
+
+// the keys of id, only complete for the keys under field
+export function hkeys(id: Id, field: string): string[] {
+  const fetched = isCovered(id, field)
+  if (!fetched) {
+    return redis.hkeys(id)
+  }
+
+  const keys: string[] = []
+  const checkField = field + '.'
+  for (const key in fetched.values) {
+    if (key.indexOf(checkField) === 0) {
+      keys[keys.length] = key
+    }
+  }
+
+  return keys
+}
@@ -25,12 +25,16 @@ function createSearchArgs(
   }
   let offset = 0
   let limit = isNoList ? 1 : 99999
-  if ($list.$limit) {
-    limit = $list.$limit
-  }
 
-  if ($list.$offset) {
-    offset = $list.$offset
+  // a page after a cursor is cut by parseList
+  if ($list.$cursor === undefined) {
+    if ($list.$limit) {
+      limit = $list.$limit
+    }
+
+    if ($list.$offset) {
+      offset = $list.$offset
+    }
   }
 
   const sort: string[] = []
@@ -0,0 +1,119 @@
+import { Fork, FilterAST, Value } from './types'
+import { isFork, convertNow } from './util'
+import { isArray, stringStartsWith } from '../../util'
+
+// keeps the number of arguments to redis.pcall below the unpack limit
+const MAX_IDS_PER_CALL = 4096
+// a single result usually matches early, so don't evaluate every candidate
+const MAX_IDS_PER_SINGLE_CALL = 64
+
+const toNumberValue = (value: string | number): string | number => {
+  if (type(value) === 'string' && stringStartsWith(<string>value, 'now')) {
+    return convertNow(<string>value)
+  }
+  return value
+}
+
+// the module has no clock of its own, so 'now' is resolved here
+function resolveNow(node: Fork | FilterAST): Fork | FilterAST {
+  if (isFork(node)) {
+    const fork: Fork = { isFork: true }
+    if (node.$and) {
+      fork.$and = []
+      for (let i = 0; i < node.$and.length; i++) {
+        fork.$and[i] = resolveNow(node.$and[i])
+      }
+    }
+    if (node.$or) {
+      fork.$or = []
+      for (let i = 0; i < node.$or.length; i++) {
+        fork.$or[i] = resolveNow(node.$or[i])
+      }
+    }
+    return fork
+  }
+
+  if (!node.hasNow) {
+    return node
+  }
+
+  let $value: Value
+  if (isArray(node.$value)) {
+    $value = []
+    for (let i = 0; i < node.$value.length; i++) {
+      $value[i] = toNumberValue(node.$value[i])
+    }
+  } else {
+    $value = toNumberValue(node.$value)
+  }
+
+  return {
+    $field: node.$field,
+    $operator: node.$operator,
+    $search: node.$search,
+    $value
+  }
+}
+
+// A find over a known set of ids ($traverse, references or an id list) has
+// its candidates in an id filter; evaluate the rest of the filter against
+// them in the module instead of building an ft.search query.
+// With single set, stops after the first match.
+// Returns null if the filter needs the search index.
+export default function findNative(
+  fork: Fork,
+  single: boolean = false
+): string[] | null {
+  if (!fork.$and) {
+    return null
+  }
+
+  let ids: string[] | undefined
+  const rest: (Fork | FilterAST)[] = []
+  for (let i = 0; i < fork.$and.length; i++) {
+    const filter = fork.$and[i]
+    if (
+      !ids &&
+      !isFork(filter) &&
+      filter.$field === 'id' &&
+      filter.$operator === '=' &&
+      isArray(filter.$value)
+    ) {
+      ids = <string[]>filter.$value
+    } else {
+      rest[rest.length] = resolveNow(filter)
+    }
+  }
+
+  if (!ids || ids.length === 0) {
+    return null
+  }
+
+  const encoded = cjson.encode({ isFork: true, $and: rest })
+  const result: string[] = []
+  const chunkSize = single ? MAX_IDS_PER_SINGLE_CALL : MAX_IDS_PER_CALL
+  for (let i = 0; i < ids.length; i += chunkSize) {
+    const chunk: string[] = []
+    for (let j = i; j < ids.length && j < i + chunkSize; j++) {
+      chunk[chunk.length] = ids[j]
+    }
+
+    // a filter the module can't evaluate is the only error answer expected
+    const matches = redis.pcall('selva.find.filter', encoded, ...chunk)
+    if (matches.err === 'ERR unsupported filter') {
+      return null
+    } else if (matches.err) {
+      error(matches.err)
+    }
+
+    if (single && matches.length > 0) {
+      return [matches[0]]
+    }
+
+    for (let j = 0; j < matches.length; j++) {
+      result[result.length] = matches[j]
+    }
+  }
+
+  return result
+}
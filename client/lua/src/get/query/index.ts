@@ -9,6 +9,7 @@ import { isFork, getFind } from './util'
 import { emptyArray, ensureArray, isArray, splitString } from '../../util'
 import { GetFieldFn } from '../types'
 import parseList from './parseList'
+import findNative from './findNative'
 import { Schema } from '../../../../src/schema/index'
 import parseSubscriptions from './parseSubscriptions'
 import { setNestedResult, setMeta } from '../nestedFields'
@@ -107,8 +108,19 @@ const parseQuery = (
     }
   }
 
-  if (resultFork) {
-    let noLimitAndOffset = true
+  const nativeIds = resultFork && findNative(resultFork, !getOptions.$list)
+
+  const hasCursor =
+    typeof getOptions.$list === 'object' &&
+    getOptions.$list.$cursor !== undefined
+
+  if (nativeIds) {
+    resultIds = nativeIds
+    if (getOptions.$list) {
+      resultIds = parseList(resultIds, getOptions.$list, false, meta)
+    }
+  } else if (resultFork) {
+    let noLimitAndOffset = !hasCursor
     const idMap: Record<string, true> = {}
     const [queries, err] = createSearchString(resultFork, language)
 
@@ -160,19 +172,25 @@ const parseQuery = (
       typeof getOptions.$list === 'object' &&
       (getOptions.$list.$limit ||
         getOptions.$list.$offset ||
-        getOptions.$list.$sort)
+        getOptions.$list.$sort ||
+        hasCursor)
     ) {
       for (const id in idMap) {
         resultIds[resultIds.length] = id
       }
-      resultIds = parseList(resultIds, getOptions.$list, noLimitAndOffset)
+      resultIds = parseList(
+        resultIds,
+        getOptions.$list,
+        noLimitAndOffset,
+        meta
+      )
     } else {
       for (const id in idMap) {
         resultIds[resultIds.length] = id
       }
     }
   } else if (getOptions.$list) {
-    resultIds = parseList(resultIds, getOptions.$list)
+    resultIds = parseList(resultIds, getOptions.$list, false, meta)
     if (resultIds.length === 0) {
       resultIds = []
     }
@@ -421,6 +439,10 @@ const queryGet = (
 
   let { results, meta } = r
 
+  if (meta && meta.cursor !== undefined) {
+    setNestedResult(result, resultField + '$cursor', meta.cursor)
+  }
+
   if ((!results.length || results.length === 0) && !getOptions.$find) {
     setNestedResult(result, resultField, emptyArray())
 
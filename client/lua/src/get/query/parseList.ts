@@ -1,82 +1,80 @@
-import { GetOptions, GetResult, Sort, List } from '~selva/get/types'
-import { hget } from '../../redis'
-import { emptyArray, isArray } from '../../util'
-import * as logger from '../../logger'
+import { Sort, List } from '~selva/get/types'
+import { isArray } from '../../util'
 import { getSearchIndexes } from '../../schema/index'
+import { Meta } from './types'
 
 function parseList(
   results: string[],
   list: List,
-  noLimitAndOffset: boolean = false
+  noLimitAndOffset: boolean = false,
+  meta?: Meta
 ): string[] {
-  if (typeof list === 'object') {
-    if (list.$sort) {
-      const sort: Sort[] = !isArray(list.$sort) ? [list.$sort] : list.$sort
-
-      const searchIndexes = getSearchIndexes() // need to pass these to ast parser  (schema)
+  if (typeof list !== 'object') {
+    return results
+  }
 
-      // FIXME: multiple
-      const field = sort[0].$field
+  const cursor = list.$cursor
+  if (results.length === 0) {
+    if (cursor !== undefined && meta) {
+      meta.cursor = ''
+    }
+    return results
+  }
 
-      const type = searchIndexes.default[field]
+  const args: (string | number)[] = []
 
-      if (!field) {
-        logger.info(`${field} is not sortable`)
-        return results
-      }
+  if (!noLimitAndOffset && (list.$limit || list.$offset)) {
+    if (list.$offset) {
+      args[args.length] = 'OFFSET'
+      args[args.length] = list.$offset
+    }
 
-      if (type[0] === 'NUMERIC') {
-        if (sort[0].$order === 'asc') {
-          table.sort(results, (a, b) => {
-            const x = hget(a, field)
-            const y = hget(b, field)
-            return (tonumber(x) || 0) < (tonumber(y) || 0)
-          })
-        } else {
-          table.sort(results, (a, b) => {
-            const x = hget(a, field)
-            const y = hget(b, field)
-            return (tonumber(x) || 0) > (tonumber(y) || 0)
-          })
-        }
-      } else {
-        if (sort[0].$order === 'asc') {
-          table.sort(results, (a, b) => {
-            const x = hget(a, field)
-            const y = hget(b, field)
-            return (tostring(x) || 0) < (tostring(y) || 0)
-          })
-        } else {
-          table.sort(results, (a, b) => {
-            const x = hget(a, field)
-            const y = hget(b, field)
-            return (tostring(x) || 0) > (tostring(y) || 0)
-          })
-        }
-      }
+    if (list.$limit) {
+      args[args.length] = 'LIMIT'
+      args[args.length] = list.$limit
     }
+  }
 
-    if (!noLimitAndOffset && (list.$limit || list.$offset)) {
-      let start = 0
-      let end = results.length
+  // the reply starts with the cursor of the next page, '' after the last one
+  if (cursor !== undefined) {
+    args[args.length] = 'CURSOR'
+    args[args.length] = cursor
+  }
 
-      if (list.$offset) {
-        start = list.$offset
-      }
+  if (list.$sort) {
+    const sort: Sort[] = !isArray(list.$sort) ? [list.$sort] : list.$sort
+    const searchIndexes = getSearchIndexes() // need to pass these to ast parser  (schema)
+
+    for (let i = 0; i < sort.length; i++) {
+      const field = sort[i].$field
+      const search = searchIndexes.default && searchIndexes.default[field]
+
+      args[args.length] = 'SORT'
+      args[args.length] = field
+      args[args.length] = sort[i].$order === 'asc' ? 'ASC' : 'DESC'
+      args[args.length] = search && search[0] === 'NUMERIC' ? 'NUMERIC' : 'STRING'
+    }
+  }
+
+  if (args.length === 0) {
+    return results
+  }
 
-      if (list.$limit) {
-        end = start + list.$limit
-      }
+  // each sort key is read once and $limit keeps only the top of the list
+  const sorted: string[] = redis.call(
+    'selva.find.sort',
+    ...args,
+    table.concat(results, '\0')
+  )
 
-      const newResults: string[] = []
-      for (let i = start; i < end && i < results.length; i++) {
-        newResults[newResults.length] = results[i]
-      }
-      return newResults
+  if (cursor !== undefined) {
+    const next = table.remove(sorted, 1)
+    if (meta) {
+      meta.cursor = next
     }
   }
 
-  return results
+  return sorted
 }
 
 export default parseList
@@ -24,6 +24,7 @@ export type Meta = {
   ids: string[]
   type?: string[]
   parsedIds?: { [key: string]: string[] }
+  cursor?: string
 }
 
 export type FieldSubscription = {
@@ -1,6 +1,6 @@
 import { Id, Schema } from '~selva/schema/index'
 import { GetResult } from '~selva/get/types'
-import * as redis from '../redis'
+import { hget } from './prefetch'
 import { setNestedResult, getNestedField } from '../get/nestedFields'
 import * as logger from '../logger'
 
@@ -24,7 +24,7 @@ export function resolveObjectRef(
   language?: string,
   version?: string
 ) {
-  const ref = redis.hget(id, `${field}.$ref`)
+  const ref = hget(id, `${field}.$ref`)
   if (!ref || ref.length === 0) {
     return false
   }
@@ -46,33 +46,18 @@ export function cleanUpSuggestions(id: string, field: string) {
     ) {
       const langs = schema.languages
       if (langs) {
+        const pairs: string[] = []
         for (const lang of langs) {
           const content = r.hget(id, base + '.' + lang)
           if (content) {
-            const words = splitString(content.toLowerCase(), ' ')
-            for (let i = words.length - 1; i >= 0; i--) {
-              let searchTerms: string = ''
-              for (let j = 0; j <= i; j++) {
-                searchTerms += words[j] + ' '
-              }
-
-              const str = searchTerms.substr(0, searchTerms.length - 1)
-
-              const current: number = redis.call(
-                'hincrby',
-                `sug_counts`,
-                str,
-                '-1'
-              )
-
-              if (current === 0) {
-                redis.call('hdel', `sug_counts`, str)
-                redis.pcall('ft.sugdel', `sug`, str)
-              } else {
-              }
-            }
+            pairs[pairs.length] = content
+            pairs[pairs.length] = ''
           }
         }
+
+        if (pairs.length > 0) {
+          r.suggestionUpdate(...pairs)
+        }
       }
     }
   }
@@ -80,30 +65,20 @@ export function cleanUpSuggestions(id: string, field: string) {
 
 function cleanUpAliases(id: Id): void {
   const itemAliases = r.smembers(id + '.aliases')
-  for (const alias of itemAliases) {
-    r.hdel('___selva_aliases', alias)
+  if (itemAliases.length > 0) {
+    r.aliasDel(id, ...itemAliases)
   }
 }
 
 export function deleteItem(id: Id, hierarchy: boolean = true): boolean {
   if (hierarchy) {
-    const children = r.smembers(id + '.children')
-    const parents = r.smembers(id + '.parents')
-    for (let parent of parents) {
-      r.srem(parent + '.children', id)
-      // TODO: needed a parent update - slow now fix later
-      sendEvent(parent, 'children', 'update')
-    }
-    for (let child of children) {
-      const key = child + '.parents'
-      r.srem(key, id)
-      const size = r.scard(key)
-      if (size === 0) {
-        deleteItem(child)
-      } else {
-        markForAncestorRecalculation(child)
-      }
+    // the descendants left without parents are deleted in the module
+    const [deleted, changed] = r.deleteNode(id)
+    for (const child of changed) {
+      markForAncestorRecalculation(child)
     }
+
+    return deleted.length > 0
   }
 
   redis.pcall('FT.DEL', 'default', id)
@@ -259,7 +259,7 @@ function setField(
     redis.hset(id, field, strVal)
   }
 
-  addFieldToSearch(id, field, value)
+  addFieldToSearch(id, field, value, fromDefault ? undefined : current)
   sendEvent(id, field, 'update')
 }
 
@@ -1,5 +1,6 @@
 import { getSearchIndexes, getSchema } from '../schema/index'
 import * as logger from '../logger'
+import * as r from '../redis'
 import { SetOptions } from '~selva/set/types'
 import { getTypeFromId } from 'lua/src/typeIdMapping'
 import {
@@ -79,7 +80,8 @@ export function hasSearch(id: string, field: string): boolean {
 export function addFieldToSearch(
   id: string,
   field: string,
-  value: string
+  value: string,
+  previous?: string
 ): void {
   const searchIndex = getSearchIndexes()
 
@@ -249,21 +251,8 @@ export function addFieldToSearch(
             }
 
             if (index[fieldToCheck][0] === 'TEXT-LANGUAGE-SUG') {
-              // if suggestion, also add to dictionary
-              const words = splitString(escaped, ' ')
-              for (let i = words.length - 2; i >= 0; i--) {
-                let searchTerms: string = ''
-                for (let j = i; j < words.length; j++) {
-                  searchTerms += words[j] + ' '
-                }
-
-                const str = searchTerms.substr(0, searchTerms.length - 1)
-                addSuggestion(str, lang)
-              }
-
-              for (const word of words) {
-                addSuggestion(word, lang)
-              }
+              // if suggestion, also update the dictionary
+              r.suggestionUpdate(previous || '', tostring(value))
             }
           }
         }
@@ -271,10 +260,3 @@ export function addFieldToSearch(
     }
   }
 }
-
-function addSuggestion(sug: string, _lang: string) {
-  const current: number = redis.call('hincrby', `sug_counts`, sug, '1')
-  if (current === 1) {
-    redis.pcall('ft.sugadd', `sug`, sug, '1')
-  }
-}
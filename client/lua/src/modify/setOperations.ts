@@ -27,6 +27,19 @@ export function resetSet(
   source?: string | { $overwrite?: boolean | string[]; $name: string }
 ): void {
   const setKey = getSetKey(id, field)
+  const isReference =
+    hierarchy &&
+    (field === 'parents' || field === 'children' || field === 'aliases')
+
+  if (!isReference) {
+    const [added, removed] = redis.setReset(setKey, ...value)
+    if (added.length > 0 || removed.length > 0) {
+      markUpdated(id)
+      sendEvent(id, field, 'update')
+    }
+    return
+  }
+
   const current = redis.smembers(setKey)
   if (arrayIsEqual(current, value)) {
     return
@@ -38,7 +51,11 @@ export function resetSet(
     } else if (field === 'children') {
       value = resetChildren(id, setKey, value, modify, noRoot, source)
     } else if (field === 'aliases') {
+      // the module keeps the aliases set
       resetAlias(id, value)
+      markUpdated(id)
+      sendEvent(id, field, 'update')
+      return
     } else {
       redis.del(setKey)
     }
@@ -77,7 +94,11 @@ export function addToSet(
     } else if (field === 'children') {
       value = addToChildren(id, value, modify, noRoot, source)
     } else if (field === 'aliases') {
-      addAlias(id, value)
+      if (addAlias(id, value) > 0) {
+        markUpdated(id)
+        sendEvent(id, field, 'update')
+      }
+      return
     }
   }
 
@@ -359,15 +380,21 @@ export function addToChildren(
   return result
 }
 
-export function addAlias(id: string, value: Id[]): void {
-  for (const v of value) {
-    const current = redis.hget('___selva_aliases', v)
-    if (current !== id) {
-      redis.srem(current + '.aliases', v)
-    }
+// returns the number of aliases taken over by id
+export function addAlias(id: string, value: Id[]): number {
+  if (value.length === 0) {
+    return 0
+  }
 
-    redis.hset('___selva_aliases', v, id)
+  let changed = 0
+  const prev = redis.aliasSet(id, ...value)
+  for (const owner of prev) {
+    if (owner !== id) {
+      changed++
+    }
   }
+
+  return changed
 }
 
 export function resetChildren(
@@ -422,13 +449,21 @@ export function resetChildren(
 
 export function resetAlias(id: string, value: Id[]): void {
   const current = redis.smembers(id + '.aliases')
-  if (current) {
-    for (const v of current) {
-      redis.hdel('___selva_aliases', v)
+  const next: Record<string, true> = {}
+  for (const v of value) {
+    next[v] = true
+  }
+
+  const removed: string[] = []
+  for (const v of current) {
+    if (!next[v]) {
+      removed[removed.length] = v
     }
   }
 
-  redis.del(id + '.aliases')
+  if (removed.length > 0) {
+    redis.aliasDel(id, ...removed)
+  }
   addAlias(id, value)
 }
 
@@ -445,8 +480,6 @@ export function removeFromChildren(
   }
 }
 
-export function removeAlias(_id: string, value: Id[]): void {
-  for (const v of value) {
-    redis.hdel('___selva_aliases', v)
-  }
+export function removeAlias(id: string, value: Id[]): void {
+  redis.aliasDel(id, ...value)
 }
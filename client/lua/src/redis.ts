@@ -41,6 +41,12 @@ export function hkeys(key: string): string[] {
   return redis.call('hkeys', key)
 }
 
+// the fields under the comma separated dotted paths as nested key/value arrays,
+// false if the node doesn't exist
+export function selvaGet(key: string, fieldSpec: string): any[] | false {
+  return redis.call('selva.get', key, fieldSpec)
+}
+
 export function hset(
   key: string,
   fieldKey: string,
@@ -85,6 +91,40 @@ export function sadd(key: string, ...members: string[]): number {
   return result
 }
 
+// The selva module is loaded with the server, so its commands are called with
+// redis.call like the redis ones and an error reply fails the script
+
+// replaces the members of a set, returns the added and removed members
+export function setReset(key: string, ...members: string[]): string[][] {
+  return redis.call('selva.set.reset', key, ...members)
+}
+
+// points the aliases to id, taking them over from their current owners
+export function aliasSet(id: string, ...aliases: string[]): string[] {
+  return redis.call('selva.alias.set', id, ...aliases)
+}
+
+// deletes id and its descendants left without parents, returns the deleted ids
+// and the surviving children whose ancestors changed
+export function deleteNode(id: string): string[][] {
+  return redis.call('selva.delete', id, 'RECURSIVE')
+}
+
+// removes the aliases of id, the ones taken over by another node are only
+// removed from the aliases of id
+export function aliasDel(id: string, ...aliases: string[]): number {
+  return redis.call('selva.alias.del', id, ...aliases)
+}
+
+export function aliasResolve(...aliases: string[]): (string | boolean)[] {
+  return redis.call('selva.alias.resolve', ...aliases)
+}
+
+// applies the suggestion count changes of texts changing from old to new, '' meaning no text
+export function suggestionUpdate(...oldNewPairs: string[]): number {
+  return redis.call('selva.suggestion.update', ...oldNewPairs)
+}
+
 export function sismember(key: string, value: string): boolean {
   const result = redis.call('sismember', key, value)
   return result === 1
@@ -79,6 +79,8 @@ export function saveSchema(
   CACHED_SCHEMA = schema
   encoded = cjson.encode(schema)
   r.hset('___selva_schema', 'types', encoded)
+  // compile the hierarchy rules in the selva module
+  redis.call('selva.schema.load')
   redis.call('publish', '___selva_events:schema_update', 'schema_update')
   return encoded
 }
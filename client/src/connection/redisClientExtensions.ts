@@ -113,3 +113,66 @@ redisSearchCommands.forEach(cmd => {
 
 // @ts-ignore
 redis.add_command('selva.id')
+
+// @ts-ignore
+redis.add_command('selva.alias.resolve')
+
+// @ts-ignore
+redis.add_command('selva.alias.set')
+
+// @ts-ignore
+redis.add_command('selva.alias.del')
+
+// @ts-ignore
+redis.add_command('selva.delete')
+
+// @ts-ignore
+redis.add_command('selva.async.stats')
+
+// @ts-ignore
+redis.add_command('selva.hierarchy.add')
+
+// @ts-ignore
+redis.add_command('selva.hierarchy.del')
+
+// @ts-ignore
+redis.add_command('selva.hierarchy.parents')
+
+// @ts-ignore
+redis.add_command('selva.hierarchy.children')
+
+// @ts-ignore
+redis.add_command('selva.hierarchy.ancestors')
+
+// @ts-ignore
+redis.add_command('selva.hierarchy.depth')
+
+// @ts-ignore
+redis.add_command('selva.find.descendants')
+
+// @ts-ignore
+redis.add_command('selva.inherit')
+
+// @ts-ignore
+redis.add_command('selva.type.filter')
+
+// @ts-ignore
+redis.add_command('selva.type.scan')
+
+// @ts-ignore
+redis.add_command('selva.modify')
+
+// @ts-ignore
+redis.add_command('selva.modify.batch')
+
+// @ts-ignore
+redis.add_command('selva.set.reset')
+
+// @ts-ignore
+redis.add_command('selva.suggestion.update')
+
+// @ts-ignore
+redis.add_command('selva.numindex.range')
+
+// @ts-ignore
+redis.add_command('selva.get')
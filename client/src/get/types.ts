@@ -65,6 +65,7 @@ export type List =
   | {
       $offset?: number
       $limit?: number
+      $cursor?: string
       $sort?: Sort | Sort[]
       $find?: Find
       $inherit?: Inherit
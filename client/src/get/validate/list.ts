@@ -25,6 +25,7 @@ export default async function validateList(
         {
           $offset: number (optional)
           $limit: number (optional)
+          $cursor: string (optional) -- '' for the first page, then the <field>$cursor of the previous page
           $sort: { $field: string, $order?: 'asc' | 'desc' } or array of these sort objects (optional)
           $find: FindOptions (optional) -- see below
           $inherit: InheritOptions (optional) -- see below            
@@ -81,6 +82,13 @@ export default async function validateList(
         if (typeof list.$limit !== 'number') {
           err(`$limit has to be an number, ${list.$limit} specified`)
         }
+      } else if (field === '$cursor') {
+        if (typeof list.$cursor !== 'string') {
+          err(`$cursor has to be a string, ${list.$cursor} specified`)
+        }
+        if (list.$find && list.$find.$find) {
+          err(`$cursor can not be used with a nested $find`)
+        }
       } else if (field === '$sort') {
         if (Array.isArray(list.$sort)) {
           for (const sort of list.$sort) {
@@ -34,12 +34,14 @@ async function set(client: SelvaClient, payload: SetOptions): Promise<string> {
       aliases = [aliases]
     }
 
-    for (const alias of aliases) {
-      const id = await client.redis.hget(`___selva_aliases`, alias)
-      if (id) {
-        payload.$id = id
-        break
-      }
+    const ids: (string | null)[] = await client.redis.command(
+      { name: payload.$db || 'default' },
+      'selva.alias.resolve',
+      ...(<string[]>aliases)
+    )
+    const id = ids.find(id => !!id)
+    if (id) {
+      payload.$id = id
     }
 
     if (!payload.$id) {
@@ -465,3 +465,61 @@ test.serial('set parent by alias', async t => {
   await client.delete('root')
   await client.destroy()
 })
+
+test.serial('aliases taken over are kept by the new owner', async t => {
+  const client = connect({ port }, { loglevel: 'info' })
+
+  const match1 = await client.set({
+    type: 'match',
+    aliases: ['first_match', 'other_match']
+  })
+  const match2 = await client.set({
+    type: 'match',
+    aliases: { $add: ['first_match'] }
+  })
+
+  t.deepEqualIgnoreOrder(await client.redis.smembers(match1 + '.aliases'), [
+    'other_match'
+  ])
+
+  // a stale member of the old owner's set
+  await client.redis.sadd(match1 + '.aliases', 'first_match')
+  t.is(
+    await client.redis.command('selva.alias.del', match1, 'first_match'),
+    0,
+    'only the owner removes an alias'
+  )
+  t.deepEqualIgnoreOrder(await client.redis.smembers(match1 + '.aliases'), [
+    'other_match'
+  ])
+
+  await client.redis.sadd(match1 + '.aliases', 'first_match')
+  await client.set({
+    $id: match1,
+    aliases: ['last_match']
+  })
+
+  t.deepEqualIgnoreOrder(await client.redis.hgetall('___selva_aliases'), {
+    first_match: match2,
+    last_match: match1
+  })
+  t.deepEqualIgnoreOrder(await client.redis.smembers(match1 + '.aliases'), [
+    'last_match'
+  ])
+
+  await client.redis.sadd(match1 + '.aliases', 'first_match')
+  await client.delete(match1)
+
+  t.deepEqualIgnoreOrder(await client.redis.hgetall('___selva_aliases'), {
+    first_match: match2
+  })
+  t.deepEqualIgnoreOrder(await client.redis.smembers(match2 + '.aliases'), [
+    'first_match'
+  ])
+
+  t.is(await client.redis.command('selva.alias.del', match2, 'first_match'), 1)
+  t.is(await client.redis.hget('___selva_aliases', 'first_match'), null)
+
+  await client.delete('root')
+  await client.destroy()
+})
@@ -0,0 +1,87 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import { wait } from './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+
+test.before(async t => {
+  port = await getPort()
+  srv = await start({
+    port
+  })
+  await wait(500)
+
+  const client = connect({ port })
+  await client.updateSchema({
+    languages: ['en'],
+    types: {
+      match: {
+        prefix: 'ma',
+        fields: {
+          name: { type: 'string' }
+        }
+      }
+    }
+  })
+
+  await client.destroy()
+})
+
+test.after(async t => {
+  const client = connect({ port })
+  await client.delete('root')
+  await client.destroy()
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+const getStats = async (client): Promise<{ [name: string]: number }> => {
+  const reply = await client.redis.command('selva.async.stats')
+  const stats = {}
+  for (let i = 0; i < reply.length; i += 2) {
+    stats[reply[i]] = reply[i + 1]
+  }
+  return stats
+}
+
+test.serial('async stats - updates published by the module are counted', async t => {
+  const client = connect({ port }, { loglevel: 'info' })
+
+  const before = await getStats(client)
+  t.deepEqual(Object.keys(before).sort(), [
+    'depth',
+    'dropped',
+    'enqueued',
+    'send_errors',
+    'sent',
+    'spill_depth',
+    'spilled'
+  ])
+
+  await client.set({ $id: 'ma1', name: 'match1' })
+  for (let i = 0; i < 10; i++) {
+    await client.redis.command('selva.alias.set', 'ma1', 'alias' + i)
+  }
+
+  let stats = await getStats(client)
+  t.true(stats.enqueued >= before.enqueued + 10)
+
+  // the queue is drained by the publishing thread
+  for (let i = 0; i < 50 && stats.depth + stats.spill_depth > 0; i++) {
+    await wait(100)
+    stats = await getStats(client)
+  }
+
+  t.is(stats.depth, 0)
+  t.is(stats.spill_depth, 0)
+  t.is(stats.dropped, before.dropped)
+  t.is(stats.send_errors, before.send_errors)
+  t.true(stats.sent >= before.sent + 10)
+
+  await client.delete('ma1')
+  await client.destroy()
+})
@@ -0,0 +1,140 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import { wait } from './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+
+test.before(async t => {
+  port = await getPort()
+  srv = await start({
+    port
+  })
+  await wait(500)
+
+  const client = connect({ port })
+  await client.updateSchema({
+    languages: ['en'],
+    types: {
+      league: {
+        prefix: 'le',
+        fields: {
+          name: { type: 'string', search: { type: ['TAG'] } }
+        }
+      },
+      match: {
+        prefix: 'ma',
+        fields: {
+          name: { type: 'string', search: { type: ['TAG'] } }
+        }
+      }
+    }
+  })
+
+  await client.destroy()
+})
+
+test.after(async t => {
+  const client = connect({ port })
+  await client.delete('root')
+  await client.destroy()
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+// The nodes are written by the Lua client, so only the keyspace knows their edges
+test.serial('delete - orphans are deleted with their parent', async t => {
+  const client = connect({ port }, { loglevel: 'info' })
+
+  await client.set({
+    $id: 'le1',
+    name: 'league1',
+    children: [
+      { $id: 'ma1', name: 'match1', aliases: ['m1'] },
+      { $id: 'ma2', name: 'match2' }
+    ]
+  })
+  await client.set({
+    $id: 'le2',
+    name: 'league2',
+    children: { $add: ['ma2'] }
+  })
+
+  t.true(await client.delete('le1'))
+
+  t.is(await client.redis.exists('le1'), 0)
+  t.is(await client.redis.exists('ma1'), 0)
+  t.is(await client.redis.exists('ma1.parents'), 0)
+  t.is(await client.redis.hget('___selva_aliases', 'm1'), null)
+  t.deepEqual(await client.redis.smembers('ma2.parents'), ['le2'])
+  t.deepEqual(await client.redis.smembers('root.children').then(c => c.sort()), [
+    'le2'
+  ])
+  t.deepEqual(
+    await client.redis.zrange('ma2.ancestors', 0, -1).then(a => a.sort()),
+    ['le2', 'root'],
+    'the ancestors of the surviving child are recomputed'
+  )
+
+  const found = await client.get({
+    $id: 'root',
+    items: {
+      id: true,
+      $list: {
+        $find: {
+          $traverse: 'descendants',
+          $filter: { $field: 'type', $operator: '=', $value: 'match' }
+        }
+      }
+    }
+  })
+  t.deepEqual(
+    found.items.map(item => item.id),
+    ['ma2'],
+    'the deleted nodes are removed from the search index'
+  )
+
+  t.false(await client.delete('le1'), 'a missing node is not deleted')
+
+  await client.destroy()
+})
+
+test.serial('delete - reply of selva.delete', async t => {
+  const client = connect({ port }, { loglevel: 'info' })
+
+  await client.set({
+    $id: 'le3',
+    children: [
+      { $id: 'ma3', children: [{ $id: 'ma4' }] },
+      { $id: 'ma5' }
+    ]
+  })
+  await client.set({ $id: 'le4', children: { $add: ['ma5'] } })
+
+  const [deleted, changed] = await client.redis.command(
+    'selva.delete',
+    'le3',
+    'RECURSIVE'
+  )
+  t.deepEqual(deleted.sort(), ['le3', 'ma3', 'ma4'])
+  t.deepEqual(changed, ['ma5'])
+
+  const [none] = await client.redis.command('selva.delete', 'le3')
+  t.deepEqual(none, [])
+
+  await client.set({ $id: 'le5', children: [{ $id: 'ma6' }] })
+  const [parentOnly, orphans] = await client.redis.command(
+    'selva.delete',
+    'le5'
+  )
+  t.deepEqual(parentOnly, ['le5'], 'without RECURSIVE the children are kept')
+  t.deepEqual(orphans, ['ma6'])
+  t.deepEqual(await client.redis.smembers('ma6.parents'), [])
+
+  await client.delete('le4')
+  await client.delete('ma6')
+  await client.destroy()
+})
@@ -0,0 +1,68 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import { wait } from './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+
+test.before(async t => {
+  port = await getPort()
+  srv = await start({
+    port
+  })
+  await wait(500)
+})
+
+test.after(async t => {
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+const KEY = 'test_hierarchy'
+
+test.serial('find - descendants in the module hierarchy', async t => {
+  const client = connect({ port }, { loglevel: 'info' })
+  const add = (id: string, ...parents: string[]) =>
+    client.redis.command('selva.hierarchy.add', KEY, id, ...parents)
+  const find = async (...args: string[]) =>
+    (await client.redis.command('selva.find.descendants', KEY, ...args)).sort()
+
+  // a diamond under le1 and a separate branch under le2
+  await add('root')
+  await add('le1', 'root')
+  await add('le2', 'root')
+  await add('ma1', 'le1')
+  await add('ma2', 'le1')
+  await add('vi1', 'ma1', 'ma2')
+  await add('ma3', 'le2')
+  await add('vi2', 'ma3')
+
+  t.deepEqual(
+    await find('le1'),
+    ['ma1', 'ma2', 'vi1'],
+    'a node reached twice is replied once'
+  )
+  t.deepEqual(await find('DEPTH', '1', 'le1'), ['ma1', 'ma2'])
+  t.deepEqual(await find('DEPTH', '0', 'le1'), [])
+  t.deepEqual(await find('TYPES', '1', 'ma', 'root'), ['ma1', 'ma2', 'ma3'])
+  t.deepEqual(await find('TYPES', '2', 'le', 'vi', 'DEPTH', '2', 'root'), [
+    'le1',
+    'le2'
+  ])
+  t.deepEqual(await find('le1', 'le2'), ['ma1', 'ma2', 'ma3', 'vi1', 'vi2'])
+  t.deepEqual(
+    await find('le1', 'ma1'),
+    ['ma1', 'ma2', 'vi1'],
+    'a given node is replied if it descends from another one'
+  )
+  t.deepEqual(await find('nonexist'), [])
+
+  await t.throwsAsync(find('DEPTH', '-1', 'le1'))
+  await t.throwsAsync(find('TYPES', '1', 'toolong', 'le1'))
+
+  await client.redis.del(KEY)
+  await client.destroy()
+})
@@ -0,0 +1,148 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import { wait } from './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+
+test.before(async t => {
+  port = await getPort()
+  srv = await start({
+    port
+  })
+  await wait(500)
+
+  const client = connect({ port })
+  await client.updateSchema({
+    languages: ['en'],
+    types: {
+      league: {
+        prefix: 'le',
+        fields: {
+          name: { type: 'string', search: { type: ['TAG'] } }
+        }
+      },
+      match: {
+        prefix: 'ma',
+        fields: {
+          name: { type: 'string', search: { type: ['TAG'] } },
+          value: { type: 'number', search: { type: ['NUMERIC'] } },
+          status: { type: 'string', search: { type: ['TAG'] } },
+          roles: {
+            type: 'set',
+            search: { type: ['TAG'] },
+            items: { type: 'string' }
+          }
+        }
+      }
+    }
+  })
+
+  await client.destroy()
+})
+
+test.after(async t => {
+  const client = connect({ port })
+  await client.delete('root')
+  await client.destroy()
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+// $traverse gives a known candidate set, so the filter is evaluated in the module
+test.serial('find - filter over traversed children', async t => {
+  const client = connect({ port }, { loglevel: 'info' })
+
+  await client.set({
+    $id: 'le0',
+    name: 'league0',
+    children: [
+      {
+        $id: 'ma0',
+        name: 'match0',
+        value: 1,
+        status: 'Live',
+        roles: ['home', 'Away']
+      },
+      {
+        $id: 'ma1',
+        name: 'match1',
+        value: 5,
+        status: 'finished',
+        roles: ['home']
+      },
+      {
+        $id: 'ma2',
+        name: 'match2',
+        value: 10,
+        status: 'live'
+      }
+    ]
+  })
+
+  const find = async (filter: any, single?: boolean) => {
+    const $find = {
+      $traverse: 'children',
+      $filter: filter
+    }
+    const r = await client.get({
+      $id: 'le0',
+      items: single ? { id: true, $find } : { id: true, $list: { $find } }
+    })
+    return single
+      ? r.items && r.items.id
+      : r.items.map(item => item.id).sort()
+  }
+
+  t.deepEqual(
+    await find([
+      { $field: 'type', $operator: '=', $value: 'match' },
+      { $field: 'status', $operator: '=', $value: 'live' }
+    ]),
+    ['ma0', 'ma2'],
+    'tag lists match case-insensitively'
+  )
+
+  t.deepEqual(
+    await find({ $field: 'roles', $operator: '=', $value: 'away' }),
+    ['ma0'],
+    'set members match case-insensitively'
+  )
+
+  t.deepEqual(
+    await find({ $field: 'value', $operator: '..', $value: [5, 10] }),
+    ['ma1', 'ma2'],
+    'ranges are inclusive'
+  )
+
+  t.deepEqual(
+    await find({
+      $field: 'value',
+      $operator: '>',
+      $value: 1,
+      $or: { $field: 'roles', $operator: 'exists' }
+    }),
+    ['ma0', 'ma1', 'ma2']
+  )
+
+  t.deepEqual(
+    await find({
+      $field: 'status',
+      $operator: '!=',
+      $value: 'live',
+      $and: { $field: 'value', $operator: '<', $value: 6 }
+    }),
+    ['ma1']
+  )
+
+  t.is(
+    await find({ $field: 'name', $operator: '=', $value: 'match1' }, true),
+    'ma1',
+    'a $find without $list returns a single match'
+  )
+
+  await client.destroy()
+})
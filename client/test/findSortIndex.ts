@@ -0,0 +1,108 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import { wait } from './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+
+test.before(async t => {
+  port = await getPort()
+  srv = await start({
+    port
+  })
+  await wait(500)
+
+  const client = connect({ port })
+  await client.updateSchema({
+    languages: ['en'],
+    types: {
+      custom: {
+        prefix: 'cu',
+        fields: {
+          value: { type: 'number', search: { type: ['NUMERIC'] } },
+          name: { type: 'string' }
+        }
+      }
+    }
+  })
+
+  await client.destroy()
+})
+
+test.after(async t => {
+  const client = connect({ port })
+  await client.delete('root')
+  await client.destroy()
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+// A small $limit over many children takes the numeric index path in the module
+test.serial('sort - top of a list written with client.set', async t => {
+  const client = connect({ port }, { loglevel: 'info' })
+
+  const values: { [id: string]: number } = {}
+  const children = []
+  for (let i = 0; i < 40; i++) {
+    const $id = 'cu' + String(i).padStart(3, '0')
+    if (i % 10 === 9) {
+      // no value, sorted as 0
+      children.push({ $id, name: 'item' + i })
+      values[$id] = 0
+    } else {
+      children.push({ $id, name: 'item' + i, value: i % 7 })
+      values[$id] = i % 7
+    }
+  }
+  await client.set({ $id: 'root', children })
+
+  const expected = (order: 'asc' | 'desc', limit: number) => {
+    const ids = Object.keys(values).sort((a, b) => {
+      const d = values[a] - values[b] || (a < b ? -1 : a > b ? 1 : 0)
+      return order === 'asc' ? d : -d
+    })
+    return ids.slice(0, limit)
+  }
+
+  const query = async (order: 'asc' | 'desc', limit: number) => {
+    const r = await client.get({
+      $id: 'root',
+      children: {
+        id: true,
+        $list: {
+          $sort: { $field: 'value', $order: order },
+          $limit: limit
+        }
+      }
+    })
+    return r.children.map(item => item.id)
+  }
+
+  t.deepEqual(await query('asc', 5), expected('asc', 5))
+  t.deepEqual(await query('desc', 5), expected('desc', 5))
+
+  // The index now knows a few of the nodes, the rest are read when looked up
+  await client.set({ $id: 'cu003', value: -5 })
+  await client.set({ $id: 'cu020', value: 100 })
+  values.cu003 = -5
+  values.cu020 = 100
+
+  t.deepEqual(await query('asc', 5), expected('asc', 5))
+  t.deepEqual(await query('desc', 5), expected('desc', 5))
+
+  // A value set on a node that didn't have one
+  await client.set({ $id: 'cu009', value: -10 })
+  values.cu009 = -10
+
+  t.deepEqual(await query('asc', 3), expected('asc', 3))
+  t.deepEqual(
+    await query('desc', 12),
+    expected('desc', 12),
+    'ties are ordered by the id in the direction of the sort'
+  )
+
+  await client.destroy()
+})
@@ -0,0 +1,77 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import { wait } from './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+
+test.before(async t => {
+  port = await getPort()
+  srv = await start({
+    port
+  })
+  await wait(500)
+})
+
+test.after(async t => {
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+// The nested arrays of alternating keys and values as an object
+const toObject = (arr: any[]) => {
+  const obj = {}
+  for (let i = 0; i < arr.length; i += 2) {
+    obj[arr[i]] = Array.isArray(arr[i + 1]) ? toObject(arr[i + 1]) : arr[i + 1]
+  }
+  return obj
+}
+
+test.serial('get - JSON is the same object as the nested arrays', async t => {
+  const client = connect({ port }, { loglevel: 'info' })
+  const get = (...args: string[]) =>
+    client.redis.command('selva.get', ...args)
+
+  await client.redis.hset(
+    'ma1',
+    'title.en',
+    'hello',
+    'title.de',
+    'hallo',
+    'image',
+    'img.png',
+    'image.thumb',
+    'thumb.png',
+    'quote',
+    'say "hi"\n\tback\\slash \u0001',
+    'value',
+    '5'
+  )
+
+  const spec = 'title,image,quote'
+  const expected = {
+    title: { de: 'hallo', en: 'hello' },
+    image: { '': 'img.png', thumb: 'thumb.png' },
+    quote: 'say "hi"\n\tback\\slash \u0001'
+  }
+
+  const json = await get('ma1', spec, 'JSON')
+  t.is(typeof json, 'string')
+  t.deepEqual(JSON.parse(json), expected, 'strings are escaped')
+  t.deepEqual(toObject(await get('ma1', spec)), expected)
+
+  t.deepEqual(JSON.parse(await get('ma1', 'title.en', 'json')), {
+    title: { en: 'hello' }
+  })
+  t.deepEqual(JSON.parse(await get('ma1', 'nothing', 'JSON')), {})
+  t.is(await get('ma2', spec, 'JSON'), null, 'a missing node is null')
+
+  await t.throwsAsync(get('ma1', spec, 'XML'), {
+    message: /invalid reply format/
+  })
+
+  await client.destroy()
+})
@@ -0,0 +1,135 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+test.before(async t => {
+  port = await getPort()
+  srv = await start({ port })
+
+  const client = connect({ port })
+  await client.updateSchema({
+    languages: ['en', 'de'],
+    types: {
+      thing: {
+        prefix: 'th',
+        fields: {
+          name: { type: 'string' },
+          value: { type: 'number' },
+          flag: { type: 'boolean' },
+          title: { type: 'text' },
+          strVal: { type: 'string' },
+          tags: { type: 'set', items: { type: 'string' } },
+          image: {
+            type: 'object',
+            properties: {
+              thumb: { type: 'string' },
+              poster: {
+                type: 'object',
+                properties: {
+                  big: { type: 'string' },
+                  small: { type: 'string' }
+                }
+              }
+            }
+          },
+          imageThumb: { type: 'string' }
+        }
+      }
+    }
+  })
+
+  await client.destroy()
+})
+
+test.after(async t => {
+  const client = connect({ port })
+  await client.delete('root')
+  await client.destroy()
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+test.serial('get - fields read together match fields read one by one', async t => {
+  const client = connect({ port })
+
+  await client.set({
+    $id: 'thA',
+    name: 'flurp',
+    value: 12,
+    flag: true,
+    title: { de: 'hallo' },
+    strVal: { $ref: 'name' },
+    tags: ['a', 'b'],
+    image: {
+      thumb: 'small.png',
+      poster: { big: 'big.png' }
+    },
+    imageThumb: 'other.png'
+  })
+
+  const all = await client.get({
+    $id: 'thA',
+    $language: 'en',
+    id: true,
+    name: true,
+    value: true,
+    flag: true,
+    title: true,
+    strVal: true,
+    tags: true,
+    image: { thumb: true, poster: { big: true, small: true } },
+    imageThumb: true
+  })
+
+  t.deepEqualIgnoreOrder(all, {
+    id: 'thA',
+    name: 'flurp',
+    value: 12,
+    flag: true,
+    title: 'hallo',
+    strVal: 'flurp',
+    tags: ['a', 'b'],
+    image: {
+      thumb: 'small.png',
+      poster: { big: 'big.png', small: '' }
+    },
+    imageThumb: 'other.png'
+  })
+
+  const single = {}
+  for (const field of ['name', 'value', 'title', 'strVal', 'imageThumb']) {
+    Object.assign(
+      single,
+      await client.get({ $id: 'thA', $language: 'en', [field]: true })
+    )
+  }
+
+  t.deepEqual(single, {
+    name: all.name,
+    value: all.value,
+    title: all.title,
+    strVal: all.strVal,
+    imageThumb: all.imageThumb
+  })
+
+  t.deepEqual(
+    await client.get({
+      $id: 'thA',
+      image: true,
+      title: true
+    }),
+    {
+      image: {
+        thumb: 'small.png',
+        poster: { big: 'big.png' }
+      },
+      title: { de: 'hallo' }
+    }
+  )
+
+  await client.destroy()
+})
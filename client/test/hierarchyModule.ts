@@ -0,0 +1,130 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import { wait } from './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+
+test.before(async t => {
+  port = await getPort()
+  srv = await start({
+    port
+  })
+  await wait(500)
+})
+
+test.after(async t => {
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+const KEY = 'test_hierarchy'
+
+test.serial('hierarchy - edges and depth of the module type', async t => {
+  const client = connect({ port }, { loglevel: 'info' })
+  const cmd = (name: string, ...args: string[]) =>
+    client.redis.command('selva.hierarchy.' + name, KEY, ...args)
+  const edges = async (name: string, id: string) =>
+    (await cmd(name, id)).sort()
+
+  t.deepEqual(await cmd('add', 'root'), [0, 0])
+  t.deepEqual(await cmd('add', 'grphnx1', 'root'), [1, 1])
+  t.deepEqual(await cmd('add', 'grphnx2', 'grphnx1'), [1, 1])
+  t.deepEqual(
+    await cmd('add', 'grphnx3', 'root', 'grphnx2'),
+    [2, 1],
+    'each new edge is counted'
+  )
+  t.deepEqual(await cmd('add', 'grphnx3', 'root'), [0, 0], 'edges are a set')
+
+  t.deepEqual(await edges('parents', 'grphnx3'), ['grphnx2', 'root'])
+  t.deepEqual(await edges('children', 'root'), ['grphnx1', 'grphnx3'])
+  t.deepEqual(await cmd('children', 'grphnx3'), [])
+  t.deepEqual(await cmd('parents', 'nonexist'), [])
+
+  t.is(await cmd('depth', 'root'), 0)
+  t.is(await cmd('depth', 'grphnx2'), 2)
+  t.is(await cmd('depth', 'grphnx3'), 3, 'the depth is the longest path')
+  t.is(await cmd('depth', 'nonexist'), null)
+
+  t.deepEqual(await cmd('ancestors', 'grphnx3'), [
+    'root',
+    0,
+    'grphnx1',
+    1,
+    'grphnx2',
+    2
+  ])
+
+  t.deepEqual(await cmd('del', 'grphnx3', 'grphnx2'), [1, 1])
+  t.is(await cmd('depth', 'grphnx3'), 1)
+  t.deepEqual(await cmd('ancestors', 'grphnx3'), ['root', 0])
+
+  t.deepEqual(await cmd('del', 'grphnx1'), [1, 1], 'the node is removed')
+  t.deepEqual(await edges('children', 'root'), ['grphnx3'])
+  t.deepEqual(await cmd('parents', 'grphnx2'), [])
+  t.is(await cmd('depth', 'grphnx2'), 0)
+
+  await t.throwsAsync(cmd('add', 'anodeidthatistoolong', 'root'))
+  await client.redis.set('not_a_hierarchy', 'x')
+  await t.throwsAsync(
+    client.redis.command('selva.hierarchy.children', 'not_a_hierarchy', 'root')
+  )
+
+  await client.redis.del(KEY, 'not_a_hierarchy')
+  await client.destroy()
+})
+
+test.serial('hierarchy - only the changed descendants are recomputed', async t => {
+  const client = connect({ port }, { loglevel: 'info' })
+  const cmd = (name: string, ...args: string[]) =>
+    client.redis.command('selva.hierarchy.' + name, KEY, ...args)
+
+  await cmd('add', 'root')
+  t.deepEqual(await cmd('add', 'grphnxa', 'root'), [1, 1])
+  t.deepEqual(await cmd('add', 'grphnxb', 'grphnxa'), [1, 1])
+  t.deepEqual(await cmd('add', 'grphnxc', 'grphnxb'), [1, 1])
+  t.deepEqual(await cmd('add', 'grphnxd', 'grphnxc'), [1, 1])
+  t.deepEqual(await cmd('add', 'grphnxe', 'root'), [1, 1])
+
+  t.deepEqual(
+    await cmd('add', 'grphnxb', 'root'),
+    [1, 0],
+    'an edge that changes no ancestors stops at the node'
+  )
+
+  t.deepEqual(
+    await cmd('add', 'grphnxc', 'grphnxe'),
+    [1, 2],
+    'the new ancestor reaches every descendant'
+  )
+  t.deepEqual(await cmd('ancestors', 'grphnxd'), [
+    'root',
+    0,
+    'grphnxa',
+    1,
+    'grphnxe',
+    1,
+    'grphnxb',
+    2,
+    'grphnxc',
+    3
+  ])
+
+  t.deepEqual(await cmd('del', 'grphnxc', 'grphnxb'), [1, 2])
+  t.is(await cmd('depth', 'grphnxc'), 2)
+  t.deepEqual(await cmd('ancestors', 'grphnxd'), [
+    'root',
+    0,
+    'grphnxe',
+    1,
+    'grphnxc',
+    2
+  ])
+
+  await client.redis.del(KEY)
+  await client.destroy()
+})
@@ -0,0 +1,121 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import { wait } from './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+
+test.before(async t => {
+  port = await getPort()
+  srv = await start({
+    port
+  })
+  await wait(500)
+
+  const client = connect({ port })
+  await client.updateSchema({
+    languages: ['en'],
+    types: {
+      sport: {
+        prefix: 'sp'
+      },
+      club: {
+        prefix: 'cl'
+      },
+      competition: {
+        prefix: 'co'
+      },
+      team: {
+        prefix: 'te',
+        hierarchy: {
+          club: {
+            excludeAncestryWith: ['sport']
+          }
+        }
+      },
+      match: {
+        prefix: 'ma',
+        hierarchy: {
+          team: {
+            excludeAncestryWith: ['competition']
+          },
+          $default: false
+        }
+      },
+      video: {
+        prefix: 'vi',
+        hierarchy: {
+          match: false
+        }
+      },
+      league: {
+        prefix: 'le',
+        hierarchy: {
+          $default: {
+            includeAncestryWith: ['sport']
+          }
+        }
+      }
+    }
+  })
+
+  await client.destroy()
+})
+
+test.after(async t => {
+  const client = connect({ port })
+  await client.delete('root')
+  await client.destroy()
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+// The module computes the ancestors of the same graph the Lua client wrote
+test.serial('hierarchy - module ancestors match the Lua client', async t => {
+  const client = connect({ port }, { loglevel: 'info' })
+
+  const nodes: [string, string[]][] = [
+    ['sp1', ['root']],
+    ['cl1', ['sp1']],
+    ['co1', ['root', 'sp1']],
+    ['te1', ['cl1', 'co1']],
+    ['ma1', ['te1', 'co1']],
+    ['ma2', ['te1']],
+    ['vi1', ['ma1']],
+    ['vi2', ['ma2', 'co1']],
+    ['le1', ['sp1', 'cl1']],
+    ['le2', ['co1', 'te1']]
+  ]
+
+  for (const [$id, parents] of nodes) {
+    await client.set({ $id, parents })
+  }
+
+  const key = 'test_hierarchy'
+  await client.redis.command('selva.hierarchy.add', key, 'root')
+  for (const [id] of nodes) {
+    const parents = await client.redis.smembers(id + '.parents')
+    await client.redis.command('selva.hierarchy.add', key, id, ...parents)
+  }
+
+  for (const [id] of nodes) {
+    const reply = await client.redis.command(
+      'selva.hierarchy.ancestors',
+      key,
+      id
+    )
+    const ancestors = reply.filter((_, i) => i % 2 === 0).sort()
+
+    t.deepEqual(
+      ancestors,
+      (await client.redis.zrange(id + '.ancestors', 0, -1)).sort(),
+      'ancestors of ' + id
+    )
+  }
+
+  await client.redis.del(key)
+  await client.destroy()
+})
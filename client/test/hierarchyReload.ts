@@ -0,0 +1,103 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import { wait } from './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+
+test.before(async t => {
+  port = await getPort()
+  srv = await start({
+    port
+  })
+  await wait(500)
+})
+
+test.after(async t => {
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+const KEY = 'test_hierarchy'
+
+const snapshot = async (client, ids: string[]) => {
+  const nodes = {}
+  for (const id of ids) {
+    nodes[id] = {
+      parents: (await client.redis.command(
+        'selva.hierarchy.parents',
+        KEY,
+        id
+      )).sort(),
+      ancestors: await client.redis.command(
+        'selva.hierarchy.ancestors',
+        KEY,
+        id
+      ),
+      depth: await client.redis.command('selva.hierarchy.depth', KEY, id)
+    }
+  }
+  return nodes
+}
+
+const persistence = async client => {
+  const info: string = await client.redis.info('persistence')
+  const fields = {}
+  for (const line of info.split('\r\n')) {
+    const [name, value] = line.split(':')
+    fields[name] = value
+  }
+  return fields
+}
+
+test.serial('hierarchy - RDB and AOF round trip', async t => {
+  const client = connect({ port }, { loglevel: 'info' })
+  const add = (id: string, ...parents: string[]) =>
+    client.redis.command('selva.hierarchy.add', KEY, id, ...parents)
+
+  const ids = ['root']
+  await add('root')
+  for (let i = 0; i < 20; i++) {
+    const id = 'ma' + i
+    // a parent or two among the earlier nodes
+    const parents = [ids[Math.floor(i / 2)]]
+    if (i > 3) {
+      parents.push(ids[i - 3])
+    }
+    await add(id, ...parents)
+    ids.push(id)
+  }
+  // a node without edges is kept too
+  await add('vi1')
+  ids.push('vi1')
+
+  const before = await snapshot(client, ids)
+
+  await client.redis.debug('reload')
+  t.deepEqual(await snapshot(client, ids), before, 'after an RDB reload')
+
+  await client.redis.config('set', 'appendonly', 'yes')
+  let fields
+  for (let i = 0; i < 50; i++) {
+    await wait(100)
+    fields = await persistence(client)
+    if (
+      fields.aof_enabled === '1' &&
+      fields.aof_rewrite_in_progress === '0' &&
+      fields.aof_rewrite_scheduled === '0'
+    ) {
+      break
+    }
+  }
+  t.is(fields.aof_last_bgrewrite_status, 'ok')
+
+  await client.redis.debug('loadaof')
+  t.deepEqual(await snapshot(client, ids), before, 'after an AOF rewrite')
+
+  await client.redis.config('set', 'appendonly', 'no')
+  await client.redis.del(KEY)
+  await client.destroy()
+})
@@ -0,0 +1,67 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import { wait } from './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+
+test.before(async t => {
+  port = await getPort()
+  srv = await start({
+    port
+  })
+  await wait(500)
+})
+
+test.after(async t => {
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+const KEY = 'test_hierarchy'
+
+test.serial('inherit - the closest ancestor with a value', async t => {
+  const client = connect({ port }, { loglevel: 'info' })
+  const add = (id: string, ...parents: string[]) =>
+    client.redis.command('selva.hierarchy.add', KEY, id, ...parents)
+  const inherit = (...args: string[]) =>
+    client.redis.command('selva.inherit', KEY, ...args)
+
+  await add('root')
+  await add('le1', 'root')
+  await add('ma1', 'le1')
+  await add('vi1', 'ma1')
+
+  await client.redis.hset('root', 'title', 'root title')
+  await client.redis.hset('le1', 'title', 'league', 'color', 'blue')
+  await client.redis.hset('ma1', 'title', '', 'color', 'red')
+  await client.redis.hset('vi1', 'title', 'own title')
+
+  t.deepEqual(await inherit('vi1', 'title', 'color', 'missing'), [
+    ['le1', 'league'],
+    ['ma1', 'red'],
+    null
+  ])
+
+  t.deepEqual(
+    await inherit('vi1', 'color', 'TYPES', 'le'),
+    [['le1', 'blue']],
+    'only the ancestors of the given types'
+  )
+
+  t.deepEqual(
+    await inherit('le1', 'title'),
+    [null],
+    'root is not inherited from'
+  )
+
+  t.deepEqual(await inherit('nonexist', 'title'), [null])
+
+  await t.throwsAsync(inherit('vi1', 'title', 'TYPES', 'toolong'))
+
+  await client.redis.del(KEY, 'root', 'le1', 'ma1', 'vi1')
+  await client.destroy()
+})
@@ -0,0 +1,120 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+test.before(async t => {
+  port = await getPort()
+  srv = await start({ port })
+
+  const client = connect({ port })
+  await client.updateSchema({
+    languages: ['en'],
+    types: {
+      custom: {
+        prefix: 'cu',
+        fields: {
+          value: { type: 'number', search: true },
+          name: { type: 'string' }
+        }
+      }
+    }
+  })
+
+  await client.destroy()
+})
+
+test.after(async t => {
+  const client = connect({ port })
+  await client.delete('root')
+  await client.destroy()
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+const byValueDesc = (a, b) =>
+  b.value - a.value || (a.id < b.id ? 1 : a.id > b.id ? -1 : 0)
+
+test.serial('get - $list pages with $cursor', async t => {
+  const client = connect({ port })
+
+  const children = []
+  for (let i = 0; i < 50; i++) {
+    children.push({
+      $id: 'cu' + i,
+      type: 'custom',
+      value: i % 10,
+      name: 'flurp' + i
+    })
+  }
+
+  await client.set({
+    $id: 'cuA',
+    children
+  })
+
+  const expected = children
+    .map(({ $id, value }) => ({ id: $id, value }))
+    .sort(byValueDesc)
+
+  const pages = []
+  let cursor = ''
+  do {
+    const { items, items$cursor } = await client.get({
+      $id: 'cuA',
+      items: {
+        id: true,
+        value: true,
+        $list: {
+          $sort: { $field: 'value', $order: 'desc' },
+          $limit: 7,
+          $cursor: cursor,
+          $find: {
+            $traverse: 'children'
+          }
+        }
+      }
+    })
+
+    t.true(items.length <= 7)
+    pages.push(...items)
+    cursor = items$cursor
+  } while (cursor)
+
+  t.deepEqual(pages, expected)
+
+  await client.destroy()
+})
+
+test.serial('get - $cursor resumes after its node is deleted', async t => {
+  const client = connect({ port })
+
+  const query = (cursor: string) =>
+    client.get({
+      $id: 'cuA',
+      items: {
+        id: true,
+        value: true,
+        $list: {
+          $sort: { $field: 'value', $order: 'desc' },
+          $limit: 5,
+          $cursor: cursor,
+          $find: {
+            $traverse: 'children'
+          }
+        }
+      }
+    })
+
+  const first = await query('')
+  const next = await query(first.items$cursor)
+
+  await client.delete(first.items[first.items.length - 1].id)
+
+  t.deepEqual(await query(first.items$cursor), next)
+
+  await client.destroy()
+})
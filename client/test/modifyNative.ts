@@ -0,0 +1,224 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import { wait } from './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+
+test.before(async t => {
+  port = await getPort()
+  srv = await start({
+    port
+  })
+  await wait(500)
+})
+
+test.after(async t => {
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+// $default and $increment as little endian int64s
+const increment = (d: number, i: number) => {
+  const buf = Buffer.alloc(16)
+  buf.writeInt32LE(d, 0)
+  buf.writeInt32LE(d < 0 ? -1 : 0, 4)
+  buf.writeInt32LE(i, 8)
+  buf.writeInt32LE(i < 0 ? -1 : 0, 12)
+  return buf
+}
+
+const incrementDouble = (d: number, i: number) => {
+  const buf = Buffer.alloc(16)
+  buf.writeDoubleLE(d, 0)
+  buf.writeDoubleLE(i, 8)
+  return buf
+}
+
+// Header of is_reference, no_root and the offset and length of the $add,
+// $delete and $value lists, followed by the NUL separated lists
+const opSet = (
+  lists: { $add?: string[]; $delete?: string[]; $value?: string[] },
+  isReference: boolean = true
+) => {
+  const header = Buffer.alloc(26)
+  const bufs = [header]
+  let offset = header.length
+
+  header[0] = isReference ? 1 : 0
+  ;['$add', '$delete', '$value'].forEach((name, i) => {
+    if (lists[name]) {
+      const buf = Buffer.from(lists[name].join('\0'))
+
+      header.writeUInt32LE(offset, 2 + 8 * i)
+      header.writeUInt32LE(buf.length, 6 + 8 * i)
+      bufs.push(buf)
+      offset += buf.length
+    }
+  })
+
+  return Buffer.concat(bufs)
+}
+
+test.serial('modify - value, default and reference', async t => {
+  const client = connect({ port }, { loglevel: 'info' })
+  const modify = (...args: any[]) =>
+    client.redis.command('selva.modify', ...args)
+
+  t.is(await modify('ma1', '0', 'title', 'match', '2', 'color', 'red'), 'ma1')
+  t.deepEqual(await client.redis.hgetall('ma1'), {
+    title: 'match',
+    color: 'red'
+  })
+  t.deepEqual(
+    await client.redis.smembers('ma1.parents'),
+    ['root'],
+    'new nodes are created under root'
+  )
+  t.deepEqual(await client.redis.smembers('root.children'), ['ma1'])
+
+  await modify('ma1', '2', 'color', 'blue', '4', 'video', 'vi1')
+  t.is(
+    await client.redis.hget('ma1', 'color'),
+    'red',
+    'a default does not overwrite'
+  )
+  t.is(await client.redis.hget('ma1', 'video.$ref'), 'vi1')
+
+  await modify('ma1', '6', 'color', '')
+  t.is(await client.redis.hget('ma1', 'color'), null)
+
+  const id = await modify('ma', '0', 'title', 'generated')
+  t.true(id.length > 2, 'an id is generated from a type')
+  t.is(id.slice(0, 2), 'ma')
+  t.is(await client.redis.hget(id, 'title'), 'generated')
+
+  await client.destroy()
+})
+
+test.serial('modify - increments', async t => {
+  const client = connect({ port }, { loglevel: 'info' })
+  const modify = (...args: any[]) =>
+    client.redis.command('selva.modify', ...args)
+
+  await modify('ma2', '3', 'value', increment(5, 2))
+  t.is(
+    await client.redis.hget('ma2', 'value'),
+    '5',
+    'a missing field is set to $default'
+  )
+  await modify('ma2', '3', 'value', increment(5, -3))
+  t.is(await client.redis.hget('ma2', 'value'), '2')
+
+  await modify('ma2', '8', 'score', incrementDouble(1.5, 0.25))
+  await modify('ma2', '8', 'score', incrementDouble(1.5, 0.25))
+  t.is(Number(await client.redis.hget('ma2', 'score')), 1.75)
+
+  await client.destroy()
+})
+
+test.serial('modify - sets', async t => {
+  const client = connect({ port }, { loglevel: 'info' })
+  const modify = (...args: any[]) =>
+    client.redis.command('selva.modify', ...args)
+
+  await modify('le1', '0', 'title', 'league')
+  await modify('ma3', '5', 'parents', opSet({ $value: ['le1'] }))
+  t.deepEqual(
+    await client.redis.smembers('ma3.parents'),
+    ['le1'],
+    'given parents replace root'
+  )
+  t.deepEqual(await client.redis.smembers('le1.children'), ['ma3'])
+
+  await modify(
+    'ma3',
+    '5',
+    'parents',
+    opSet({ $add: ['root'], $delete: ['le1'] })
+  )
+  t.deepEqual(await client.redis.smembers('ma3.parents'), ['root'])
+  t.deepEqual(await client.redis.smembers('le1.children'), [])
+
+  await modify('ma3', '5', 'tags', opSet({ $add: ['a', 'b', 'c'] }, false))
+  await modify('ma3', '5', 'tags', opSet({ $delete: ['b'] }, false))
+  t.deepEqual((await client.redis.smembers('ma3.tags')).sort(), ['a', 'c'])
+
+  await client.destroy()
+})
+
+test.serial('modify - an invalid op writes nothing', async t => {
+  const client = connect({ port }, { loglevel: 'info' })
+  const modify = (...args: any[]) =>
+    client.redis.command('selva.modify', ...args)
+
+  await modify('ma4', '0', 'title', 'match')
+
+  await t.throwsAsync(
+    modify('ma4', '0', 'title', 'changed', '3', 'title', increment(0, 1)),
+    { message: /invalid modify operation/ }
+  )
+  await t.throwsAsync(
+    modify('ma4', '0', 'title', 'changed', '3', 'value', Buffer.alloc(8)),
+    { message: /invalid modify operation/ }
+  )
+  await t.throwsAsync(
+    modify('ma4', '0', 'title', 'changed', '5', 'parents', Buffer.alloc(4)),
+    { message: /invalid modify operation/ }
+  )
+  await t.throwsAsync(
+    modify('ma4', '0', 'title', 'changed', 'x', 'color', 'red'),
+    { message: /invalid modify operation/ }
+  )
+  t.deepEqual(await client.redis.hgetall('ma4'), { title: 'match' })
+
+  await t.throwsAsync(
+    modify('ma5', '0', 'title', 'x', '3', 'value', Buffer.alloc(3))
+  )
+  t.is(
+    await client.redis.exists('ma5'),
+    0,
+    'an invalid new node is not created'
+  )
+
+  await client.destroy()
+})
+
+test.serial('modify.batch - a reply for each node', async t => {
+  const client = connect({ port }, { loglevel: 'info' })
+  const batch = (...args: any[]) =>
+    client.redis.command('selva.modify.batch', ...args)
+
+  const replies = await batch(
+    ...['1', 'ma6', '0', 'title', 'six'],
+    ...['2', 'ma7', '0', 'title', 'seven', '3', 'title', increment(0, 1)],
+    ...['0', 'ma8'],
+    ...['1', 'ma9', '0', 'title', 'nine']
+  )
+  t.is(replies.length, 4)
+  t.is(replies[0], 'ma6')
+  t.true(replies[1] instanceof Error)
+  t.regex(replies[1].message, /invalid modify operation/)
+  t.is(replies[2], 'ma8', 'a node without ops is only created')
+  t.is(replies[3], 'ma9', 'an invalid node does not stop the batch')
+
+  t.is(await client.redis.hget('ma6', 'title'), 'six')
+  t.is(await client.redis.exists('ma7'), 0)
+  t.deepEqual(await client.redis.smembers('ma8.parents'), ['root'])
+  t.is(await client.redis.hget('ma9', 'title'), 'nine')
+
+  const truncated = await batch(
+    ...['1', 'ma10', '0', 'title', 'ten'],
+    ...['2', 'ma11', '0', 'title', 'eleven']
+  )
+  t.is(truncated.length, 2)
+  t.is(truncated[0], 'ma10')
+  t.true(truncated[1] instanceof Error)
+  t.regex(truncated[1].message, /invalid batch group/)
+  t.is(await client.redis.exists('ma11'), 0)
+
+  await client.destroy()
+})
@@ -0,0 +1,121 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import { wait } from './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+
+test.before(async t => {
+  port = await getPort()
+  srv = await start({
+    port
+  })
+  await wait(500)
+
+  const client = connect({ port })
+  await client.updateSchema({
+    languages: ['en'],
+    types: {
+      league: {
+        prefix: 'le',
+        fields: {
+          title: { type: 'string' }
+        }
+      },
+      match: {
+        prefix: 'ma',
+        fields: {
+          title: { type: 'string' },
+          value: { type: 'number', search: { type: ['NUMERIC'] } }
+        }
+      }
+    }
+  })
+
+  await client.destroy()
+})
+
+test.after(async t => {
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+const KEY = '___selva_hierarchy'
+
+// A set op replacing the parents with the given node
+const parents = (id: string) => {
+  const header = Buffer.alloc(26)
+  const list = Buffer.from(id)
+
+  header[0] = 1
+  header.writeUInt32LE(header.length, 18)
+  header.writeUInt32LE(list.length, 22)
+  return Buffer.concat([header, list])
+}
+
+test.serial('numindex.range - ids ordered by value', async t => {
+  const client = connect({ port }, { loglevel: 'info' })
+  const modify = (...args: any[]) =>
+    client.redis.command('selva.modify', ...args)
+  const range = (...args: string[]) =>
+    client.redis.command('selva.numindex.range', KEY, 'value', ...args)
+
+  await modify('le1', '0', 'title', 'league')
+  for (const [id, value] of [
+    ['ma1', '3'],
+    ['ma2', '1'],
+    ['ma3', '3'],
+    ['ma4', '-2'],
+    ['ma5', '10']
+  ]) {
+    await modify(id, '5', 'parents', parents('le1'), '0', 'value', value)
+  }
+  await modify('ma6', '0', 'value', '5')
+  await modify('ma7', '0', 'title', 'no value')
+
+  t.deepEqual(
+    await range('-inf', '+inf'),
+    ['ma4', 'ma2', 'ma1', 'ma3', 'ma6', 'ma5'],
+    'equal values are ordered by id'
+  )
+  t.deepEqual(await range('1', '3'), ['ma2', 'ma1', 'ma3'], 'inclusive')
+  t.deepEqual(await range('1', '3', 'REV'), ['ma3', 'ma1', 'ma2'])
+  t.deepEqual(await range('-inf', '+inf', 'OFFSET', '1', 'LIMIT', '2'), [
+    'ma2',
+    'ma1'
+  ])
+  t.deepEqual(await range('-inf', '+inf', 'LIMIT', '0'), [])
+  t.deepEqual(await range('-inf', '+inf', 'IDS', 'ma1\0ma5\0ma7'), [
+    'ma1',
+    'ma5'
+  ])
+  t.deepEqual(await range('0', '+inf', 'DESCENDANTS', 'le1'), [
+    'ma2',
+    'ma1',
+    'ma3',
+    'ma5'
+  ])
+
+  await modify('ma5', '0', 'value', '-5')
+  await modify('ma4', '6', 'value', '')
+  await client.redis.hset('ma2', 'value', '20')
+  t.deepEqual(
+    await range('-inf', '+inf'),
+    ['ma5', 'ma1', 'ma3', 'ma6', 'ma2'],
+    'the index follows the writes, including plain hash writes'
+  )
+
+  await t.throwsAsync(range('x', '1'), { message: /invalid range/ })
+  await t.throwsAsync(range('0', '1', 'LIMIT', '-1'), {
+    message: /invalid limit/
+  })
+  await t.throwsAsync(
+    client.redis.command('selva.numindex.range', KEY, 'title', '0', '1'),
+    { message: /not a numeric index field/ }
+  )
+
+  await client.destroy()
+})
@@ -0,0 +1,64 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import { wait } from './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+
+test.before(async t => {
+  port = await getPort()
+  srv = await start({
+    port
+  })
+  await wait(500)
+})
+
+test.after(async t => {
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+test.serial('set.reset - replies with the added and removed', async t => {
+  const client = connect({ port }, { loglevel: 'info' })
+  const reset = async (...args: string[]) => {
+    const [added, removed] = await client.redis.command(
+      'selva.set.reset',
+      ...args
+    )
+    return [added.sort(), removed.sort()]
+  }
+
+  t.deepEqual(await reset('ma1.tags', 'a', 'b', 'c'), [['a', 'b', 'c'], []])
+  t.deepEqual((await client.redis.smembers('ma1.tags')).sort(), [
+    'a',
+    'b',
+    'c'
+  ])
+
+  t.deepEqual(await reset('ma1.tags', 'c', 'd', 'a', 'd'), [['d'], ['b']])
+  t.deepEqual((await client.redis.smembers('ma1.tags')).sort(), [
+    'a',
+    'c',
+    'd'
+  ])
+
+  t.deepEqual(
+    await reset('ma1.tags', 'a', 'c', 'd'),
+    [[], []],
+    'the same members change nothing'
+  )
+
+  t.deepEqual(await reset('ma1.tags'), [[], ['a', 'c', 'd']])
+  t.is(await client.redis.exists('ma1.tags'), 0)
+
+  await client.redis.set('ma1.string', 'x')
+  await t.throwsAsync(
+    client.redis.command('selva.set.reset', 'ma1.string', 'a'),
+    { message: /WRONGTYPE/ }
+  )
+
+  await client.destroy()
+})
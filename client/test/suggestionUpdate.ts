@@ -0,0 +1,70 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import { wait } from './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+
+test.before(async t => {
+  port = await getPort()
+  srv = await start({
+    port
+  })
+  await wait(500)
+})
+
+test.after(async t => {
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+test.serial('suggestion.update - counts the phrases of a text', async t => {
+  const client = connect({ port }, { loglevel: 'info' })
+  const update = (...args: string[]) =>
+    client.redis.command('selva.suggestion.update', ...args)
+  const suggest = async (prefix: string) =>
+    ((await client.redis.command('FT.SUGGET', 'sug', prefix)) || []).sort()
+
+  t.is(
+    await update('', 'Hello  Big World '),
+    5,
+    'every word and every run of words ending at the last one'
+  )
+  t.deepEqual(await client.redis.hgetall('sug_counts'), {
+    hello: '1',
+    'hello big world': '1',
+    big: '1',
+    'big world': '1',
+    world: '1'
+  })
+  t.deepEqual(await suggest('hel'), ['hello', 'hello big world'])
+
+  t.is(
+    await update('Hello Big World', 'big world'),
+    2,
+    'the phrases in both texts are unchanged'
+  )
+  t.deepEqual(await client.redis.hgetall('sug_counts'), {
+    big: '1',
+    'big world': '1',
+    world: '1'
+  })
+  t.deepEqual(await suggest('hel'), [])
+
+  t.is(await update('', 'world cup', 'big world', ''), 4)
+  t.deepEqual(await client.redis.hgetall('sug_counts'), {
+    world: '1',
+    'world cup': '1',
+    cup: '1'
+  })
+  t.deepEqual(await suggest('big'), [])
+  t.deepEqual(await suggest('wor'), ['world', 'world cup'])
+
+  t.is(await update('same text', 'Same  text'), 0)
+  await t.throwsAsync(update('odd'))
+
+  await client.destroy()
+})
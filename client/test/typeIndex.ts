@@ -0,0 +1,92 @@
+import test from 'ava'
+import { connect } from '../src/index'
+import { start } from '@saulx/selva-server'
+import './assertions'
+import { wait } from './assertions'
+import getPort from 'get-port'
+
+let srv
+let port: number
+
+test.before(async t => {
+  port = await getPort()
+  srv = await start({
+    port
+  })
+  await wait(500)
+})
+
+test.after(async t => {
+  await srv.destroy()
+  await t.connectionsAreEmpty()
+})
+
+// The type index follows the nodes of the default hierarchy
+const KEY = '___selva_hierarchy'
+
+test.serial('type index - filter and scan by type prefix', async t => {
+  const client = connect({ port }, { loglevel: 'info' })
+  const add = (id: string, ...parents: string[]) =>
+    client.redis.command('selva.hierarchy.add', KEY, id, ...parents)
+
+  await add('root')
+  await add('le1', 'root')
+  for (let i = 0; i < 5; i++) {
+    await add('ma' + i, 'le1')
+  }
+  await add('vi1', 'ma0')
+
+  t.deepEqual(
+    await client.redis.command(
+      'selva.type.filter',
+      'mavi',
+      'vi1',
+      'le1',
+      'ma3',
+      'ma9',
+      'x'
+    ),
+    ['vi1', 'ma3'],
+    'the ids that exist and are of the types, in the given order'
+  )
+  t.deepEqual(await client.redis.command('selva.type.filter', 'le', 'ma1'), [])
+  await t.throwsAsync(client.redis.command('selva.type.filter', 'mav', 'ma1'))
+
+  const scanned: string[] = []
+  let cursor = '0'
+  let pages = 0
+  do {
+    const [next, ids] = await client.redis.command(
+      'selva.type.scan',
+      'ma',
+      cursor,
+      'COUNT',
+      '2'
+    )
+    t.true(ids.length <= 2)
+    scanned.push(...ids)
+    cursor = next
+    pages++
+  } while (cursor !== '0' && pages < 10)
+
+  t.deepEqual(scanned, ['ma0', 'ma1', 'ma2', 'ma3', 'ma4'], 'in id order')
+  t.is(pages, 3)
+
+  t.deepEqual(await client.redis.command('selva.type.scan', 'zz', '0'), [
+    '0',
+    []
+  ])
+  await t.throwsAsync(
+    client.redis.command('selva.type.scan', 'ma', '0', 'COUNT', '0')
+  )
+
+  await client.redis.command('selva.hierarchy.del', KEY, 'ma2')
+  t.deepEqual(
+    await client.redis.command('selva.type.scan', 'ma', '0'),
+    ['0', ['ma0', 'ma1', 'ma3', 'ma4']],
+    'a removed node leaves the index'
+  )
+
+  await client.redis.del(KEY)
+  await client.destroy()
+})
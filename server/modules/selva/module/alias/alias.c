@@ -0,0 +1,206 @@
+#include <string.h>
+
+#include "../../redismodule.h"
+#include "../modify/modify.h"
+#include "./alias.h"
+
+static RedisModuleString *getAliasesKey(RedisModuleCtx *ctx, RedisModuleString *id) {
+  size_t id_len;
+  const char *id_str = RedisModule_StringPtrLen(id, &id_len);
+
+  return RedisModule_CreateStringPrintf(ctx, "%.*s.aliases", (int)id_len, id_str);
+}
+
+static void publishAliases(RedisModuleString *id) {
+  size_t id_len;
+  const char *id_str = RedisModule_StringPtrLen(id, &id_len);
+
+  SelvaModify_PublishUpdate(id_str, id_len, "aliases", sizeof("aliases") - 1);
+}
+
+RedisModuleKey *SelvaAlias_OpenIndex(RedisModuleCtx *ctx) {
+  RedisModuleString *key_name = RedisModule_CreateString(ctx, SELVA_ALIASES_KEY, sizeof(SELVA_ALIASES_KEY) - 1);
+  RedisModuleKey *key = RedisModule_OpenKey(ctx, key_name, REDISMODULE_READ | REDISMODULE_WRITE);
+  const int type = RedisModule_KeyType(key);
+
+  RedisModule_FreeString(ctx, key_name);
+  if (type != REDISMODULE_KEYTYPE_EMPTY && type != REDISMODULE_KEYTYPE_HASH) {
+    RedisModule_CloseKey(key);
+    return NULL;
+  }
+
+  return key;
+}
+
+int SelvaAlias_Set(RedisModuleCtx *ctx, RedisModuleKey *index, RedisModuleString *id, RedisModuleString *alias, int nx, RedisModuleString **prev) {
+  RedisModuleString *current = NULL;
+
+  RedisModule_HashGet(index, REDISMODULE_HASH_NONE, alias, &current, NULL);
+  *prev = current;
+  if (current && (nx || !RedisModule_StringCompare(current, id))) {
+    return 0;
+  }
+
+  if (current) {
+    RedisModule_Call(ctx, "SREM", "ss", getAliasesKey(ctx, current), alias);
+    publishAliases(current);
+  }
+
+  RedisModule_HashSet(index, REDISMODULE_HASH_NONE, alias, id, NULL);
+  RedisModule_Call(ctx, "SADD", "ss", getAliasesKey(ctx, id), alias);
+  publishAliases(id);
+
+  return 1;
+}
+
+int SelvaAlias_Del(RedisModuleCtx *ctx, RedisModuleKey *index, RedisModuleString *alias, RedisModuleString *id) {
+  RedisModuleString *current = NULL;
+
+  RedisModule_HashGet(index, REDISMODULE_HASH_NONE, alias, &current, NULL);
+  if (!current) {
+    return 0;
+  }
+  if (id && RedisModule_StringCompare(current, id)) {
+    RedisModule_FreeString(ctx, current);
+    return 0;
+  }
+
+  RedisModule_HashSet(index, REDISMODULE_HASH_NONE, alias, REDISMODULE_HASH_DELETE, NULL);
+  RedisModule_Call(ctx, "SREM", "ss", getAliasesKey(ctx, current), alias);
+  publishAliases(current);
+  RedisModule_FreeString(ctx, current);
+
+  return 1;
+}
+
+// Replies with the previous owner of each alias or nil. With nx an alias
+// is claimed only if it's free, so a reply other than nil or id means the
+// alias is owned by another node.
+static int aliasSet(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, int nx) {
+  RedisModule_AutoMemory(ctx);
+
+  int changed = 0;
+  int i = 2;
+
+  if (argc <= i) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  RedisModuleKey *index = SelvaAlias_OpenIndex(ctx);
+  if (!index) {
+    return RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+  }
+
+  RedisModule_ReplyWithArray(ctx, argc - i);
+  for (; i < argc; i++) {
+    RedisModuleString *prev;
+
+    changed |= SelvaAlias_Set(ctx, index, argv[1], argv[i], nx, &prev);
+    if (prev) {
+      RedisModule_ReplyWithString(ctx, prev);
+    } else {
+      RedisModule_ReplyWithNull(ctx);
+    }
+  }
+  RedisModule_CloseKey(index);
+
+  if (changed) {
+    RedisModule_ReplicateVerbatim(ctx);
+    SelvaModify_FlushUpdates();
+  }
+
+  return REDISMODULE_OK;
+}
+
+// SELVA.ALIAS.SET id alias [alias ...]
+int SelvaCommand_AliasSet(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  return aliasSet(ctx, argv, argc, 0);
+}
+
+// SELVA.ALIAS.SETNX id alias [alias ...]
+// A separate command rather than a flag so that no alias can be taken for it
+int SelvaCommand_AliasSetNx(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  return aliasSet(ctx, argv, argc, 1);
+}
+
+// SELVA.ALIAS.DEL id alias [alias ...]
+// Removes the aliases of id. An alias another node has taken over is only
+// removed from the aliases of id.
+int SelvaCommand_AliasDel(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  RedisModule_AutoMemory(ctx);
+
+  long long nr_deleted = 0;
+
+  if (argc < 3) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  RedisModuleKey *index = SelvaAlias_OpenIndex(ctx);
+  if (!index) {
+    return RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+  }
+
+  RedisModuleString *aliases_key = getAliasesKey(ctx, argv[1]);
+  for (int i = 2; i < argc; i++) {
+    if (SelvaAlias_Del(ctx, index, argv[i], argv[1])) {
+      nr_deleted++;
+    } else {
+      RedisModule_Call(ctx, "SREM", "ss", aliases_key, argv[i]);
+    }
+  }
+  RedisModule_CloseKey(index);
+
+  if (nr_deleted > 0) {
+    SelvaModify_FlushUpdates();
+  }
+  RedisModule_ReplicateVerbatim(ctx);
+
+  return RedisModule_ReplyWithLongLong(ctx, nr_deleted);
+}
+
+// SELVA.ALIAS.RESOLVE alias [alias ...]
+// Replies with the id of each alias or nil.
+int SelvaCommand_AliasResolve(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  RedisModule_AutoMemory(ctx);
+
+  if (argc < 2) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  RedisModuleString *key_name = RedisModule_CreateString(ctx, SELVA_ALIASES_KEY, sizeof(SELVA_ALIASES_KEY) - 1);
+  RedisModuleKey *index = RedisModule_OpenKey(ctx, key_name, REDISMODULE_READ);
+  const int type = RedisModule_KeyType(index);
+
+  if (type != REDISMODULE_KEYTYPE_EMPTY && type != REDISMODULE_KEYTYPE_HASH) {
+    return RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+  }
+
+  RedisModule_ReplyWithArray(ctx, argc - 1);
+  for (int i = 1; i < argc; i++) {
+    RedisModuleString *id = NULL;
+
+    if (type == REDISMODULE_KEYTYPE_HASH) {
+      RedisModule_HashGet(index, REDISMODULE_HASH_NONE, argv[i], &id, NULL);
+    }
+
+    if (id) {
+      RedisModule_ReplyWithString(ctx, id);
+      RedisModule_FreeString(ctx, id);
+    } else {
+      RedisModule_ReplyWithNull(ctx);
+    }
+  }
+
+  return REDISMODULE_OK;
+}
+
+int SelvaAlias_OnLoad(RedisModuleCtx *ctx) {
+  if (RedisModule_CreateCommand(ctx, "selva.alias.set", SelvaCommand_AliasSet, "write deny-oom", 0, 0, 0) == REDISMODULE_ERR ||
+      RedisModule_CreateCommand(ctx, "selva.alias.setnx", SelvaCommand_AliasSetNx, "write deny-oom", 0, 0, 0) == REDISMODULE_ERR ||
+      RedisModule_CreateCommand(ctx, "selva.alias.del", SelvaCommand_AliasDel, "write", 0, 0, 0) == REDISMODULE_ERR ||
+      RedisModule_CreateCommand(ctx, "selva.alias.resolve", SelvaCommand_AliasResolve, "readonly", 0, 0, 0) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  return REDISMODULE_OK;
+}
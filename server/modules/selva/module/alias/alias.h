@@ -0,0 +1,23 @@
+#pragma once
+#ifndef SELVA_ALIAS
+#define SELVA_ALIAS
+
+// alias -> id; the aliases of each node are also kept in the set <id>.aliases
+#define SELVA_ALIASES_KEY "___selva_aliases"
+
+// Open the alias hash for writing. Returns NULL if the key holds some other type.
+RedisModuleKey *SelvaAlias_OpenIndex(RedisModuleCtx *ctx);
+
+// Point alias to id. The alias is taken over from its current owner
+// unless nx is set, in which case an alias owned by another node is left
+// as is. Returns 1 if the alias changed and sets prev to its previous owner
+// or NULL.
+int SelvaAlias_Set(RedisModuleCtx *ctx, RedisModuleKey *index, RedisModuleString *id, RedisModuleString *alias, int nx, RedisModuleString **prev);
+
+// Remove an alias. If id is given the alias is only removed if id owns it.
+// Returns 1 if the alias was removed.
+int SelvaAlias_Del(RedisModuleCtx *ctx, RedisModuleKey *index, RedisModuleString *alias, RedisModuleString *id);
+
+int SelvaAlias_OnLoad(RedisModuleCtx *ctx);
+
+#endif /* SELVA_ALIAS */
@@ -0,0 +1,342 @@
+#include <string.h>
+#include <strings.h>
+
+#include "../../redismodule.h"
+#include "../../rmutil/vector.h"
+#include "../alias/alias.h"
+#include "../hierarchy/hierarchy.h"
+#include "../modify/modify.h"
+#include "../numindex/numindex.h"
+#include "../schema/schema.h"
+#include "../suggestion/suggestion.h"
+#include "../typeindex/typeindex.h"
+#include "./delete.h"
+
+#define SET_FIELD_MARKER "___selva_$set"
+
+struct DeleteArgs {
+  RedisModuleCtx *ctx;
+  int recursive;
+  // RedisModuleString * of the deleted ids in the order they were found
+  Vector *ids;
+  // The deleted ids for lookups
+  RedisModuleDict *deleted;
+  // RedisModuleString * of the surviving children that lost a parent
+  Vector *changed;
+};
+
+static void addDeleted(struct DeleteArgs *args, RedisModuleString *id) {
+  Vector_Push(args->ids, id);
+  RedisModule_DictSet(args->deleted, id, NULL);
+}
+
+static int isDeleted(struct DeleteArgs *args, RedisModuleString *id) {
+  int nokey;
+
+  RedisModule_DictGet(args->deleted, id, &nokey);
+  return !nokey;
+}
+
+static RedisModuleString *getSetKey(RedisModuleCtx *ctx, RedisModuleString *id, const char *field) {
+  size_t id_len;
+  const char *id_str = RedisModule_StringPtrLen(id, &id_len);
+
+  return RedisModule_CreateStringPrintf(ctx, "%.*s.%s", (int)id_len, id_str, field);
+}
+
+static RedisModuleCallReply *getMembers(RedisModuleCtx *ctx, RedisModuleString *id, const char *field) {
+  return RedisModule_Call(ctx, "SMEMBERS", "s", getSetKey(ctx, id, field));
+}
+
+// Remove id from the children sets of its surviving parents
+static void unlinkParents(struct DeleteArgs *args, RedisModuleString *id) {
+  RedisModuleCtx *ctx = args->ctx;
+  RedisModuleCallReply *reply = getMembers(ctx, id, "parents");
+  const size_t n = reply ? RedisModule_CallReplyLength(reply) : 0;
+
+  for (size_t i = 0; i < n; i++) {
+    RedisModuleString *parent = RedisModule_CreateStringFromCallReply(RedisModule_CallReplyArrayElement(reply, i));
+    size_t parent_len;
+    const char *parent_str = RedisModule_StringPtrLen(parent, &parent_len);
+
+    if (!isDeleted(args, parent)) {
+      RedisModule_Call(ctx, "SREM", "ss", getSetKey(ctx, parent, "children"), id);
+      SelvaModify_PublishUpdate(parent_str, parent_len, "children", 8);
+    }
+  }
+}
+
+// Remove id from the parents sets of its surviving children. With recursive a
+// child left without parents is deleted too, otherwise its ancestors change.
+static void unlinkChildren(struct DeleteArgs *args, RedisModuleString *id) {
+  RedisModuleCtx *ctx = args->ctx;
+  RedisModuleCallReply *reply = getMembers(ctx, id, "children");
+  const size_t n = reply ? RedisModule_CallReplyLength(reply) : 0;
+
+  for (size_t i = 0; i < n; i++) {
+    RedisModuleString *child = RedisModule_CreateStringFromCallReply(RedisModule_CallReplyArrayElement(reply, i));
+    size_t child_len;
+    const char *child_str = RedisModule_StringPtrLen(child, &child_len);
+    RedisModuleString *parents_key;
+
+    if (isDeleted(args, child)) {
+      continue;
+    }
+
+    parents_key = getSetKey(ctx, child, "parents");
+    RedisModule_Call(ctx, "SREM", "ss", parents_key, id);
+    if (args->recursive &&
+        RedisModule_CallReplyInteger(RedisModule_Call(ctx, "SCARD", "s", parents_key)) == 0) {
+      addDeleted(args, child);
+    } else {
+      Vector_Push(args->changed, child);
+      SelvaModify_PublishUpdate(child_str, child_len, "parents", 7);
+    }
+  }
+}
+
+static void deleteAliases(RedisModuleCtx *ctx, RedisModuleKey *aliases, RedisModuleString *id) {
+  RedisModuleCallReply *reply = getMembers(ctx, id, "aliases");
+  const size_t n = reply ? RedisModule_CallReplyLength(reply) : 0;
+
+  for (size_t i = 0; i < n; i++) {
+    SelvaAlias_Del(ctx, aliases, RedisModule_CreateStringFromCallReply(RedisModule_CallReplyArrayElement(reply, i)), id);
+  }
+}
+
+// Count the word prefixes of text the same way they were counted in when the text was set
+static void collectSuggestions(RedisModuleCtx *ctx, RedisModuleKey *key, const struct SelvaSchema *schema, const char *id_str) {
+  const struct SelvaSchema_StrList *fields = SelvaSchema_GetSugFields(schema, id_str);
+
+  for (size_t i = 0; i < fields->nr; i++) {
+    for (size_t j = 0; j < schema->languages.nr; j++) {
+      RedisModuleString *text = NULL;
+
+      RedisModule_HashGet(key, REDISMODULE_HASH_NONE,
+          RedisModule_CreateStringPrintf(ctx, "%s.%s", fields->strs[i], schema->languages.strs[j]), &text, NULL);
+      if (text) {
+        SelvaSuggestion_Update(text, NULL);
+      }
+    }
+  }
+}
+
+// Delete the data of a node. Its own keys are added to keys for unlinking.
+static void deleteNode(struct DeleteArgs *args, RedisModuleKey *aliases, RedisModuleString *id, Vector *keys) {
+  RedisModuleCtx *ctx = args->ctx;
+  const struct SelvaSchema *schema = SelvaSchema_Get();
+  static const char * const suffixes[] = { "children", "parents", "ancestors", "_depth", "aliases" };
+  size_t id_len;
+  const char *id_str = RedisModule_StringPtrLen(id, &id_len);
+  RedisModuleCallReply *reply;
+  size_t n;
+  char *fields;
+  size_t fields_len = 0;
+
+  deleteAliases(ctx, aliases, id);
+
+  if (schema) {
+    RedisModuleKey *key = RedisModule_OpenKey(ctx, id, REDISMODULE_READ);
+
+    if (RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_HASH) {
+      collectSuggestions(ctx, key, schema, id_str);
+    }
+    RedisModule_CloseKey(key);
+  }
+
+  reply = RedisModule_Call(ctx, "HGETALL", "s", id);
+  n = reply && RedisModule_CallReplyType(reply) == REDISMODULE_REPLY_ARRAY ? RedisModule_CallReplyLength(reply) : 0;
+  // The names and separators can't be longer than the names of all fields
+  for (size_t i = 0; i + 1 < n; i += 2) {
+    size_t field_len;
+
+    RedisModule_CallReplyStringPtr(RedisModule_CallReplyArrayElement(reply, i), &field_len);
+    fields_len += field_len + 1;
+  }
+  fields = RedisModule_PoolAlloc(ctx, fields_len + 1);
+  fields_len = 0;
+
+  for (size_t i = 0; i + 1 < n; i += 2) {
+    size_t field_len, value_len;
+    const char *field_str = RedisModule_CallReplyStringPtr(RedisModule_CallReplyArrayElement(reply, i), &field_len);
+    const char *value_str = RedisModule_CallReplyStringPtr(RedisModule_CallReplyArrayElement(reply, i + 1), &value_len);
+
+    if (value_len == sizeof(SET_FIELD_MARKER) - 1 && !memcmp(value_str, SET_FIELD_MARKER, value_len)) {
+      RedisModuleString *set_key = RedisModule_CreateStringPrintf(ctx, "%.*s.%.*s", (int)id_len, id_str, (int)field_len, field_str);
+
+      Vector_Push(keys, set_key);
+    }
+
+    if ((field_len >= 10 && !memcmp(field_str, "___escaped", 10)) ||
+        (field_len >= 8 && !memcmp(field_str, "$source_", 8))) {
+      continue;
+    }
+
+    if (fields_len > 0) {
+      fields[fields_len++] = ',';
+    }
+    memcpy(fields + fields_len, field_str, field_len);
+    fields_len += field_len;
+  }
+
+  Vector_Push(keys, id);
+  for (size_t i = 0; i < sizeof(suffixes) / sizeof(*suffixes); i++) {
+    RedisModuleString *key_name = RedisModule_CreateStringPrintf(ctx, "%.*s.%s", (int)id_len, id_str, suffixes[i]);
+
+    Vector_Push(keys, key_name);
+  }
+
+  for (size_t i = 0; schema && i < schema->nr_search_indexes; i++) {
+    RedisModule_Call(ctx, "FT.DEL", "cs", schema->search_indexes[i].name, id);
+  }
+  SelvaTypeIndex_Del(id_str, id_len);
+  SelvaNumIndex_DelNode(id_str, id_len);
+  SelvaModify_PublishDelete(id_str, id_len, fields, fields_len);
+}
+
+// The default hierarchy if it exists, it only has the nodes written by the module
+static int openHierarchy(RedisModuleCtx *ctx, SelvaModify_Hierarchy **hierarchy) {
+  RedisModuleString *hkey_name = RedisModule_CreateString(ctx, HIERARCHY_DEFAULT_KEY, sizeof(HIERARCHY_DEFAULT_KEY) - 1);
+  RedisModuleKey *key = RedisModule_OpenKey(ctx, hkey_name, REDISMODULE_READ);
+  const int type = RedisModule_KeyType(key);
+
+  RedisModule_CloseKey(key);
+  *hierarchy = NULL;
+  if (type == REDISMODULE_KEYTYPE_EMPTY) {
+    return REDISMODULE_OK;
+  }
+
+  *hierarchy = SelvaModify_OpenHierarchyKey(ctx, hkey_name, REDISMODULE_WRITE);
+  return *hierarchy ? REDISMODULE_OK : REDISMODULE_ERR;
+}
+
+// SELVA.DELETE id [RECURSIVE]
+// Delete a node, and with RECURSIVE every descendant left without parents.
+// The edges are read from the parents and children sets so the nodes written
+// from Lua are deleted as well.
+// Replies with the deleted ids and the surviving children that lost a parent,
+// their ancestors need to be recomputed.
+int SelvaCommand_Delete(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  RedisModule_AutoMemory(ctx);
+
+  struct DeleteArgs args = { .ctx = ctx };
+  SelvaModify_Hierarchy *hierarchy;
+  Selva_NodeId id;
+
+  if (argc < 2 || argc > 3) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  if (argc == 3) {
+    if (strcasecmp(RedisModule_StringPtrLen(argv[2], NULL), "RECURSIVE")) {
+      return RedisModule_ReplyWithError(ctx, "ERR syntax error");
+    }
+    args.recursive = 1;
+  }
+
+  if (SelvaModify_ParseNodeId(id, argv[1]) == REDISMODULE_ERR) {
+    return RedisModule_ReplyWithError(ctx, "ERR invalid node id");
+  }
+
+  if (!SelvaSchema_Get()) {
+    SelvaSchema_Load(ctx);
+  }
+
+  if (openHierarchy(ctx, &hierarchy) == REDISMODULE_ERR) {
+    return REDISMODULE_OK;
+  }
+
+  RedisModuleKey *aliases = SelvaAlias_OpenIndex(ctx);
+  if (!aliases) {
+    return RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+  }
+
+  args.ids = NewVector(RedisModuleString *, 16);
+  args.deleted = RedisModule_CreateDict(ctx);
+  args.changed = NewVector(RedisModuleString *, 16);
+
+  if (RedisModule_CallReplyInteger(RedisModule_Call(ctx, "EXISTS", "sss", argv[1],
+          getSetKey(ctx, argv[1], "parents"), getSetKey(ctx, argv[1], "children"))) > 0) {
+    addDeleted(&args, argv[1]);
+  }
+
+  // The orphans found while unlinking are appended to the ids
+  for (size_t i = 0; i < (size_t)Vector_Size(args.ids); i++) {
+    RedisModuleString *deleted_id;
+
+    Vector_Get(args.ids, i, &deleted_id);
+    unlinkParents(&args, deleted_id);
+    unlinkChildren(&args, deleted_id);
+  }
+
+  const size_t nr_deleted = Vector_Size(args.ids);
+  Vector *keys = NewVector(RedisModuleString *, 8 * nr_deleted + 1);
+
+  for (size_t i = 0; i < nr_deleted; i++) {
+    RedisModuleString *deleted_id;
+    Selva_NodeId node_id;
+
+    Vector_Get(args.ids, i, &deleted_id);
+    deleteNode(&args, aliases, deleted_id, keys);
+    if (hierarchy && SelvaModify_ParseNodeId(node_id, deleted_id) == REDISMODULE_OK) {
+      SelvaModify_DelHierarchyNode(hierarchy, node_id);
+    }
+  }
+  RedisModule_CloseKey(aliases);
+
+  // The keys are freed in the background
+  if (Vector_Size(keys) > 0) {
+    RedisModule_Call(ctx, "UNLINK", "v", (RedisModuleString **)keys->data, (size_t)Vector_Size(keys));
+  }
+  SelvaSuggestion_Flush(ctx);
+
+  if (hierarchy) {
+    SelvaModify_HierarchyRecompute(hierarchy);
+  }
+  SelvaModify_FlushUpdates();
+
+  if (nr_deleted > 0) {
+    RedisModule_ReplicateVerbatim(ctx);
+  }
+
+  RedisModule_ReplyWithArray(ctx, 2);
+  RedisModule_ReplyWithArray(ctx, nr_deleted);
+  for (size_t i = 0; i < nr_deleted; i++) {
+    RedisModuleString *deleted_id;
+
+    Vector_Get(args.ids, i, &deleted_id);
+    RedisModule_ReplyWithString(ctx, deleted_id);
+  }
+
+  // A child may lose several parents, or be deleted after losing the first one
+  RedisModuleDict *replied = RedisModule_CreateDict(ctx);
+  long nr_changed = 0;
+
+  RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
+  for (size_t i = 0; i < (size_t)Vector_Size(args.changed); i++) {
+    RedisModuleString *child;
+
+    Vector_Get(args.changed, i, &child);
+    if (!isDeleted(&args, child) && RedisModule_DictSet(replied, child, NULL) == REDISMODULE_OK) {
+      RedisModule_ReplyWithString(ctx, child);
+      nr_changed++;
+    }
+  }
+  RedisModule_ReplySetArrayLength(ctx, nr_changed);
+
+  RedisModule_FreeDict(ctx, replied);
+  RedisModule_FreeDict(ctx, args.deleted);
+  Vector_Free(args.changed);
+  Vector_Free(keys);
+  Vector_Free(args.ids);
+
+  return REDISMODULE_OK;
+}
+
+int SelvaModify_Delete_OnLoad(RedisModuleCtx *ctx) {
+  if (RedisModule_CreateCommand(ctx, "selva.delete", SelvaCommand_Delete, "write", 1, 1, 1) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  return REDISMODULE_OK;
+}
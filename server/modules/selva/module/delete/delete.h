@@ -0,0 +1,7 @@
+#pragma once
+#ifndef SELVA_MODIFY_DELETE
+#define SELVA_MODIFY_DELETE
+
+int SelvaModify_Delete_OnLoad(RedisModuleCtx *ctx);
+
+#endif /* SELVA_MODIFY_DELETE */
@@ -0,0 +1,529 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "../../redismodule.h"
+#include "../schema/json.h"
+#include "./filter.h"
+
+#define SET_FIELD_MARKER "___selva_$set"
+#define JMP_UNPATCHED UINT32_MAX
+
+struct compiler {
+  const char *js;
+  const struct SelvaJson_Token *tokens;
+  int nr_tokens;
+  struct SelvaFilter_Program *prog;
+  size_t insns_cap;
+  size_t fields_cap;
+  size_t values_cap;
+};
+
+static void *grow(void *p, size_t *cap, size_t n, size_t size) {
+  if (n < *cap) {
+    return p;
+  }
+
+  *cap = *cap ? 2 * *cap : 8;
+  return RedisModule_Realloc(p, *cap * size);
+}
+
+static size_t emit(struct compiler *c, enum SelvaFilter_Opcode op, uint16_t field, uint32_t arg) {
+  struct SelvaFilter_Program *prog = c->prog;
+
+  prog->insns = grow(prog->insns, &c->insns_cap, prog->nr_insns, sizeof(struct SelvaFilter_Insn));
+  prog->insns[prog->nr_insns] = (struct SelvaFilter_Insn){
+    .op = op,
+    .field = field,
+    .arg = arg,
+  };
+
+  return prog->nr_insns++;
+}
+
+// Copy a JSON string unescaped and NUL terminated. Returns NULL on a malformed escape.
+static char *copyString(const char *js, const struct SelvaJson_Token *t, size_t *len) {
+  const char *s = js + t->start;
+  const size_t n = t->end - t->start;
+  char *out = RedisModule_Alloc(n + 1);
+  size_t j = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    if (s[i] != '\\' || t->type != SELVA_JSON_STRING) {
+      out[j++] = s[i];
+      continue;
+    }
+    if (++i == n) {
+      goto fail;
+    }
+
+    switch (s[i]) {
+    case '"':
+    case '\\':
+    case '/':
+      out[j++] = s[i];
+      break;
+    case 'b':
+      out[j++] = '\b';
+      break;
+    case 'f':
+      out[j++] = '\f';
+      break;
+    case 'n':
+      out[j++] = '\n';
+      break;
+    case 'r':
+      out[j++] = '\r';
+      break;
+    case 't':
+      out[j++] = '\t';
+      break;
+    case 'u': {
+      char hex[5] = { 0 };
+      char *end;
+      unsigned long cp;
+
+      if (n - i - 1 < 4) {
+        goto fail;
+      }
+      memcpy(hex, s + i + 1, 4);
+      cp = strtoul(hex, &end, 16);
+      if (end != hex + 4 || (cp >= 0xd800 && cp <= 0xdfff)) {
+        // Surrogate pairs are not supported
+        goto fail;
+      }
+      i += 4;
+
+      // An escape is six characters so the UTF-8 always fits
+      if (cp < 0x80) {
+        out[j++] = (char)cp;
+      } else if (cp < 0x800) {
+        out[j++] = (char)(0xc0 | (cp >> 6));
+        out[j++] = (char)(0x80 | (cp & 0x3f));
+      } else {
+        out[j++] = (char)(0xe0 | (cp >> 12));
+        out[j++] = (char)(0x80 | ((cp >> 6) & 0x3f));
+        out[j++] = (char)(0x80 | (cp & 0x3f));
+      }
+      break;
+    }
+    default:
+      goto fail;
+    }
+  }
+
+  out[j] = '\0';
+  *len = j;
+  return out;
+fail:
+  RedisModule_Free(out);
+  return NULL;
+}
+
+static int addField(struct compiler *c, int tok) {
+  struct SelvaFilter_Program *prog = c->prog;
+  size_t len;
+  char *field = copyString(c->js, &c->tokens[tok], &len);
+
+  if (!field) {
+    return -1;
+  }
+
+  for (size_t i = 0; i < prog->nr_fields; i++) {
+    if (!strcmp(prog->fields[i], field)) {
+      RedisModule_Free(field);
+      return (int)i;
+    }
+  }
+  if (prog->nr_fields > UINT16_MAX) {
+    RedisModule_Free(field);
+    return -1;
+  }
+
+  prog->fields = grow(prog->fields, &c->fields_cap, prog->nr_fields, sizeof(char *));
+  prog->fields[prog->nr_fields] = field;
+
+  return (int)prog->nr_fields++;
+}
+
+static long addValue(struct compiler *c, int tok, int numeric) {
+  struct SelvaFilter_Program *prog = c->prog;
+  const struct SelvaJson_Token *t = &c->tokens[tok];
+  struct SelvaFilter_Value value = { 0 };
+
+  if (t->type != SELVA_JSON_STRING && t->type != SELVA_JSON_PRIMITIVE) {
+    return -1;
+  }
+
+  value.str = copyString(c->js, t, &value.len);
+  if (!value.str) {
+    return -1;
+  }
+
+  if (numeric) {
+    char *end;
+
+    value.num = strtod(value.str, &end);
+    if (value.len == 0 || *end != '\0') {
+      RedisModule_Free(value.str);
+      return -1;
+    }
+  }
+
+  prog->values = grow(prog->values, &c->values_cap, prog->nr_values, sizeof(struct SelvaFilter_Value));
+  prog->values[prog->nr_values] = value;
+
+  return (long)prog->nr_values++;
+}
+
+// Point the unpatched jumps emitted since start to the current end of the program
+static void patchJumps(struct compiler *c, size_t start) {
+  struct SelvaFilter_Program *prog = c->prog;
+
+  for (size_t i = start; i < prog->nr_insns; i++) {
+    struct SelvaFilter_Insn *insn = &prog->insns[i];
+
+    if ((insn->op == SELVA_FILTER_OP_JMP_FALSE || insn->op == SELVA_FILTER_OP_JMP_TRUE) && insn->arg == JMP_UNPATCHED) {
+      insn->arg = (uint32_t)prog->nr_insns;
+    }
+  }
+}
+
+// Emit op for each of the values, joined like an $or (JMP_TRUE) or an $and (JMP_FALSE)
+static int compileValues(struct compiler *c, enum SelvaFilter_Opcode op, int field, int value, int numeric, enum SelvaFilter_Opcode join) {
+  const size_t start = c->prog->nr_insns;
+  int first = value;
+  int n = 1;
+
+  if (c->tokens[value].type == SELVA_JSON_ARRAY) {
+    first = value + 1;
+    n = c->tokens[value].size;
+    if (n == 0) {
+      return -1;
+    }
+  }
+
+  for (int i = first, k = 0; k < n; k++, i = SelvaJson_Next(c->tokens, c->nr_tokens, i)) {
+    const long v = addValue(c, i, numeric);
+
+    if (v < 0) {
+      return -1;
+    }
+    if (k > 0) {
+      emit(c, join, 0, JMP_UNPATCHED);
+    }
+    emit(c, op, (uint16_t)field, (uint32_t)v);
+  }
+  patchJumps(c, start);
+
+  return 0;
+}
+
+static int compileLeaf(struct compiler *c, int obj) {
+  const char *js = c->js;
+  const struct SelvaJson_Token *tokens = c->tokens;
+  const int field_tok = SelvaJson_ObjectGet(js, tokens, c->nr_tokens, obj, "$field");
+  const int op_tok = SelvaJson_ObjectGet(js, tokens, c->nr_tokens, obj, "$operator");
+  const int value = SelvaJson_ObjectGet(js, tokens, c->nr_tokens, obj, "$value");
+  const int search = SelvaJson_ObjectGet(js, tokens, c->nr_tokens, obj, "$search");
+  int field;
+  int numeric;
+
+  if (field_tok < 0 || op_tok < 0 || (field = addField(c, field_tok)) < 0) {
+    return -1;
+  }
+
+  if (!strcmp(c->prog->fields[field], "id")) {
+    numeric = 0;
+  } else if (search >= 0 && tokens[search].type == SELVA_JSON_ARRAY && tokens[search].size > 0 &&
+             (SelvaJson_StrEq(js, &tokens[search + 1], "NUMERIC") || SelvaJson_StrEq(js, &tokens[search + 1], "TAG"))) {
+    numeric = SelvaJson_StrEq(js, &tokens[search + 1], "NUMERIC");
+  } else {
+    // Text and geo filters need the search index
+    return -1;
+  }
+
+  if (SelvaJson_StrEq(js, &tokens[op_tok], "exists")) {
+    emit(c, SELVA_FILTER_OP_EXISTS, (uint16_t)field, 0);
+    return 0;
+  } else if (SelvaJson_StrEq(js, &tokens[op_tok], "notExists")) {
+    emit(c, SELVA_FILTER_OP_NOT_EXISTS, (uint16_t)field, 0);
+    return 0;
+  }
+
+  if (value < 0) {
+    return -1;
+  }
+
+  if (SelvaJson_StrEq(js, &tokens[op_tok], "=")) {
+    return compileValues(c, numeric ? SELVA_FILTER_OP_EQ_NUM : SELVA_FILTER_OP_EQ, field, value, numeric, SELVA_FILTER_OP_JMP_TRUE);
+  } else if (SelvaJson_StrEq(js, &tokens[op_tok], "!=")) {
+    return compileValues(c, numeric ? SELVA_FILTER_OP_NE_NUM : SELVA_FILTER_OP_NE, field, value, numeric, SELVA_FILTER_OP_JMP_FALSE);
+  } else if (!numeric) {
+    return -1;
+  } else if (SelvaJson_StrEq(js, &tokens[op_tok], ">") && tokens[value].type != SELVA_JSON_ARRAY) {
+    return compileValues(c, SELVA_FILTER_OP_GE, field, value, 1, SELVA_FILTER_OP_JMP_FALSE);
+  } else if (SelvaJson_StrEq(js, &tokens[op_tok], "<") && tokens[value].type != SELVA_JSON_ARRAY) {
+    return compileValues(c, SELVA_FILTER_OP_LE, field, value, 1, SELVA_FILTER_OP_JMP_FALSE);
+  } else if (SelvaJson_StrEq(js, &tokens[op_tok], "..") && tokens[value].type == SELVA_JSON_ARRAY && tokens[value].size == 2) {
+    const long lo = addValue(c, value + 1, 1);
+    const long hi = lo >= 0 ? addValue(c, SelvaJson_Next(tokens, c->nr_tokens, value + 1), 1) : -1;
+
+    if (hi < 0) {
+      return -1;
+    }
+    emit(c, SELVA_FILTER_OP_RANGE, (uint16_t)field, (uint32_t)lo);
+    return 0;
+  }
+
+  return -1;
+}
+
+// The recursion depth is bounded by SELVA_JSON_MAX_DEPTH
+static int compileNode(struct compiler *c, int obj);
+
+static int compileGroup(struct compiler *c, int arr, enum SelvaFilter_Opcode join) {
+  const size_t start = c->prog->nr_insns;
+  const struct SelvaJson_Token *t = &c->tokens[arr];
+
+  // An empty table is encoded as an object
+  if (t->size == 0) {
+    if (join == SELVA_FILTER_OP_JMP_FALSE) {
+      emit(c, SELVA_FILTER_OP_TRUE, 0, 0);
+      return 0;
+    }
+    return -1;
+  }
+  if (t->type != SELVA_JSON_ARRAY) {
+    return -1;
+  }
+
+  for (int i = arr + 1, k = 0; k < t->size; k++, i = SelvaJson_Next(c->tokens, c->nr_tokens, i)) {
+    if (k > 0) {
+      emit(c, join, 0, JMP_UNPATCHED);
+    }
+    if (compileNode(c, i)) {
+      return -1;
+    }
+  }
+  patchJumps(c, start);
+
+  return 0;
+}
+
+static int compileNode(struct compiler *c, int obj) {
+  int and, or;
+
+  if (c->tokens[obj].type != SELVA_JSON_OBJECT) {
+    return -1;
+  }
+
+  and = SelvaJson_ObjectGet(c->js, c->tokens, c->nr_tokens, obj, "$and");
+  or = SelvaJson_ObjectGet(c->js, c->tokens, c->nr_tokens, obj, "$or");
+  if (and >= 0 && or >= 0) {
+    return -1;
+  } else if (and >= 0) {
+    return compileGroup(c, and, SELVA_FILTER_OP_JMP_FALSE);
+  } else if (or >= 0) {
+    return compileGroup(c, or, SELVA_FILTER_OP_JMP_TRUE);
+  }
+
+  return compileLeaf(c, obj);
+}
+
+struct SelvaFilter_Program *SelvaFilter_Compile(const char *js, size_t len) {
+  struct compiler c = {
+    .js = js,
+  };
+  struct SelvaJson_Token *tokens;
+
+  tokens = SelvaJson_Parse(js, len, &c.nr_tokens);
+  if (!tokens) {
+    return NULL;
+  }
+
+  c.tokens = tokens;
+  c.prog = RedisModule_Calloc(1, sizeof(struct SelvaFilter_Program));
+
+  if (compileNode(&c, 0)) {
+    SelvaFilter_Free(c.prog);
+    c.prog = NULL;
+  }
+
+  SelvaJson_Free(tokens);
+
+  return c.prog;
+}
+
+void SelvaFilter_Free(struct SelvaFilter_Program *prog) {
+  if (!prog) {
+    return;
+  }
+
+  for (size_t i = 0; i < prog->nr_fields; i++) {
+    RedisModule_Free(prog->fields[i]);
+  }
+  for (size_t i = 0; i < prog->nr_values; i++) {
+    RedisModule_Free(prog->values[i].str);
+  }
+  RedisModule_Free(prog->insns);
+  RedisModule_Free(prog->fields);
+  RedisModule_Free(prog->values);
+  RedisModule_Free(prog);
+}
+
+struct fieldCache {
+  int fetched;
+  RedisModuleString *value;
+};
+
+static RedisModuleString *getField(RedisModuleCtx *ctx, RedisModuleKey *key, RedisModuleString *id, const struct SelvaFilter_Program *prog, struct fieldCache *cache, uint16_t field) {
+  struct fieldCache *fc = &cache[field];
+
+  if (!fc->fetched) {
+    RedisModule_HashGet(key, REDISMODULE_HASH_CFIELDS, prog->fields[field], &fc->value, NULL);
+    if (!fc->value && !strcmp(prog->fields[field], "id")) {
+      fc->value = RedisModule_CreateStringFromString(ctx, id);
+    }
+    fc->fetched = 1;
+  }
+
+  return fc->value;
+}
+
+static int tagMatches(RedisModuleCtx *ctx, RedisModuleString *id, const char *field, RedisModuleString *stored, const struct SelvaFilter_Value *value) {
+  size_t len;
+  const char *s = RedisModule_StringPtrLen(stored, &len);
+  const char *end = s + len;
+
+  if (len == sizeof(SET_FIELD_MARKER) - 1 && !memcmp(s, SET_FIELD_MARKER, len)) {
+    size_t id_len;
+    const char *id_str = RedisModule_StringPtrLen(id, &id_len);
+    RedisModuleString *set_key = RedisModule_CreateStringPrintf(ctx, "%.*s.%s", (int)id_len, id_str, field);
+    RedisModuleCallReply *reply = RedisModule_Call(ctx, "SISMEMBER", "sb", set_key, value->str, value->len);
+    int res = reply && RedisModule_CallReplyType(reply) == REDISMODULE_REPLY_INTEGER && RedisModule_CallReplyInteger(reply) == 1;
+
+    // Tags match case-insensitively like in ft.search, so fall back to scanning the members
+    if (!res) {
+      if (reply) {
+        RedisModule_FreeCallReply(reply);
+      }
+      reply = RedisModule_Call(ctx, "SMEMBERS", "s", set_key);
+
+      if (reply && RedisModule_CallReplyType(reply) == REDISMODULE_REPLY_ARRAY) {
+        const size_t n = RedisModule_CallReplyLength(reply);
+
+        for (size_t i = 0; i < n && !res; i++) {
+          size_t member_len;
+          const char *member = RedisModule_CallReplyStringPtr(RedisModule_CallReplyArrayElement(reply, i), &member_len);
+
+          res = member && member_len == value->len && !strncasecmp(member, value->str, value->len);
+        }
+      }
+    }
+
+    if (reply) {
+      RedisModule_FreeCallReply(reply);
+    }
+    RedisModule_FreeString(ctx, set_key);
+    return res;
+  }
+
+  // Tag lists are separated with commas
+  while (s <= end) {
+    const char *sep = memchr(s, ',', end - s);
+    const char *tag_end = sep ? sep : end;
+    const char *tag = s;
+
+    while (tag < tag_end && *tag == ' ') {
+      tag++;
+    }
+    while (tag_end > tag && tag_end[-1] == ' ') {
+      tag_end--;
+    }
+    if ((size_t)(tag_end - tag) == value->len && !strncasecmp(tag, value->str, value->len)) {
+      return 1;
+    }
+    if (!sep) {
+      break;
+    }
+    s = sep + 1;
+  }
+
+  return 0;
+}
+
+static int getNumber(RedisModuleString *stored, double *d) {
+  return stored && RedisModule_StringToDouble(stored, d) == REDISMODULE_OK;
+}
+
+int SelvaFilter_Eval(RedisModuleCtx *ctx, const struct SelvaFilter_Program *prog, RedisModuleString *id) {
+  RedisModuleKey *key = RedisModule_OpenKey(ctx, id, REDISMODULE_READ);
+  struct fieldCache *cache;
+  int res = 1;
+
+  if (RedisModule_KeyType(key) != REDISMODULE_KEYTYPE_HASH) {
+    RedisModule_CloseKey(key);
+    return 0;
+  }
+
+  cache = RedisModule_Calloc(prog->nr_fields + 1, sizeof(struct fieldCache));
+
+  for (size_t pc = 0; pc < prog->nr_insns; pc++) {
+    const struct SelvaFilter_Insn *insn = &prog->insns[pc];
+    const struct SelvaFilter_Value *value = insn->arg < prog->nr_values ? &prog->values[insn->arg] : NULL;
+    RedisModuleString *stored;
+    double d;
+
+    switch (insn->op) {
+    case SELVA_FILTER_OP_TRUE:
+      res = 1;
+      break;
+    case SELVA_FILTER_OP_EQ:
+    case SELVA_FILTER_OP_NE:
+      stored = getField(ctx, key, id, prog, cache, insn->field);
+      res = stored && tagMatches(ctx, id, prog->fields[insn->field], stored, value);
+      res ^= insn->op == SELVA_FILTER_OP_NE;
+      break;
+    case SELVA_FILTER_OP_EQ_NUM:
+    case SELVA_FILTER_OP_NE_NUM:
+      res = getNumber(getField(ctx, key, id, prog, cache, insn->field), &d) && d == value->num;
+      res ^= insn->op == SELVA_FILTER_OP_NE_NUM;
+      break;
+    case SELVA_FILTER_OP_GE:
+      res = getNumber(getField(ctx, key, id, prog, cache, insn->field), &d) && d >= value->num;
+      break;
+    case SELVA_FILTER_OP_LE:
+      res = getNumber(getField(ctx, key, id, prog, cache, insn->field), &d) && d <= value->num;
+      break;
+    case SELVA_FILTER_OP_RANGE:
+      res = getNumber(getField(ctx, key, id, prog, cache, insn->field), &d) && d >= value[0].num && d <= value[1].num;
+      break;
+    case SELVA_FILTER_OP_EXISTS:
+    case SELVA_FILTER_OP_NOT_EXISTS:
+      res = !!getField(ctx, key, id, prog, cache, insn->field);
+      res ^= insn->op == SELVA_FILTER_OP_NOT_EXISTS;
+      break;
+    case SELVA_FILTER_OP_JMP_FALSE:
+      if (!res) {
+        pc = insn->arg - 1;
+      }
+      break;
+    case SELVA_FILTER_OP_JMP_TRUE:
+      if (res) {
+        pc = insn->arg - 1;
+      }
+      break;
+    }
+  }
+
+  for (size_t i = 0; i < prog->nr_fields; i++) {
+    if (cache[i].value) {
+      RedisModule_FreeString(ctx, cache[i].value);
+    }
+  }
+  RedisModule_Free(cache);
+  RedisModule_CloseKey(key);
+
+  return res;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#ifndef SELVA_FILTER
+#define SELVA_FILTER
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A filter is compiled into a flat program where every instruction sets
+// a single result register. The leaves of $and and $or are chained with
+// conditional jumps to the end of the group, so evaluation short-circuits
+// without a stack.
+enum SelvaFilter_Opcode {
+  SELVA_FILTER_OP_TRUE,
+  // Case-insensitive match against a tag list or set member, like a TAG field
+  SELVA_FILTER_OP_EQ,
+  SELVA_FILTER_OP_NE,
+  SELVA_FILTER_OP_EQ_NUM,
+  SELVA_FILTER_OP_NE_NUM,
+  // The numeric ranges are inclusive like in ft.search
+  SELVA_FILTER_OP_GE,
+  SELVA_FILTER_OP_LE,
+  SELVA_FILTER_OP_RANGE,
+  SELVA_FILTER_OP_EXISTS,
+  SELVA_FILTER_OP_NOT_EXISTS,
+  SELVA_FILTER_OP_JMP_FALSE,
+  SELVA_FILTER_OP_JMP_TRUE,
+};
+
+struct SelvaFilter_Insn {
+  uint8_t op;
+  uint16_t field;
+  // An index to values, or the jump target
+  uint32_t arg;
+};
+
+struct SelvaFilter_Value {
+  char *str;
+  size_t len;
+  double num;
+};
+
+struct SelvaFilter_Program {
+  size_t nr_insns;
+  struct SelvaFilter_Insn *insns;
+  size_t nr_fields;
+  char **fields;
+  size_t nr_values;
+  struct SelvaFilter_Value *values;
+};
+
+// Compile a $filter fork of the query parser from its JSON encoding.
+// Returns NULL if the filter uses operators or search types that can only be evaluated by ft.search.
+struct SelvaFilter_Program *SelvaFilter_Compile(const char *js, size_t len);
+void SelvaFilter_Free(struct SelvaFilter_Program *prog);
+
+// Returns 1 if the node matches the filter.
+int SelvaFilter_Eval(RedisModuleCtx *ctx, const struct SelvaFilter_Program *prog, RedisModuleString *id);
+
+#endif /* SELVA_FILTER */
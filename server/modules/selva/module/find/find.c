@@ -0,0 +1,137 @@
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#include "../../redismodule.h"
+#include "../filter/filter.h"
+#include "../hierarchy/hierarchy.h"
+#include "../typeindex/typeindex.h"
+#include "./find.h"
+#include "./sort.h"
+
+struct FindDescendantsArgs {
+  RedisModuleCtx *ctx;
+  struct SelvaTypeIndex_Filter *types;
+  long nr_nodes;
+};
+
+static int replyWithDescendant(const Selva_NodeId id, void *arg) {
+  struct FindDescendantsArgs *args = (struct FindDescendantsArgs *)arg;
+
+  if (SelvaTypeIndex_FilterMatches(args->types, id)) {
+    RedisModule_ReplyWithStringBuffer(args->ctx, id, SelvaModify_NodeIdLen(id));
+    args->nr_nodes++;
+  }
+
+  return 0;
+}
+
+// SELVA.FIND.DESCENDANTS key [DEPTH n] [TYPES n prefix ...] id [id ...]
+int SelvaCommand_FindDescendants(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  RedisModule_AutoMemory(ctx);
+
+  if (argc < 3) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  SelvaModify_Hierarchy *hierarchy = SelvaModify_OpenHierarchyKey(ctx, argv[1], REDISMODULE_READ);
+  if (!hierarchy) {
+    return REDISMODULE_OK;
+  }
+
+  struct FindDescendantsArgs args = {
+    .ctx = ctx,
+    .types = RedisModule_PoolAlloc(ctx, sizeof(struct SelvaTypeIndex_Filter)),
+  };
+  long long max_depth = -1;
+  int i = 2;
+
+  SelvaTypeIndex_InitFilter(args.types);
+
+  while (i < argc) {
+    const char *opt = RedisModule_StringPtrLen(argv[i], NULL);
+
+    if (!strcasecmp(opt, "DEPTH") && i + 1 < argc) {
+      if (RedisModule_StringToLongLong(argv[i + 1], &max_depth) == REDISMODULE_ERR || max_depth < 0) {
+        return RedisModule_ReplyWithError(ctx, "ERR invalid depth");
+      }
+      i += 2;
+    } else if (!strcasecmp(opt, "TYPES") && i + 1 < argc) {
+      long long nr_types;
+
+      if (RedisModule_StringToLongLong(argv[i + 1], &nr_types) == REDISMODULE_ERR ||
+          nr_types < 0 || nr_types > argc - i - 2) {
+        return RedisModule_ReplyWithError(ctx, "ERR invalid types");
+      }
+
+      for (long long j = 0; j < nr_types; j++) {
+        if (SelvaTypeIndex_FilterAdd(args.types, argv[i + 2 + j]) == REDISMODULE_ERR) {
+          return RedisModule_ReplyWithError(ctx, "ERR invalid type prefix");
+        }
+      }
+      i += 2 + nr_types;
+    } else {
+      break;
+    }
+  }
+
+  if (i >= argc) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  const size_t nr_ids = argc - i;
+  Selva_NodeId *ids = RedisModule_PoolAlloc(ctx, nr_ids * sizeof(Selva_NodeId));
+  for (size_t j = 0; j < nr_ids; j++) {
+    if (SelvaModify_ParseNodeId(ids[j], argv[i + j]) == REDISMODULE_ERR) {
+      return RedisModule_ReplyWithError(ctx, "ERR invalid node id");
+    }
+  }
+
+  RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
+  SelvaModify_TraverseDescendants(hierarchy, nr_ids, (const Selva_NodeId *)ids, (int)max_depth, replyWithDescendant, &args);
+  RedisModule_ReplySetArrayLength(ctx, args.nr_nodes);
+
+  return REDISMODULE_OK;
+}
+
+// SELVA.FIND.FILTER filter id [id ...]
+// Reply with the ids matching the JSON encoded $filter fork, in the given order.
+int SelvaCommand_FindFilter(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  RedisModule_AutoMemory(ctx);
+
+  if (argc < 3) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  size_t len;
+  const char *js = RedisModule_StringPtrLen(argv[1], &len);
+  struct SelvaFilter_Program *prog = SelvaFilter_Compile(js, len);
+  long nr_nodes = 0;
+
+  if (!prog) {
+    return RedisModule_ReplyWithError(ctx, "ERR unsupported filter");
+  }
+
+  RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
+  for (int i = 2; i < argc; i++) {
+    if (SelvaFilter_Eval(ctx, prog, argv[i])) {
+      RedisModule_ReplyWithString(ctx, argv[i]);
+      nr_nodes++;
+    }
+  }
+  RedisModule_ReplySetArrayLength(ctx, nr_nodes);
+
+  SelvaFilter_Free(prog);
+
+  return REDISMODULE_OK;
+}
+
+int SelvaModify_Find_OnLoad(RedisModuleCtx *ctx) {
+  if (RedisModule_CreateCommand(ctx, "selva.find.descendants", SelvaCommand_FindDescendants, "readonly", 1, 1, 1) == REDISMODULE_ERR ||
+      RedisModule_CreateCommand(ctx, "selva.find.filter", SelvaCommand_FindFilter, "readonly", 2, -1, 1) == REDISMODULE_ERR ||
+      RedisModule_CreateCommand(ctx, "selva.find.sort", SelvaCommand_FindSort, "readonly", 0, 0, 0) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  return REDISMODULE_OK;
+}
@@ -0,0 +1,7 @@
+#pragma once
+#ifndef SELVA_MODIFY_FIND
+#define SELVA_MODIFY_FIND
+
+int SelvaModify_Find_OnLoad(RedisModuleCtx *ctx);
+
+#endif /* SELVA_MODIFY_FIND */
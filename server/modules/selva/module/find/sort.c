@@ -0,0 +1,497 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "../../redismodule.h"
+#include "../../rmutil/priority_queue.h"
+#include "../hierarchy/hierarchy.h"
+#include "../numindex/numindex.h"
+#include "./sort.h"
+
+#define SORT_MAX_FIELDS 16
+
+struct sortField {
+  const char *name;
+  int desc;
+  int numeric;
+};
+
+struct sortSpec {
+  size_t nr_fields;
+  struct sortField fields[SORT_MAX_FIELDS];
+  // Sort by the id alone when there are no fields, e.g. for a cursor
+  int by_id;
+};
+
+// The sort keys of a node are decoded once when the node is read
+struct sortKey {
+  double num;
+  const char *str;
+  size_t len;
+};
+
+struct sortItem {
+  const struct sortSpec *spec;
+  const char *id;
+  size_t id_len;
+  struct sortKey *keys;
+};
+
+static int compareStrings(const char *a, size_t a_len, const char *b, size_t b_len) {
+  const int res = memcmp(a, b, a_len < b_len ? a_len : b_len);
+
+  return res ? res : (a_len > b_len) - (a_len < b_len);
+}
+
+static int compareItems(const struct sortItem *a, const struct sortItem *b) {
+  const struct sortSpec *spec = a->spec;
+
+  for (size_t i = 0; i < spec->nr_fields; i++) {
+    const struct sortKey *x = &a->keys[i];
+    const struct sortKey *y = &b->keys[i];
+    int res;
+
+    if (spec->fields[i].numeric) {
+      res = (x->num > y->num) - (x->num < y->num);
+    } else {
+      res = compareStrings(x->str, x->len, y->str, y->len);
+    }
+
+    if (res) {
+      return spec->fields[i].desc ? -res : res;
+    }
+  }
+
+  // Ties are broken by the id in the direction of the last field, like in a
+  // reverse scan of the numeric index, so that every path gives the same order
+  const int res = compareStrings(a->id, a->id_len, b->id, b->id_len);
+
+  return spec->nr_fields > 0 && spec->fields[spec->nr_fields - 1].desc ? -res : res;
+}
+
+static int qsortCmp(const void *a, const void *b) {
+  return compareItems(*(struct sortItem * const *)a, *(struct sortItem * const *)b);
+}
+
+// The heap keeps the worst of the best items on top
+static int heapCmp(void *a, void *b) {
+  return compareItems(*(struct sortItem **)a, *(struct sortItem **)b);
+}
+
+static void readKeys(RedisModuleCtx *ctx, struct sortItem *item) {
+  const struct sortSpec *spec = item->spec;
+  RedisModuleString *id = RedisModule_CreateString(ctx, item->id, item->id_len);
+  RedisModuleKey *key = RedisModule_OpenKey(ctx, id, REDISMODULE_READ);
+  const int is_hash = RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_HASH;
+
+  for (size_t i = 0; i < spec->nr_fields; i++) {
+    struct sortKey *k = &item->keys[i];
+    RedisModuleString *value = NULL;
+
+    if (is_hash) {
+      RedisModule_HashGet(key, REDISMODULE_HASH_CFIELDS, spec->fields[i].name, &value, NULL);
+    }
+
+    // A missing or malformed key sorts like 0 or an empty string
+    k->num = 0;
+    k->str = "";
+    k->len = 0;
+    if (value && spec->fields[i].numeric) {
+      RedisModule_StringToDouble(value, &k->num);
+      RedisModule_FreeString(ctx, value);
+    } else if (value) {
+      // The value is kept until the end of the command
+      k->str = RedisModule_StringPtrLen(value, &k->len);
+    }
+  }
+
+  RedisModule_CloseKey(key);
+  RedisModule_FreeString(ctx, id);
+}
+
+static void appendCursorPart(RedisModuleCtx *ctx, RedisModuleString *cursor, const char *str, size_t len) {
+  char prefix[24];
+  const int n = snprintf(prefix, sizeof(prefix), "%zu:", len);
+
+  RedisModule_StringAppendBuffer(ctx, cursor, prefix, n);
+  RedisModule_StringAppendBuffer(ctx, cursor, str, len);
+}
+
+// A cursor is the sort keys and the id of the last item of a page, each
+// encoded as <length>:<bytes>. Numbers are printed so that they round-trip.
+static RedisModuleString *encodeCursor(RedisModuleCtx *ctx, const struct sortItem *item) {
+  const struct sortSpec *spec = item->spec;
+  RedisModuleString *cursor = RedisModule_CreateString(ctx, "", 0);
+
+  for (size_t i = 0; i < spec->nr_fields; i++) {
+    const struct sortKey *k = &item->keys[i];
+
+    if (spec->fields[i].numeric) {
+      char num[32];
+      const int n = snprintf(num, sizeof(num), "%.17g", k->num);
+
+      appendCursorPart(ctx, cursor, num, n);
+    } else {
+      appendCursorPart(ctx, cursor, k->str, k->len);
+    }
+  }
+  appendCursorPart(ctx, cursor, item->id, item->id_len);
+
+  return cursor;
+}
+
+static const char *decodeCursorPart(const char *p, const char *end, const char **str, size_t *len) {
+  size_t n = 0;
+
+  if (p == end || *p < '0' || *p > '9') {
+    return NULL;
+  }
+
+  while (p < end && *p >= '0' && *p <= '9') {
+    n = n * 10 + (*p++ - '0');
+    if (n > (size_t)(end - p)) {
+      return NULL;
+    }
+  }
+
+  if (p == end || *p != ':' || n > (size_t)(end - p - 1)) {
+    return NULL;
+  }
+
+  *str = p + 1;
+  *len = n;
+
+  return p + 1 + n;
+}
+
+static int decodeCursor(RedisModuleCtx *ctx, RedisModuleString *arg, struct sortItem *cursor) {
+  const struct sortSpec *spec = cursor->spec;
+  size_t cursor_len;
+  const char *p = RedisModule_StringPtrLen(arg, &cursor_len);
+  const char *end = p + cursor_len;
+
+  for (size_t i = 0; i < spec->nr_fields; i++) {
+    struct sortKey *k = &cursor->keys[i];
+
+    p = decodeCursorPart(p, end, &k->str, &k->len);
+    if (!p) {
+      return REDISMODULE_ERR;
+    }
+
+    k->num = 0;
+    if (spec->fields[i].numeric &&
+        RedisModule_StringToDouble(RedisModule_CreateString(ctx, k->str, k->len), &k->num) == REDISMODULE_ERR) {
+      return REDISMODULE_ERR;
+    }
+  }
+
+  p = decodeCursorPart(p, end, &cursor->id, &cursor->id_len);
+
+  return p == end && cursor->id_len > 0 ? REDISMODULE_OK : REDISMODULE_ERR;
+}
+
+// Keep the first k items in a bounded max-heap and return them sorted.
+// Each item is compared against the heap top only once it's full, so this is O(n log k).
+static size_t topK(struct sortItem **items, size_t nr_items, size_t k) {
+  PriorityQueue *pq = NewPriorityQueue(struct sortItem *, k, heapCmp);
+  size_t n;
+
+  for (size_t i = 0; i < nr_items; i++) {
+    struct sortItem *top;
+
+    if (Priority_Queue_Size(pq) < k) {
+      Priority_Queue_Push(pq, items[i]);
+    } else if (Priority_Queue_Top(pq, &top) && compareItems(items[i], top) < 0) {
+      Priority_Queue_Pop(pq);
+      Priority_Queue_Push(pq, items[i]);
+    }
+  }
+
+  n = Priority_Queue_Size(pq);
+  for (size_t i = n; i > 0; i--) {
+    Priority_Queue_Top(pq, &items[i - 1]);
+    Priority_Queue_Pop(pq);
+  }
+  Priority_Queue_Free(pq);
+
+  return n;
+}
+
+// With a single numeric sort key the top k can be read in order from the
+// numeric index. The scan visits about k * len / nr_items entries before it
+// has found k candidates, so it's used only when that's less than reading
+// the key of every candidate.
+static int canUseIndex(RedisModuleCtx *ctx, const struct sortSpec *spec, size_t nr_items, size_t k) {
+  if (spec->nr_fields != 1 || !spec->fields[0].numeric || k == 0) {
+    return 0;
+  }
+
+  const long long len = SelvaNumIndex_Open(ctx, spec->fields[0].name, strlen(spec->fields[0].name));
+
+  return len > 0 && (double)k * (double)len <= (double)nr_items * (double)nr_items;
+}
+
+struct indexScan {
+  const struct sortSpec *spec;
+  const uint64_t *candidates;
+  // The candidates without a value in the index, sorted as if their value was 0.
+  // They're merged into the scan.
+  struct sortItem **missing;
+  size_t nr_missing;
+  size_t next_missing;
+  struct sortItem *out_buf;
+  struct sortKey *out_keys;
+  struct sortItem **out;
+  size_t nr_out;
+  size_t k;
+};
+
+static int scanNode(Selva_NodeHandle handle, double value, void *arg) {
+  struct indexScan *scan = (struct indexScan *)arg;
+
+  if (!(scan->candidates[handle / 64] & (UINT64_C(1) << (handle % 64)))) {
+    return 0;
+  }
+
+  struct sortItem *item = &scan->out_buf[scan->nr_out];
+  struct sortKey *key = &scan->out_keys[scan->nr_out];
+
+  key->num = value;
+  item->spec = scan->spec;
+  item->id = SelvaId_GetId(handle);
+  item->id_len = SelvaModify_NodeIdLen(item->id);
+  item->keys = key;
+
+  while (scan->next_missing < scan->nr_missing && compareItems(scan->missing[scan->next_missing], item) < 0) {
+    scan->out[scan->nr_out++] = scan->missing[scan->next_missing++];
+    if (scan->nr_out == scan->k) {
+      return 1;
+    }
+  }
+
+  scan->out[scan->nr_out++] = item;
+
+  return scan->nr_out >= scan->k;
+}
+
+// The first k items after the cursor, if any, read in order from the numeric index.
+// Ties are ordered by the id like on the other paths.
+static size_t indexTopK(RedisModuleCtx *ctx, const struct sortSpec *spec, struct sortItem **items, size_t nr_items, size_t k, const struct sortItem *cursor) {
+  const char *field = spec->fields[0].name;
+  const size_t field_len = strlen(field);
+  const size_t nr_words = (SelvaId_HandleLimit() + 63) / 64 + 1;
+  uint64_t *candidates = RedisModule_PoolAlloc(ctx, nr_words * sizeof(uint64_t));
+  struct indexScan scan = {
+    .spec = spec,
+    .candidates = candidates,
+    .missing = RedisModule_PoolAlloc(ctx, (nr_items + 1) * sizeof(struct sortItem *)),
+    .out_buf = RedisModule_PoolAlloc(ctx, k * sizeof(struct sortItem)),
+    .out_keys = RedisModule_PoolAlloc(ctx, k * sizeof(struct sortKey)),
+    .out = items,
+    .k = k,
+  };
+
+  memset(candidates, 0, nr_words * sizeof(uint64_t));
+  for (size_t i = 0; i < nr_items; i++) {
+    struct sortItem *item = items[i];
+    Selva_NodeHandle handle = SELVA_NODE_HANDLE_NONE;
+
+    if (SelvaNumIndex_Has(ctx, field, field_len, item->id, item->id_len)) {
+      Selva_NodeId id;
+
+      memset(id, '\0', SELVA_NODE_ID_SIZE);
+      memcpy(id, item->id, item->id_len);
+      handle = SelvaId_Lookup(id);
+    }
+
+    if (handle != SELVA_NODE_HANDLE_NONE) {
+      candidates[handle / 64] |= UINT64_C(1) << (handle % 64);
+    } else {
+      item->keys[0].num = 0;
+      if (!cursor || compareItems(item, cursor) > 0) {
+        scan.missing[scan.nr_missing++] = item;
+      }
+    }
+  }
+  qsort(scan.missing, scan.nr_missing, sizeof(struct sortItem *), qsortCmp);
+
+  if (!cursor) {
+    SelvaNumIndex_Scan(field, field_len, -INFINITY, INFINITY, spec->fields[0].desc, scanNode, &scan);
+  } else if (cursor->id_len <= SELVA_NODE_ID_SIZE) {
+    Selva_NodeId id;
+
+    memset(id, '\0', SELVA_NODE_ID_SIZE);
+    memcpy(id, cursor->id, cursor->id_len);
+    SelvaNumIndex_ScanAfter(field, field_len, cursor->keys[0].num, id, spec->fields[0].desc, scanNode, &scan);
+  }
+
+  while (scan.next_missing < scan.nr_missing && scan.nr_out < k) {
+    scan.out[scan.nr_out++] = scan.missing[scan.next_missing++];
+  }
+
+  return scan.nr_out;
+}
+
+// Drop the items up to and including the cursor
+static size_t filterAfter(struct sortItem **items, size_t nr_items, const struct sortItem *cursor) {
+  size_t n = 0;
+
+  for (size_t i = 0; i < nr_items; i++) {
+    if (compareItems(items[i], cursor) > 0) {
+      items[n++] = items[i];
+    }
+  }
+
+  return n;
+}
+
+// The ids are NUL separated in a single argument, which keeps large result
+// sets within the argument limits of Lua.
+int SelvaCommand_FindSort(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  RedisModule_AutoMemory(ctx);
+
+  struct sortSpec *spec = RedisModule_PoolAlloc(ctx, sizeof(struct sortSpec));
+  RedisModuleString *cursor_arg = NULL;
+  long long offset = 0;
+  long long limit = -1;
+  int i = 1;
+
+  spec->nr_fields = 0;
+  spec->by_id = 0;
+
+  while (i < argc - 1) {
+    const char *opt = RedisModule_StringPtrLen(argv[i], NULL);
+
+    if (!strcasecmp(opt, "OFFSET") && i + 2 < argc) {
+      if (RedisModule_StringToLongLong(argv[i + 1], &offset) == REDISMODULE_ERR || offset < 0) {
+        return RedisModule_ReplyWithError(ctx, "ERR invalid offset");
+      }
+      i += 2;
+    } else if (!strcasecmp(opt, "LIMIT") && i + 2 < argc) {
+      if (RedisModule_StringToLongLong(argv[i + 1], &limit) == REDISMODULE_ERR || limit < 0) {
+        return RedisModule_ReplyWithError(ctx, "ERR invalid limit");
+      }
+      i += 2;
+    } else if (!strcasecmp(opt, "CURSOR") && i + 2 < argc) {
+      cursor_arg = argv[i + 1];
+      spec->by_id = 1;
+      i += 2;
+    } else if (!strcasecmp(opt, "SORT") && i + 4 < argc) {
+      struct sortField *field = &spec->fields[spec->nr_fields];
+      const char *order = RedisModule_StringPtrLen(argv[i + 2], NULL);
+      const char *type = RedisModule_StringPtrLen(argv[i + 3], NULL);
+
+      if (spec->nr_fields == SORT_MAX_FIELDS) {
+        return RedisModule_ReplyWithError(ctx, "ERR too many sort fields");
+      }
+      if ((strcasecmp(order, "ASC") && strcasecmp(order, "DESC")) ||
+          (strcasecmp(type, "NUMERIC") && strcasecmp(type, "STRING"))) {
+        return RedisModule_ReplyWithError(ctx, "ERR invalid sort");
+      }
+
+      field->name = RedisModule_StringPtrLen(argv[i + 1], NULL);
+      field->desc = !strcasecmp(order, "DESC");
+      field->numeric = !strcasecmp(type, "NUMERIC");
+      spec->nr_fields++;
+      i += 4;
+    } else {
+      break;
+    }
+  }
+
+  if (i != argc - 1) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  // An empty cursor starts from the beginning
+  struct sortItem *cursor = NULL;
+  size_t cursor_len = 0;
+  if (cursor_arg) {
+    RedisModule_StringPtrLen(cursor_arg, &cursor_len);
+  }
+  if (cursor_len > 0) {
+    cursor = RedisModule_PoolAlloc(ctx, sizeof(struct sortItem));
+    cursor->spec = spec;
+    cursor->keys = RedisModule_PoolAlloc(ctx, (spec->nr_fields + 1) * sizeof(struct sortKey));
+    if (decodeCursor(ctx, cursor_arg, cursor) == REDISMODULE_ERR) {
+      return RedisModule_ReplyWithError(ctx, "ERR invalid cursor");
+    }
+  }
+
+  size_t ids_len;
+  const char *ids = RedisModule_StringPtrLen(argv[i], &ids_len);
+  size_t nr_items = 0;
+
+  for (size_t j = 0; j < ids_len; j++) {
+    nr_items += ids[j] == '\0';
+  }
+  nr_items += ids_len > 0;
+
+  struct sortItem **items = RedisModule_PoolAlloc(ctx, (nr_items + 1) * sizeof(struct sortItem *));
+  struct sortItem *item_buf = RedisModule_PoolAlloc(ctx, (nr_items + 1) * sizeof(struct sortItem));
+  struct sortKey *key_buf = RedisModule_PoolAlloc(ctx, (nr_items * spec->nr_fields + 1) * sizeof(struct sortKey));
+  const char *p = ids;
+
+  for (size_t j = 0; j < nr_items; j++) {
+    const char *end = memchr(p, '\0', ids + ids_len - p);
+    struct sortItem *item = &item_buf[j];
+
+    item->spec = spec;
+    item->id = p;
+    item->id_len = (end ? end : ids + ids_len) - p;
+    item->keys = &key_buf[j * spec->nr_fields];
+    items[j] = item;
+    p += item->id_len + 1;
+  }
+
+  const int sorted = spec->nr_fields > 0 || spec->by_id;
+  size_t nr_sorted;
+
+  if (limit == 0) {
+    // Nothing to sort, the page is empty
+    nr_sorted = 0;
+  } else if (limit > 0 && (size_t)(offset + limit) < nr_items && canUseIndex(ctx, spec, nr_items, offset + limit)) {
+    nr_sorted = indexTopK(ctx, spec, items, nr_items, offset + limit, cursor);
+  } else {
+    if (spec->nr_fields > 0) {
+      for (size_t j = 0; j < nr_items; j++) {
+        readKeys(ctx, items[j]);
+      }
+    }
+
+    if (cursor) {
+      nr_items = filterAfter(items, nr_items, cursor);
+    }
+
+    nr_sorted = nr_items;
+    if (limit >= 0 && (size_t)(offset + limit) < nr_items) {
+      nr_sorted = sorted ? topK(items, nr_items, offset + limit) : (size_t)(offset + limit);
+    } else if (sorted) {
+      qsort(items, nr_items, sizeof(struct sortItem *), qsortCmp);
+    }
+  }
+
+  const size_t start = (size_t)offset < nr_sorted ? (size_t)offset : nr_sorted;
+
+  // With a cursor the reply starts with the cursor of the next page, or an
+  // empty string if this page is the last one
+  if (cursor_arg) {
+    RedisModule_ReplyWithArray(ctx, nr_sorted - start + 1);
+    if (limit > 0 && nr_sorted - start == (size_t)limit) {
+      RedisModule_ReplyWithString(ctx, encodeCursor(ctx, items[nr_sorted - 1]));
+    } else {
+      RedisModule_ReplyWithStringBuffer(ctx, "", 0);
+    }
+  } else {
+    RedisModule_ReplyWithArray(ctx, nr_sorted - start);
+  }
+
+  for (size_t j = start; j < nr_sorted; j++) {
+    RedisModule_ReplyWithStringBuffer(ctx, items[j]->id, items[j]->id_len);
+  }
+
+  return REDISMODULE_OK;
+}
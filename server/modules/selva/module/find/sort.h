@@ -0,0 +1,8 @@
+#pragma once
+#ifndef SELVA_MODIFY_FIND_SORT
+#define SELVA_MODIFY_FIND_SORT
+
+// SELVA.FIND.SORT [OFFSET n] [LIMIT n] [CURSOR cursor] [SORT field ASC|DESC NUMERIC|STRING]... ids
+int SelvaCommand_FindSort(RedisModuleCtx *ctx, RedisModuleString **argv, int argc);
+
+#endif /* SELVA_MODIFY_FIND_SORT */
@@ -0,0 +1,235 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "../../redismodule.h"
+#include "../reply/json.h"
+#include "./projection.h"
+#include "./get.h"
+
+#define MAX_CACHED_PROJECTIONS 1024
+
+// fieldspec -> compiled struct SelvaProjection_Node
+static RedisModuleDict *projections;
+static size_t nr_projections;
+
+struct getField {
+  const char *name;
+  size_t name_len;
+  const char *value;
+  size_t value_len;
+};
+
+static const struct SelvaProjection_Node *getProjection(const char *spec, size_t len) {
+  struct SelvaProjection_Node *root = RedisModule_DictGetC(projections, (void *)spec, len, NULL);
+
+  if (root) {
+    return root;
+  }
+
+  // Field specs come from queries so the set is small in practice, but don't
+  // let an unusual client grow it forever
+  if (nr_projections >= MAX_CACHED_PROJECTIONS) {
+    RedisModuleDictIter *it = RedisModule_DictIteratorStartC(projections, "^", NULL, 0);
+    void *old;
+
+    while (RedisModule_DictNextC(it, NULL, &old)) {
+      SelvaProjection_Free(old);
+    }
+    RedisModule_DictIteratorStop(it);
+    RedisModule_FreeDict(NULL, projections);
+    projections = RedisModule_CreateDict(NULL);
+    nr_projections = 0;
+  }
+
+  root = SelvaProjection_Compile(spec, len);
+  RedisModule_DictSetC(projections, (void *)spec, len, root);
+  nr_projections++;
+
+  return root;
+}
+
+// Order dotted names so that the fields of an object are next to each other:
+// '.' sorts before any other byte.
+static int fieldCmp(const void *a, const void *b) {
+  const struct getField *fa = a;
+  const struct getField *fb = b;
+  const size_t len = fa->name_len < fb->name_len ? fa->name_len : fb->name_len;
+
+  for (size_t i = 0; i < len; i++) {
+    const int ca = fa->name[i] == '.' ? 0 : (unsigned char)fa->name[i] + 1;
+    const int cb = fb->name[i] == '.' ? 0 : (unsigned char)fb->name[i] + 1;
+
+    if (ca != cb) {
+      return ca - cb;
+    }
+  }
+
+  return (fa->name_len > len) - (fb->name_len > len);
+}
+
+static size_t segmentEnd(const struct getField *field, size_t off) {
+  const char *dot = memchr(field->name + off, '.', field->name_len - off);
+
+  return dot ? (size_t)(dot - field->name) : field->name_len;
+}
+
+// The fields in [start, end) with the same segment at off as fields[start]
+static size_t groupEnd(const struct getField *fields, size_t start, size_t end, size_t off) {
+  const char *seg = fields[start].name + off;
+  const size_t seg_len = segmentEnd(&fields[start], off) - off;
+  size_t i = start + 1;
+
+  while (i < end &&
+         segmentEnd(&fields[i], off) - off == seg_len &&
+         !memcmp(fields[i].name + off, seg, seg_len)) {
+    i++;
+  }
+
+  return i;
+}
+
+// Reply with the fields in [start, end), which all share the first off bytes
+// of their name, as an array of alternating keys and values. A field with
+// nested fields is replied as a nested array; if a field has both a value of
+// its own and nested fields its own value is in the nested array under an
+// empty key.
+static void replyObject(RedisModuleCtx *ctx, const struct getField *fields, size_t start, size_t end, size_t off) {
+  size_t nr_groups = 0;
+
+  RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
+
+  for (size_t i = start; i < end;) {
+    // The sort order puts the value of the field itself first
+    if (fields[i].name_len < off) {
+      RedisModule_ReplyWithStringBuffer(ctx, "", 0);
+      RedisModule_ReplyWithStringBuffer(ctx, fields[i].value, fields[i].value_len);
+      nr_groups++;
+      i++;
+      continue;
+    }
+
+    const size_t seg_end = segmentEnd(&fields[i], off);
+    const size_t j = groupEnd(fields, i, end, off);
+
+    RedisModule_ReplyWithStringBuffer(ctx, fields[i].name + off, seg_end - off);
+    if (j - i == 1 && seg_end == fields[i].name_len) {
+      RedisModule_ReplyWithStringBuffer(ctx, fields[i].value, fields[i].value_len);
+    } else {
+      replyObject(ctx, fields, i, j, seg_end + 1);
+    }
+
+    nr_groups++;
+    i = j;
+  }
+
+  RedisModule_ReplySetArrayLength(ctx, 2 * nr_groups);
+}
+
+// Same as replyObject but as a JSON object with string values
+static sds jsonObject(sds s, const struct getField *fields, size_t start, size_t end, size_t off) {
+  s = SelvaJsonReply_AppendRaw(s, "{", 1);
+
+  for (size_t i = start; i < end;) {
+    if (i > start) {
+      s = SelvaJsonReply_AppendRaw(s, ",", 1);
+    }
+
+    if (fields[i].name_len < off) {
+      s = SelvaJsonReply_AppendRaw(s, "\"\":", 3);
+      s = SelvaJsonReply_AppendString(s, fields[i].value, fields[i].value_len);
+      i++;
+      continue;
+    }
+
+    const size_t seg_end = segmentEnd(&fields[i], off);
+    const size_t j = groupEnd(fields, i, end, off);
+
+    s = SelvaJsonReply_AppendString(s, fields[i].name + off, seg_end - off);
+    s = SelvaJsonReply_AppendRaw(s, ":", 1);
+    if (j - i == 1 && seg_end == fields[i].name_len) {
+      s = SelvaJsonReply_AppendString(s, fields[i].value, fields[i].value_len);
+    } else {
+      s = jsonObject(s, fields, i, j, seg_end + 1);
+    }
+
+    i = j;
+  }
+
+  return SelvaJsonReply_AppendRaw(s, "}", 1);
+}
+
+/*
+ * SELVA.GET id fieldspec [JSON]
+ *
+ * fieldspec is a comma separated list of dotted field paths. A path selects
+ * the field and every field nested under it.
+ * The reply is null if the node doesn't exist, otherwise the selected
+ * fields as nested arrays of alternating keys and values. The value of a
+ * field that also has nested fields is under an empty key in its nested
+ * array. With JSON the reply is a single JSON object instead.
+ */
+int SelvaCommand_Get(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  RedisModule_AutoMemory(ctx);
+
+  if (argc != 3 && argc != 4) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  const int json = argc == 4;
+  if (json && strcasecmp(RedisModule_StringPtrLen(argv[3], NULL), "JSON")) {
+    return RedisModule_ReplyWithError(ctx, "ERR invalid reply format");
+  }
+
+  size_t spec_len;
+  const char *spec = RedisModule_StringPtrLen(argv[2], &spec_len);
+  const struct SelvaProjection_Node *projection = getProjection(spec, spec_len);
+
+  RedisModuleCallReply *reply = RedisModule_Call(ctx, "HGETALL", "s", argv[1]);
+  if (!reply || RedisModule_CallReplyType(reply) != REDISMODULE_REPLY_ARRAY) {
+    return RedisModule_ReplyWithError(ctx, "WRONGTYPE Operation against a key holding the wrong kind of value");
+  }
+
+  const size_t nr_elems = RedisModule_CallReplyLength(reply);
+  if (nr_elems == 0) {
+    return RedisModule_ReplyWithNull(ctx);
+  }
+
+  struct getField *fields = RedisModule_PoolAlloc(ctx, (nr_elems / 2) * sizeof(struct getField));
+  size_t nr_fields = 0;
+  size_t total_len = 0;
+
+  for (size_t i = 0; i + 1 < nr_elems; i += 2) {
+    struct getField *field = &fields[nr_fields];
+
+    field->name = RedisModule_CallReplyStringPtr(RedisModule_CallReplyArrayElement(reply, i), &field->name_len);
+    if (SelvaProjection_Match(projection, field->name, field->name_len)) {
+      field->value = RedisModule_CallReplyStringPtr(RedisModule_CallReplyArrayElement(reply, i + 1), &field->value_len);
+      total_len += field->name_len + field->value_len;
+      nr_fields++;
+    }
+  }
+
+  qsort(fields, nr_fields, sizeof(struct getField), fieldCmp);
+
+  if (json) {
+    // Quotes and separators, escaping may still grow it
+    const size_t size_hint = total_len + 6 * nr_fields + 2;
+
+    return SelvaJsonReply_Send(ctx, jsonObject(SelvaJsonReply_New(size_hint), fields, 0, nr_fields, 0));
+  }
+
+  replyObject(ctx, fields, 0, nr_fields, 0);
+
+  return REDISMODULE_OK;
+}
+
+int SelvaGet_OnLoad(RedisModuleCtx *ctx) {
+  projections = RedisModule_CreateDict(NULL);
+
+  if (RedisModule_CreateCommand(ctx, "selva.get", SelvaCommand_Get, "readonly", 1, 1, 1) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  return REDISMODULE_OK;
+}
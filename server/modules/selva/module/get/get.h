@@ -0,0 +1,7 @@
+#pragma once
+#ifndef SELVA_GET
+#define SELVA_GET
+
+int SelvaGet_OnLoad(RedisModuleCtx *ctx);
+
+#endif /* SELVA_GET */
@@ -0,0 +1,95 @@
+#include <string.h>
+
+#include "../../redismodule.h"
+#include "./projection.h"
+
+static struct SelvaProjection_Node *getChild(struct SelvaProjection_Node *node, const char *name, size_t len, int create) {
+  for (size_t i = 0; i < node->nr_children; i++) {
+    struct SelvaProjection_Child *child = &node->children[i];
+
+    if (child->len == len && !memcmp(child->name, name, len)) {
+      return &child->node;
+    }
+  }
+
+  if (!create) {
+    return NULL;
+  }
+
+  node->children = RedisModule_Realloc(node->children, (node->nr_children + 1) * sizeof(struct SelvaProjection_Child));
+
+  struct SelvaProjection_Child *child = &node->children[node->nr_children++];
+  child->name = RedisModule_Alloc(len);
+  memcpy(child->name, name, len);
+  child->len = len;
+  memset(&child->node, 0, sizeof(child->node));
+
+  return &child->node;
+}
+
+static void addPath(struct SelvaProjection_Node *root, const char *path, size_t len) {
+  struct SelvaProjection_Node *node = root;
+  const char *end = path + len;
+
+  while (path < end && !node->selected) {
+    const char *dot = memchr(path, '.', end - path);
+    const char *seg_end = dot ? dot : end;
+
+    node = getChild(node, path, seg_end - path, 1);
+    path = seg_end + 1;
+  }
+
+  node->selected = 1;
+}
+
+struct SelvaProjection_Node *SelvaProjection_Compile(const char *spec, size_t len) {
+  struct SelvaProjection_Node *root = RedisModule_Calloc(1, sizeof(struct SelvaProjection_Node));
+  const char *end = spec + len;
+
+  while (spec < end) {
+    const char *comma = memchr(spec, ',', end - spec);
+    const char *path_end = comma ? comma : end;
+
+    if (path_end > spec) {
+      addPath(root, spec, path_end - spec);
+    }
+    spec = path_end + 1;
+  }
+
+  return root;
+}
+
+static void freeNode(struct SelvaProjection_Node *node) {
+  for (size_t i = 0; i < node->nr_children; i++) {
+    freeNode(&node->children[i].node);
+    RedisModule_Free(node->children[i].name);
+  }
+  RedisModule_Free(node->children);
+}
+
+void SelvaProjection_Free(struct SelvaProjection_Node *root) {
+  freeNode(root);
+  RedisModule_Free(root);
+}
+
+int SelvaProjection_Match(const struct SelvaProjection_Node *root, const char *field, size_t len) {
+  const struct SelvaProjection_Node *node = root;
+  const char *end = field + len;
+
+  while (!node->selected) {
+    if (field > end) {
+      return 0;
+    }
+
+    const char *dot = memchr(field, '.', end - field);
+    const char *seg_end = dot ? dot : end;
+
+    node = getChild((struct SelvaProjection_Node *)node, field, seg_end - field, 0);
+    if (!node) {
+      return 0;
+    }
+    field = seg_end + 1;
+  }
+
+  return 1;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#ifndef SELVA_GET_PROJECTION
+#define SELVA_GET_PROJECTION
+
+#include <stddef.h>
+
+// A trie of dotted field paths. A path selects the field itself and every
+// field nested under it, so "image" matches "image.thumb" and
+// "title" matches "title.en".
+struct SelvaProjection_Node {
+  // The path ends here and the whole subtree is selected
+  int selected;
+  size_t nr_children;
+  struct SelvaProjection_Child *children;
+};
+
+struct SelvaProjection_Child {
+  char *name;
+  size_t len;
+  struct SelvaProjection_Node node;
+};
+
+// Compile a comma separated list of dotted paths
+struct SelvaProjection_Node *SelvaProjection_Compile(const char *spec, size_t len);
+void SelvaProjection_Free(struct SelvaProjection_Node *root);
+
+// Returns 1 if the dotted field name is selected
+int SelvaProjection_Match(const struct SelvaProjection_Node *root, const char *field, size_t len);
+
+#endif /* SELVA_GET_PROJECTION */
@@ -0,0 +1,1302 @@
+// For timers
+#define REDISMODULE_EXPERIMENTAL_API
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../redismodule.h"
+#include "../../rmutil/vector.h"
+#include "../id/intern.h"
+#include "../numindex/numindex.h"
+#include "../schema/schema.h"
+#include "../typeindex/typeindex.h"
+#include "./hierarchy.h"
+
+#define HIERARCHY_ENCODING_VERSION 1
+
+#define NODE_FLAG_DIRTY           0x01
+#define NODE_FLAG_PARENT_CHANGED  0x02
+#define NODE_FLAG_DETACHED        0x04
+
+struct SelvaModify_HierarchyEdges {
+  uint32_t nr;
+  uint32_t cap;
+  // Sorted by node handle
+  SelvaModify_HierarchyNode **nodes;
+};
+
+struct SelvaModify_HierarchyNode {
+  Selva_NodeHandle handle;
+  int depth;
+  unsigned int flags;
+  unsigned int visit_stamp;
+  uint32_t nr_pending;
+  struct SelvaModify_HierarchyEdges parents;
+  struct SelvaModify_HierarchyEdges children;
+  struct SelvaModify_HierarchyEdges ancestors;
+};
+
+struct SelvaModify_Hierarchy {
+  // Nodes indexed by handle
+  SelvaModify_HierarchyNode **nodes;
+  size_t nr_slots;
+  size_t nr_nodes;
+  unsigned int visit_stamp;
+  // Nodes with changed parents waiting for SelvaModify_HierarchyRecompute()
+  Vector *dirty;
+  // Nodes removed from the index but not yet freed
+  Vector *detached;
+};
+
+RedisModuleType *HierarchyType;
+
+// The type and numeric indexes are process wide and follow the hierarchy
+// of HIERARCHY_DEFAULT_KEY. Other copies, such as one being replaced by a
+// diskless load or swapped to another db, must not touch them.
+static SelvaModify_Hierarchy *index_owner;
+
+// Hierarchies loaded from an RDB wait here until the whole RDB is loaded so
+// that they are computed once, with the ancestry rules of the loaded schema
+static Vector *pending_loads;
+static int load_timer_armed;
+
+static inline const char *nodeId(const SelvaModify_HierarchyNode *node) {
+  return SelvaId_GetId(node->handle);
+}
+
+static SelvaModify_HierarchyNode *newNode(SelvaModify_Hierarchy *hierarchy, const Selva_NodeId id) {
+  SelvaModify_HierarchyNode *node = RedisModule_Calloc(1, sizeof(SelvaModify_HierarchyNode));
+
+  node->handle = SelvaId_Intern(id);
+  if (node->handle >= hierarchy->nr_slots) {
+    size_t nr_slots = hierarchy->nr_slots ? hierarchy->nr_slots : 64;
+
+    while (nr_slots <= node->handle) {
+      nr_slots *= 2;
+    }
+    hierarchy->nodes = RedisModule_Realloc(hierarchy->nodes, nr_slots * sizeof(SelvaModify_HierarchyNode *));
+    memset(hierarchy->nodes + hierarchy->nr_slots, 0, (nr_slots - hierarchy->nr_slots) * sizeof(SelvaModify_HierarchyNode *));
+    hierarchy->nr_slots = nr_slots;
+  }
+
+  hierarchy->nodes[node->handle] = node;
+  hierarchy->nr_nodes++;
+  if (hierarchy == index_owner) {
+    SelvaTypeIndex_Add(id, SelvaModify_NodeIdLen(id));
+  }
+
+  return node;
+}
+
+static void freeNode(SelvaModify_HierarchyNode *node) {
+  SelvaId_Release(node->handle);
+  RedisModule_Free(node->parents.nodes);
+  RedisModule_Free(node->children.nodes);
+  RedisModule_Free(node->ancestors.nodes);
+  RedisModule_Free(node);
+}
+
+static void freeDetached(SelvaModify_Hierarchy *hierarchy) {
+  for (size_t i = 0; i < (size_t)Vector_Size(hierarchy->detached); i++) {
+    SelvaModify_HierarchyNode *node;
+
+    Vector_Get(hierarchy->detached, i, &node);
+    freeNode(node);
+  }
+  hierarchy->detached->top = 0;
+}
+
+SelvaModify_Hierarchy *SelvaModify_NewHierarchy(void) {
+  SelvaModify_Hierarchy *hierarchy = RedisModule_Calloc(1, sizeof(SelvaModify_Hierarchy));
+
+  hierarchy->dirty = NewVector(SelvaModify_HierarchyNode *, 16);
+  hierarchy->detached = NewVector(SelvaModify_HierarchyNode *, 0);
+  newNode(hierarchy, ROOT_NODE_ID);
+
+  return hierarchy;
+}
+
+// Rebuild the indexes from hierarchy if it isn't the one they follow
+static void claimIndexes(SelvaModify_Hierarchy *hierarchy) {
+  if (index_owner == hierarchy) {
+    return;
+  }
+
+  SelvaTypeIndex_Clear();
+  SelvaNumIndex_Clear();
+  index_owner = hierarchy;
+
+  for (size_t i = 0; i < hierarchy->nr_slots; i++) {
+    const SelvaModify_HierarchyNode *node = hierarchy->nodes[i];
+
+    if (node) {
+      SelvaTypeIndex_Add(nodeId(node), SelvaModify_NodeIdLen(nodeId(node)));
+    }
+  }
+}
+
+void SelvaModify_DestroyHierarchy(SelvaModify_Hierarchy *hierarchy) {
+  if (hierarchy == index_owner) {
+    SelvaTypeIndex_Clear();
+    SelvaNumIndex_Clear();
+    index_owner = NULL;
+  }
+
+  for (size_t i = 0; i < hierarchy->nr_slots; i++) {
+    SelvaModify_HierarchyNode *node = hierarchy->nodes[i];
+
+    if (node) {
+      freeNode(node);
+    }
+  }
+
+  freeDetached(hierarchy);
+  Vector_Free(hierarchy->detached);
+  Vector_Free(hierarchy->dirty);
+  RedisModule_Free(hierarchy->nodes);
+  RedisModule_Free(hierarchy);
+}
+
+int SelvaModify_ParseNodeId(Selva_NodeId id, RedisModuleString *str) {
+  size_t len;
+  const char *s = RedisModule_StringPtrLen(str, &len);
+
+  if (len == 0 || len > SELVA_NODE_ID_SIZE) {
+    return REDISMODULE_ERR;
+  }
+
+  memset(id, '\0', SELVA_NODE_ID_SIZE);
+  memcpy(id, s, len);
+
+  return REDISMODULE_OK;
+}
+
+size_t SelvaModify_NodeIdLen(const Selva_NodeId id) {
+  return strnlen(id, SELVA_NODE_ID_SIZE);
+}
+
+SelvaModify_HierarchyNode *SelvaModify_FindNode(SelvaModify_Hierarchy *hierarchy, const Selva_NodeId id) {
+  const Selva_NodeHandle handle = SelvaId_Lookup(id);
+
+  return handle < hierarchy->nr_slots ? hierarchy->nodes[handle] : NULL;
+}
+
+int SelvaModify_HierarchyNodeExists(SelvaModify_Hierarchy *hierarchy, const Selva_NodeId id) {
+  return SelvaModify_FindNode(hierarchy, id) != NULL;
+}
+
+int SelvaModify_GetHierarchyDepth(SelvaModify_Hierarchy *hierarchy, const Selva_NodeId id) {
+  SelvaModify_HierarchyNode *node = SelvaModify_FindNode(hierarchy, id);
+
+  return node ? node->depth : -1;
+}
+
+static SelvaModify_HierarchyNode *findOrCreateNode(SelvaModify_Hierarchy *hierarchy, const Selva_NodeId id) {
+  SelvaModify_HierarchyNode *node = SelvaModify_FindNode(hierarchy, id);
+
+  return node ? node : newNode(hierarchy, id);
+}
+
+// Binary search for handle; returns 1 if found. pos is set to the index or the insertion point.
+static int edgesFind(const struct SelvaModify_HierarchyEdges *edges, Selva_NodeHandle handle, size_t *pos) {
+  size_t lo = 0;
+  size_t hi = edges->nr;
+
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    Selva_NodeHandle h = edges->nodes[mid]->handle;
+
+    if (h == handle) {
+      *pos = mid;
+      return 1;
+    } else if (h < handle) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  *pos = lo;
+  return 0;
+}
+
+static int edgesInsert(struct SelvaModify_HierarchyEdges *edges, SelvaModify_HierarchyNode *node) {
+  size_t pos;
+
+  if (edgesFind(edges, node->handle, &pos)) {
+    return 0;
+  }
+
+  if (edges->nr == edges->cap) {
+    edges->cap = edges->cap ? edges->cap * 2 : 1;
+    edges->nodes = RedisModule_Realloc(edges->nodes, edges->cap * sizeof(SelvaModify_HierarchyNode *));
+  }
+
+  memmove(edges->nodes + pos + 1, edges->nodes + pos, (edges->nr - pos) * sizeof(SelvaModify_HierarchyNode *));
+  edges->nodes[pos] = node;
+  edges->nr++;
+
+  return 1;
+}
+
+static int edgesRemove(struct SelvaModify_HierarchyEdges *edges, Selva_NodeHandle handle) {
+  size_t pos;
+
+  if (!edgesFind(edges, handle, &pos)) {
+    return 0;
+  }
+
+  edges->nr--;
+  memmove(edges->nodes + pos, edges->nodes + pos + 1, (edges->nr - pos) * sizeof(SelvaModify_HierarchyNode *));
+
+  return 1;
+}
+
+static void markDirty(SelvaModify_Hierarchy *hierarchy, SelvaModify_HierarchyNode *node) {
+  if (!(node->flags & NODE_FLAG_DIRTY)) {
+    node->flags |= NODE_FLAG_DIRTY;
+    Vector_Push(hierarchy->dirty, node);
+  }
+}
+
+static int calcDepth(SelvaModify_HierarchyNode *node) {
+  int depth = -1;
+
+  for (size_t i = 0; i < node->parents.nr; i++) {
+    if (node->parents.nodes[i]->depth > depth) {
+      depth = node->parents.nodes[i]->depth;
+    }
+  }
+
+  return depth + 1;
+}
+
+static int nodeHandleCmp(const void *a, const void *b) {
+  const SelvaModify_HierarchyNode *na = *(const SelvaModify_HierarchyNode **)a;
+  const SelvaModify_HierarchyNode *nb = *(const SelvaModify_HierarchyNode **)b;
+
+  return (na->handle > nb->handle) - (na->handle < nb->handle);
+}
+
+// Replies order nodes by id like the sorted sets they replace
+static int nodeIdCmp(const void *a, const void *b) {
+  const SelvaModify_HierarchyNode *na = *(const SelvaModify_HierarchyNode **)a;
+  const SelvaModify_HierarchyNode *nb = *(const SelvaModify_HierarchyNode **)b;
+
+  return memcmp(nodeId(na), nodeId(nb), SELVA_NODE_ID_SIZE);
+}
+
+static void ancestryReserve(struct SelvaModify_HierarchyEdges *ancestry, size_t n) {
+  if (ancestry->nr + n > ancestry->cap) {
+    ancestry->cap = ancestry->nr + n > 2 * ancestry->cap ? ancestry->nr + n : 2 * ancestry->cap;
+    ancestry->nodes = RedisModule_Realloc(ancestry->nodes, ancestry->cap * sizeof(SelvaModify_HierarchyNode *));
+  }
+}
+
+static void ancestryPush(struct SelvaModify_HierarchyEdges *ancestry, SelvaModify_HierarchyNode *node) {
+  ancestryReserve(ancestry, 1);
+  ancestry->nodes[ancestry->nr++] = node;
+}
+
+static void ancestryPushEdges(struct SelvaModify_HierarchyEdges *ancestry, const struct SelvaModify_HierarchyEdges *edges) {
+  ancestryReserve(ancestry, edges->nr);
+  if (edges->nr > 0) {
+    memcpy(ancestry->nodes + ancestry->nr, edges->nodes, edges->nr * sizeof(SelvaModify_HierarchyNode *));
+  }
+  ancestry->nr += edges->nr;
+}
+
+static int ruleAccepts(const struct SelvaSchema *schema, const struct SelvaSchema_AncestryRule *rule, SelvaModify_HierarchyNode **group, size_t n) {
+  int has_type = 0;
+
+  for (size_t i = 0; i < n && !has_type; i++) {
+    has_type = SelvaSchema_AncestryRuleHasType(rule, SelvaSchema_GetTypeIndex(schema, nodeId(group[i])));
+  }
+
+  return rule->type == SELVA_SCHEMA_ANCESTRY_INCLUDE ? has_type : !has_type;
+}
+
+// Push the ancestry node gets through parent, like ancestryFromHierarchy() of
+// the Lua client. With a filtering rule the ancestry through each grandparent
+// is computed for parent, and kept or dropped as a group.
+// The pushed nodes may repeat.
+static void pushAncestry(struct SelvaModify_HierarchyEdges *ancestry, const struct SelvaSchema *schema, SelvaModify_HierarchyNode *root, const SelvaModify_HierarchyNode *node, SelvaModify_HierarchyNode *parent) {
+  const struct SelvaSchema_AncestryRule *rule = schema
+    ? SelvaSchema_GetAncestryRule(schema, SelvaSchema_GetTypeIndex(schema, nodeId(node)), SelvaSchema_GetTypeIndex(schema, nodeId(parent)))
+    : NULL;
+
+  if (parent == root) {
+    ancestryPush(ancestry, root);
+  } else if (!rule || rule->type == SELVA_SCHEMA_ANCESTRY_ALL) {
+    ancestryPushEdges(ancestry, &parent->ancestors);
+    ancestryPush(ancestry, parent);
+  } else if (rule->type == SELVA_SCHEMA_ANCESTRY_NONE) {
+    if (root) {
+      ancestryPush(ancestry, root);
+    }
+  } else {
+    for (size_t i = 0; i < parent->parents.nr; i++) {
+      SelvaModify_HierarchyNode *grandparent = parent->parents.nodes[i];
+      const size_t start = ancestry->nr;
+
+      pushAncestry(ancestry, schema, root, parent, grandparent);
+      ancestryPush(ancestry, grandparent);
+      if (!ruleAccepts(schema, rule, ancestry->nodes + start, ancestry->nr - start)) {
+        ancestry->nr = start;
+      }
+    }
+
+    ancestryPush(ancestry, parent);
+    if (root) {
+      ancestryPush(ancestry, root);
+    }
+  }
+}
+
+// The ancestors of a node are the union of its ancestry through each parent,
+// filtered by the hierarchy rules of the schema.
+static void calcAncestors(SelvaModify_Hierarchy *hierarchy, SelvaModify_HierarchyNode *node, struct SelvaModify_HierarchyEdges *ancestors) {
+  const struct SelvaSchema *schema = SelvaSchema_Get();
+  SelvaModify_HierarchyNode *root = SelvaModify_FindNode(hierarchy, ROOT_NODE_ID);
+
+  ancestors->nr = 0;
+  ancestors->cap = 0;
+  ancestors->nodes = NULL;
+
+  for (size_t i = 0; i < node->parents.nr; i++) {
+    pushAncestry(ancestors, schema, root, node, node->parents.nodes[i]);
+  }
+
+  if (ancestors->nr == 0) {
+    RedisModule_Free(ancestors->nodes);
+    ancestors->nodes = NULL;
+    ancestors->cap = 0;
+    return;
+  }
+
+  qsort(ancestors->nodes, ancestors->nr, sizeof(SelvaModify_HierarchyNode *), nodeHandleCmp);
+
+  size_t j = 0;
+  for (size_t i = 1; i < ancestors->nr; i++) {
+    if (ancestors->nodes[i] != ancestors->nodes[j]) {
+      ancestors->nodes[++j] = ancestors->nodes[i];
+    }
+  }
+  ancestors->nr = j + 1;
+
+  // The buffer grew with the repeated nodes
+  ancestors->nodes = RedisModule_Realloc(ancestors->nodes, ancestors->nr * sizeof(SelvaModify_HierarchyNode *));
+  ancestors->cap = ancestors->nr;
+}
+
+static int edgesEqual(const struct SelvaModify_HierarchyEdges *a, const struct SelvaModify_HierarchyEdges *b) {
+  return a->nr == b->nr && (a->nr == 0 || !memcmp(a->nodes, b->nodes, a->nr * sizeof(SelvaModify_HierarchyNode *)));
+}
+
+// Recalculate depth and ancestors of a node if any of its inputs changed.
+// Returns 1 if the node changed.
+static int updateNode(SelvaModify_Hierarchy *hierarchy, SelvaModify_HierarchyNode *node) {
+  struct SelvaModify_HierarchyEdges ancestors;
+  int depth;
+
+  if (!(node->flags & (NODE_FLAG_DIRTY | NODE_FLAG_PARENT_CHANGED))) {
+    return 0;
+  }
+
+  depth = calcDepth(node);
+  calcAncestors(hierarchy, node, &ancestors);
+
+  if (depth == node->depth && edgesEqual(&ancestors, &node->ancestors)) {
+    RedisModule_Free(ancestors.nodes);
+    return 0;
+  }
+
+  RedisModule_Free(node->ancestors.nodes);
+  node->ancestors = ancestors;
+  node->depth = depth;
+
+  for (size_t i = 0; i < node->children.nr; i++) {
+    node->children.nodes[i]->flags |= NODE_FLAG_PARENT_CHANGED;
+  }
+
+  return 1;
+}
+
+void SelvaModify_HierarchyMarkAllDirty(SelvaModify_Hierarchy *hierarchy) {
+  for (size_t i = 0; i < hierarchy->nr_slots; i++) {
+    if (hierarchy->nodes[i]) {
+      markDirty(hierarchy, hierarchy->nodes[i]);
+    }
+  }
+}
+
+int SelvaModify_HierarchyRecompute(SelvaModify_Hierarchy *hierarchy) {
+  const unsigned int stamp = ++hierarchy->visit_stamp;
+  Vector *affected = NewVector(SelvaModify_HierarchyNode *, Vector_Size(hierarchy->dirty));
+  Vector *queue;
+  size_t nr_affected;
+  int nr_changed = 0;
+
+  // Collect the subtrees of all dirty nodes
+  for (size_t i = 0; i < (size_t)Vector_Size(hierarchy->dirty); i++) {
+    SelvaModify_HierarchyNode *node;
+
+    Vector_Get(hierarchy->dirty, i, &node);
+    if (!(node->flags & NODE_FLAG_DETACHED) && node->visit_stamp != stamp) {
+      node->visit_stamp = stamp;
+      Vector_Push(affected, node);
+    }
+  }
+  hierarchy->dirty->top = 0;
+
+  for (size_t i = 0; i < (size_t)Vector_Size(affected); i++) {
+    SelvaModify_HierarchyNode *node;
+
+    Vector_Get(affected, i, &node);
+    for (size_t j = 0; j < node->children.nr; j++) {
+      SelvaModify_HierarchyNode *child = node->children.nodes[j];
+
+      if (child->visit_stamp != stamp) {
+        child->visit_stamp = stamp;
+        Vector_Push(affected, child);
+      }
+    }
+  }
+  nr_affected = Vector_Size(affected);
+
+  // Visit the affected nodes in topological order so that every node is updated only once,
+  // after all of its parents.
+  queue = NewVector(SelvaModify_HierarchyNode *, nr_affected);
+  for (size_t i = 0; i < nr_affected; i++) {
+    SelvaModify_HierarchyNode *node;
+
+    Vector_Get(affected, i, &node);
+    node->nr_pending = 0;
+    for (size_t j = 0; j < node->parents.nr; j++) {
+      node->nr_pending += node->parents.nodes[j]->visit_stamp == stamp;
+    }
+
+    if (node->nr_pending == 0) {
+      Vector_Push(queue, node);
+    }
+  }
+
+  for (size_t i = 0; i < (size_t)Vector_Size(queue); i++) {
+    SelvaModify_HierarchyNode *node;
+
+    Vector_Get(queue, i, &node);
+    nr_changed += updateNode(hierarchy, node);
+
+    for (size_t j = 0; j < node->children.nr; j++) {
+      SelvaModify_HierarchyNode *child = node->children.nodes[j];
+
+      if (child->visit_stamp == stamp && child->nr_pending > 0 && --child->nr_pending == 0) {
+        Vector_Push(queue, child);
+      }
+    }
+  }
+
+  // Anything left is part of or below a cycle; update once in discovery order.
+  if ((size_t)Vector_Size(queue) < nr_affected) {
+    for (size_t i = 0; i < nr_affected; i++) {
+      SelvaModify_HierarchyNode *node;
+
+      Vector_Get(affected, i, &node);
+      if (node->nr_pending > 0) {
+        node->nr_pending = 0;
+        nr_changed += updateNode(hierarchy, node);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < nr_affected; i++) {
+    SelvaModify_HierarchyNode *node;
+
+    Vector_Get(affected, i, &node);
+    node->flags &= ~(NODE_FLAG_DIRTY | NODE_FLAG_PARENT_CHANGED);
+  }
+
+  Vector_Free(queue);
+  Vector_Free(affected);
+  freeDetached(hierarchy);
+
+  return nr_changed;
+}
+
+int SelvaModify_AddHierarchy(SelvaModify_Hierarchy *hierarchy, const Selva_NodeId id, size_t nr_parents, const Selva_NodeId *parents) {
+  SelvaModify_HierarchyNode *node = findOrCreateNode(hierarchy, id);
+  int added = 0;
+
+  for (size_t i = 0; i < nr_parents; i++) {
+    SelvaModify_HierarchyNode *parent = findOrCreateNode(hierarchy, parents[i]);
+
+    if (parent == node) {
+      continue;
+    }
+
+    if (edgesInsert(&node->parents, parent)) {
+      edgesInsert(&parent->children, node);
+      added++;
+    }
+  }
+
+  if (added) {
+    markDirty(hierarchy, node);
+  }
+
+  return added;
+}
+
+int SelvaModify_DelHierarchy(SelvaModify_Hierarchy *hierarchy, const Selva_NodeId id, size_t nr_parents, const Selva_NodeId *parents) {
+  SelvaModify_HierarchyNode *node = SelvaModify_FindNode(hierarchy, id);
+  int removed = 0;
+
+  if (!node) {
+    return 0;
+  }
+
+  for (size_t i = 0; i < nr_parents; i++) {
+    SelvaModify_HierarchyNode *parent = SelvaModify_FindNode(hierarchy, parents[i]);
+
+    if (parent && edgesRemove(&node->parents, parent->handle)) {
+      edgesRemove(&parent->children, node->handle);
+      removed++;
+    }
+  }
+
+  if (removed) {
+    markDirty(hierarchy, node);
+  }
+
+  return removed;
+}
+
+int SelvaModify_DelHierarchyNode(SelvaModify_Hierarchy *hierarchy, const Selva_NodeId id) {
+  SelvaModify_HierarchyNode *node = SelvaModify_FindNode(hierarchy, id);
+
+  if (!node) {
+    return 0;
+  }
+
+  for (size_t i = 0; i < node->parents.nr; i++) {
+    edgesRemove(&node->parents.nodes[i]->children, node->handle);
+  }
+
+  for (size_t i = 0; i < node->children.nr; i++) {
+    SelvaModify_HierarchyNode *child = node->children.nodes[i];
+
+    edgesRemove(&child->parents, node->handle);
+    markDirty(hierarchy, child);
+  }
+
+  // Descendants may still point to the node from their ancestors so it's
+  // freed only after the next recompute.
+  hierarchy->nodes[node->handle] = NULL;
+  hierarchy->nr_nodes--;
+  if (hierarchy == index_owner) {
+    SelvaTypeIndex_Del(id, SelvaModify_NodeIdLen(id));
+  }
+  node->flags |= NODE_FLAG_DETACHED;
+  node->parents.nr = 0;
+  node->children.nr = 0;
+  Vector_Push(hierarchy->detached, node);
+
+  return 1;
+}
+
+void SelvaModify_TraverseDescendants(SelvaModify_Hierarchy *hierarchy, size_t nr_ids, const Selva_NodeId *ids, int max_depth, SelvaModify_HierarchyCallback cb, void *arg) {
+  const unsigned int stamp = ++hierarchy->visit_stamp;
+  Vector *q = NewVector(SelvaModify_HierarchyNode *, 64);
+  size_t level_end;
+  int level = 0;
+
+  for (size_t i = 0; i < nr_ids; i++) {
+    SelvaModify_HierarchyNode *node = SelvaModify_FindNode(hierarchy, ids[i]);
+
+    if (node) {
+      Vector_Push(q, node);
+    }
+  }
+  level_end = Vector_Size(q);
+
+  for (size_t i = 0; i < (size_t)Vector_Size(q); i++) {
+    SelvaModify_HierarchyNode *node;
+
+    if (i == level_end) {
+      level++;
+      level_end = Vector_Size(q);
+    }
+    if (max_depth >= 0 && level >= max_depth) {
+      break;
+    }
+
+    Vector_Get(q, i, &node);
+    for (size_t j = 0; j < node->children.nr; j++) {
+      SelvaModify_HierarchyNode *child = node->children.nodes[j];
+
+      if (child->visit_stamp == stamp) {
+        continue;
+      }
+      child->visit_stamp = stamp;
+
+      if (cb(nodeId(child), arg)) {
+        goto out;
+      }
+      Vector_Push(q, child);
+    }
+  }
+
+out:
+  Vector_Free(q);
+}
+
+static int deepestFirstCmp(const void *a, const void *b) {
+  const SelvaModify_HierarchyNode *na = *(const SelvaModify_HierarchyNode **)a;
+  const SelvaModify_HierarchyNode *nb = *(const SelvaModify_HierarchyNode **)b;
+
+  return na->depth != nb->depth ? nb->depth - na->depth : nodeIdCmp(a, b);
+}
+
+void SelvaModify_TraverseAncestors(SelvaModify_Hierarchy *hierarchy, const Selva_NodeId id, SelvaModify_HierarchyCallback cb, void *arg) {
+  SelvaModify_HierarchyNode *node = SelvaModify_FindNode(hierarchy, id);
+  const unsigned int stamp = ++hierarchy->visit_stamp;
+  Vector *q;
+
+  if (!node || node->parents.nr == 0) {
+    return;
+  }
+
+  q = NewVector(SelvaModify_HierarchyNode *, node->ancestors.nr);
+  for (size_t i = 0; i < node->parents.nr; i++) {
+    Vector_Push(q, node->parents.nodes[i]);
+  }
+  qsort(q->data, Vector_Size(q), sizeof(SelvaModify_HierarchyNode *), deepestFirstCmp);
+
+  for (size_t i = 0; i < (size_t)Vector_Size(q); i++) {
+    SelvaModify_HierarchyNode *ancestor;
+    size_t pos;
+
+    Vector_Get(q, i, &ancestor);
+    if (ancestor->visit_stamp == stamp) {
+      continue;
+    }
+    ancestor->visit_stamp = stamp;
+
+    if (ancestor->depth > 0 && edgesFind(&node->ancestors, ancestor->handle, &pos) && cb(nodeId(ancestor), arg)) {
+      break;
+    }
+
+    for (size_t j = 0; j < ancestor->parents.nr; j++) {
+      if (ancestor->parents.nodes[j]->visit_stamp != stamp) {
+        Vector_Push(q, ancestor->parents.nodes[j]);
+      }
+    }
+  }
+
+  Vector_Free(q);
+}
+
+static void finishLoading(RedisModuleCtx *ctx) {
+  if (Vector_Size(pending_loads) == 0) {
+    return;
+  }
+
+  // Loading the schema recomputes the default hierarchy, the rest are
+  // recomputed here
+  SelvaSchema_Load(ctx);
+
+  for (size_t i = 0; i < (size_t)Vector_Size(pending_loads); i++) {
+    SelvaModify_Hierarchy *hierarchy;
+
+    Vector_Get(pending_loads, i, &hierarchy);
+    SelvaModify_HierarchyRecompute(hierarchy);
+  }
+  pending_loads->top = 0;
+
+  RedisModuleString *key_name = RedisModule_CreateString(ctx, HIERARCHY_DEFAULT_KEY, sizeof(HIERARCHY_DEFAULT_KEY) - 1);
+  RedisModuleKey *key = RedisModule_OpenKey(ctx, key_name, REDISMODULE_READ);
+  if (RedisModule_ModuleTypeGetType(key) == HierarchyType) {
+    claimIndexes(RedisModule_ModuleTypeGetValue(key));
+  }
+  RedisModule_CloseKey(key);
+  RedisModule_FreeString(ctx, key_name);
+}
+
+static void loadTimerCallback(RedisModuleCtx *ctx, void *data) {
+  (void)data;
+
+  load_timer_armed = 0;
+  finishLoading(ctx);
+}
+
+SelvaModify_Hierarchy *SelvaModify_OpenHierarchyKey(RedisModuleCtx *ctx, RedisModuleString *key_name, int mode) {
+  // A command may run before the timer armed by the RDB load fires
+  finishLoading(ctx);
+
+  RedisModuleKey *key = RedisModule_OpenKey(ctx, key_name, REDISMODULE_READ | mode);
+  int type = RedisModule_KeyType(key);
+
+  size_t key_len;
+  const char *key_str = RedisModule_StringPtrLen(key_name, &key_len);
+  const int is_default = key_len == sizeof(HIERARCHY_DEFAULT_KEY) - 1 && !memcmp(key_str, HIERARCHY_DEFAULT_KEY, key_len);
+  SelvaModify_Hierarchy *hierarchy;
+
+  if (type == REDISMODULE_KEYTYPE_EMPTY && (mode & REDISMODULE_WRITE)) {
+    hierarchy = SelvaModify_NewHierarchy();
+    RedisModule_ModuleTypeSetValue(key, HierarchyType, hierarchy);
+    if (is_default) {
+      claimIndexes(hierarchy);
+    }
+    return hierarchy;
+  }
+
+  if (type == REDISMODULE_KEYTYPE_EMPTY) {
+    RedisModule_ReplyWithError(ctx, "ERR hierarchy not found");
+    return NULL;
+  }
+
+  if (RedisModule_ModuleTypeGetType(key) != HierarchyType) {
+    RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+    return NULL;
+  }
+
+  hierarchy = RedisModule_ModuleTypeGetValue(key);
+  if (is_default) {
+    claimIndexes(hierarchy);
+  }
+
+  return hierarchy;
+}
+
+// Parse argv[offset..argc] into an array of node ids
+static Selva_NodeId *parseNodeIds(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, int offset) {
+  const size_t n = argc > offset ? argc - offset : 0;
+  Selva_NodeId *ids = RedisModule_PoolAlloc(ctx, n * sizeof(Selva_NodeId) + 1);
+
+  for (size_t i = 0; i < n; i++) {
+    if (SelvaModify_ParseNodeId(ids[i], argv[offset + i]) == REDISMODULE_ERR) {
+      return NULL;
+    }
+  }
+
+  return ids;
+}
+
+static void replyWithEdges(RedisModuleCtx *ctx, const struct SelvaModify_HierarchyEdges *edges) {
+  RedisModule_ReplyWithArray(ctx, edges->nr);
+
+  for (size_t i = 0; i < edges->nr; i++) {
+    const char *id = nodeId(edges->nodes[i]);
+
+    RedisModule_ReplyWithStringBuffer(ctx, id, SelvaModify_NodeIdLen(id));
+  }
+}
+
+// Reply with the number of edges changed and the number of nodes whose depth or ancestors changed
+static int replyWithChanges(RedisModuleCtx *ctx, int nr_edges, int nr_nodes) {
+  RedisModule_ReplyWithArray(ctx, 2);
+  RedisModule_ReplyWithLongLong(ctx, nr_edges);
+  return RedisModule_ReplyWithLongLong(ctx, nr_nodes);
+}
+
+// SELVA.HIERARCHY.ADD key id [parent ...]
+int SelvaCommand_HierarchyAdd(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  RedisModule_AutoMemory(ctx);
+
+  if (argc < 3) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  if (!SelvaSchema_Get()) {
+    SelvaSchema_Load(ctx);
+  }
+
+  SelvaModify_Hierarchy *hierarchy = SelvaModify_OpenHierarchyKey(ctx, argv[1], REDISMODULE_WRITE);
+  if (!hierarchy) {
+    return REDISMODULE_OK;
+  }
+
+  Selva_NodeId id;
+  Selva_NodeId *parents = parseNodeIds(ctx, argv, argc, 3);
+  if (SelvaModify_ParseNodeId(id, argv[2]) == REDISMODULE_ERR || !parents) {
+    return RedisModule_ReplyWithError(ctx, "ERR invalid node id");
+  }
+
+  int added = SelvaModify_AddHierarchy(hierarchy, id, argc - 3, parents);
+  int changed = SelvaModify_HierarchyRecompute(hierarchy);
+
+  RedisModule_ReplicateVerbatim(ctx);
+  return replyWithChanges(ctx, added, changed);
+}
+
+// SELVA.HIERARCHY.DEL key id [parent ...]
+// Removes the given parent edges or the whole node if no parents are given.
+int SelvaCommand_HierarchyDel(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  RedisModule_AutoMemory(ctx);
+
+  if (argc < 3) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  if (!SelvaSchema_Get()) {
+    SelvaSchema_Load(ctx);
+  }
+
+  SelvaModify_Hierarchy *hierarchy = SelvaModify_OpenHierarchyKey(ctx, argv[1], REDISMODULE_WRITE);
+  if (!hierarchy) {
+    return REDISMODULE_OK;
+  }
+
+  Selva_NodeId id;
+  Selva_NodeId *parents = parseNodeIds(ctx, argv, argc, 3);
+  if (SelvaModify_ParseNodeId(id, argv[2]) == REDISMODULE_ERR || !parents) {
+    return RedisModule_ReplyWithError(ctx, "ERR invalid node id");
+  }
+
+  int removed = argc == 3
+    ? SelvaModify_DelHierarchyNode(hierarchy, id)
+    : SelvaModify_DelHierarchy(hierarchy, id, argc - 3, parents);
+  int changed = SelvaModify_HierarchyRecompute(hierarchy);
+
+  RedisModule_ReplicateVerbatim(ctx);
+  return replyWithChanges(ctx, removed, changed);
+}
+
+enum SelvaModify_HierarchyEdgeType {
+  HIERARCHY_EDGES_PARENTS,
+  HIERARCHY_EDGES_CHILDREN,
+  HIERARCHY_EDGES_ANCESTORS,
+};
+
+static int depthCmp(const void *a, const void *b) {
+  const SelvaModify_HierarchyNode *na = *(const SelvaModify_HierarchyNode **)a;
+  const SelvaModify_HierarchyNode *nb = *(const SelvaModify_HierarchyNode **)b;
+
+  return na->depth != nb->depth ? na->depth - nb->depth : nodeIdCmp(a, b);
+}
+
+static void replyWithAncestors(RedisModuleCtx *ctx, const struct SelvaModify_HierarchyEdges *ancestors) {
+  SelvaModify_HierarchyNode **nodes = RedisModule_PoolAlloc(ctx, ancestors->nr * sizeof(SelvaModify_HierarchyNode *) + 1);
+
+  memcpy(nodes, ancestors->nodes, ancestors->nr * sizeof(SelvaModify_HierarchyNode *));
+  qsort(nodes, ancestors->nr, sizeof(SelvaModify_HierarchyNode *), depthCmp);
+
+  RedisModule_ReplyWithArray(ctx, 2 * ancestors->nr);
+  for (size_t i = 0; i < ancestors->nr; i++) {
+    RedisModule_ReplyWithStringBuffer(ctx, nodeId(nodes[i]), SelvaModify_NodeIdLen(nodeId(nodes[i])));
+    RedisModule_ReplyWithLongLong(ctx, nodes[i]->depth);
+  }
+}
+
+static int replyWithNodeEdges(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, enum SelvaModify_HierarchyEdgeType type) {
+  RedisModule_AutoMemory(ctx);
+
+  if (argc != 3) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  SelvaModify_Hierarchy *hierarchy = SelvaModify_OpenHierarchyKey(ctx, argv[1], REDISMODULE_READ);
+  if (!hierarchy) {
+    return REDISMODULE_OK;
+  }
+
+  Selva_NodeId id;
+  if (SelvaModify_ParseNodeId(id, argv[2]) == REDISMODULE_ERR) {
+    return RedisModule_ReplyWithError(ctx, "ERR invalid node id");
+  }
+
+  SelvaModify_HierarchyNode *node = SelvaModify_FindNode(hierarchy, id);
+  if (!node) {
+    return RedisModule_ReplyWithArray(ctx, 0);
+  }
+
+  switch (type) {
+    case HIERARCHY_EDGES_PARENTS:
+      replyWithEdges(ctx, &node->parents);
+      break;
+    case HIERARCHY_EDGES_CHILDREN:
+      replyWithEdges(ctx, &node->children);
+      break;
+    case HIERARCHY_EDGES_ANCESTORS:
+      replyWithAncestors(ctx, &node->ancestors);
+      break;
+  }
+
+  return REDISMODULE_OK;
+}
+
+// SELVA.HIERARCHY.PARENTS key id
+int SelvaCommand_HierarchyParents(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  return replyWithNodeEdges(ctx, argv, argc, HIERARCHY_EDGES_PARENTS);
+}
+
+// SELVA.HIERARCHY.CHILDREN key id
+int SelvaCommand_HierarchyChildren(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  return replyWithNodeEdges(ctx, argv, argc, HIERARCHY_EDGES_CHILDREN);
+}
+
+// SELVA.HIERARCHY.ANCESTORS key id
+// Replies with id, depth pairs ordered by depth like ZRANGE WITHSCORES on the old .ancestors keys.
+int SelvaCommand_HierarchyAncestors(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  return replyWithNodeEdges(ctx, argv, argc, HIERARCHY_EDGES_ANCESTORS);
+}
+
+// SELVA.HIERARCHY.DEPTH key id
+int SelvaCommand_HierarchyDepth(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  RedisModule_AutoMemory(ctx);
+
+  if (argc != 3) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  SelvaModify_Hierarchy *hierarchy = SelvaModify_OpenHierarchyKey(ctx, argv[1], REDISMODULE_READ);
+  if (!hierarchy) {
+    return REDISMODULE_OK;
+  }
+
+  Selva_NodeId id;
+  if (SelvaModify_ParseNodeId(id, argv[2]) == REDISMODULE_ERR) {
+    return RedisModule_ReplyWithError(ctx, "ERR invalid node id");
+  }
+
+  int depth = SelvaModify_GetHierarchyDepth(hierarchy, id);
+  if (depth < 0) {
+    return RedisModule_ReplyWithNull(ctx);
+  }
+
+  return RedisModule_ReplyWithLongLong(ctx, depth);
+}
+
+static size_t putVarint(unsigned char *buf, uint32_t v) {
+  size_t n = 0;
+
+  while (v >= 0x80) {
+    buf[n++] = (unsigned char)(v | 0x80);
+    v >>= 7;
+  }
+  buf[n++] = (unsigned char)v;
+
+  return n;
+}
+
+static int getVarint(const unsigned char *buf, size_t len, size_t *pos, uint32_t *v) {
+  uint32_t res = 0;
+
+  for (unsigned int shift = 0; shift < 35 && *pos < len; shift += 7) {
+    const unsigned char b = buf[(*pos)++];
+
+    res |= (uint32_t)(b & 0x7f) << shift;
+    if (!(b & 0x80)) {
+      *v = res;
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+// Encoding version 0: nr_nodes, [id, nr_parents, [parent_id ...]] ...
+static SelvaModify_Hierarchy *loadHierarchyV0(RedisModuleIO *io) {
+  SelvaModify_Hierarchy *hierarchy = SelvaModify_NewHierarchy();
+  uint64_t nr_nodes = RedisModule_LoadUnsigned(io);
+
+  for (uint64_t i = 0; i < nr_nodes; i++) {
+    Selva_NodeId id;
+    size_t len;
+    char *buf = RedisModule_LoadStringBuffer(io, &len);
+
+    memset(id, '\0', SELVA_NODE_ID_SIZE);
+    memcpy(id, buf, len < SELVA_NODE_ID_SIZE ? len : SELVA_NODE_ID_SIZE);
+    RedisModule_Free(buf);
+
+    uint64_t nr_parents = RedisModule_LoadUnsigned(io);
+    Selva_NodeId *parents = RedisModule_Alloc(nr_parents * sizeof(Selva_NodeId) + 1);
+
+    for (uint64_t j = 0; j < nr_parents; j++) {
+      buf = RedisModule_LoadStringBuffer(io, &len);
+      memset(parents[j], '\0', SELVA_NODE_ID_SIZE);
+      memcpy(parents[j], buf, len < SELVA_NODE_ID_SIZE ? len : SELVA_NODE_ID_SIZE);
+      RedisModule_Free(buf);
+    }
+
+    findOrCreateNode(hierarchy, id);
+    SelvaModify_AddHierarchy(hierarchy, id, nr_parents, (const Selva_NodeId *)parents);
+    RedisModule_Free(parents);
+  }
+
+  return hierarchy;
+}
+
+// Encoding version 1: nr_nodes, ids, edges
+// ids is a single buffer of [len, id bytes] for every node. Nodes are
+// numbered in the order of ids, and edges is a single buffer of varints
+// with [nr_parents, parent numbers as deltas from the previous one] for
+// every node. Parents are sorted by number so the deltas stay small.
+static SelvaModify_Hierarchy *loadHierarchyV1(RedisModuleIO *io) {
+  SelvaModify_Hierarchy *hierarchy = NULL;
+  SelvaModify_HierarchyNode **nodes = NULL;
+  uint64_t nr_nodes = RedisModule_LoadUnsigned(io);
+  size_t ids_len, edges_len, pos = 0;
+  unsigned char *ids = (unsigned char *)RedisModule_LoadStringBuffer(io, &ids_len);
+  unsigned char *edges = (unsigned char *)RedisModule_LoadStringBuffer(io, &edges_len);
+
+  if (!ids || !edges || nr_nodes > ids_len) {
+    goto fail;
+  }
+
+  hierarchy = SelvaModify_NewHierarchy();
+  nodes = RedisModule_Alloc(nr_nodes * sizeof(SelvaModify_HierarchyNode *) + 1);
+
+  for (uint64_t i = 0; i < nr_nodes; i++) {
+    Selva_NodeId id;
+    size_t len;
+
+    if (pos >= ids_len || (len = ids[pos++]) == 0 || len > SELVA_NODE_ID_SIZE || pos + len > ids_len) {
+      goto fail;
+    }
+
+    memset(id, '\0', SELVA_NODE_ID_SIZE);
+    memcpy(id, ids + pos, len);
+    pos += len;
+    nodes[i] = findOrCreateNode(hierarchy, id);
+  }
+
+  pos = 0;
+  for (uint64_t i = 0; i < nr_nodes; i++) {
+    SelvaModify_HierarchyNode *node = nodes[i];
+    uint32_t nr_parents, parent = 0;
+
+    if (getVarint(edges, edges_len, &pos, &nr_parents)) {
+      goto fail;
+    }
+
+    for (uint32_t j = 0; j < nr_parents; j++) {
+      uint32_t delta;
+
+      if (getVarint(edges, edges_len, &pos, &delta) || (uint64_t)parent + delta >= nr_nodes) {
+        goto fail;
+      }
+      parent += delta;
+
+      if (nodes[parent] != node && edgesInsert(&node->parents, nodes[parent])) {
+        edgesInsert(&nodes[parent]->children, node);
+      }
+    }
+
+    if (nr_parents > 0) {
+      markDirty(hierarchy, node);
+    }
+  }
+
+  RedisModule_Free(nodes);
+  RedisModule_Free(edges);
+  RedisModule_Free(ids);
+
+  return hierarchy;
+fail:
+  RedisModule_LogIOError(io, "warning", "corrupted selva_hierarchy");
+  if (hierarchy) {
+    SelvaModify_DestroyHierarchy(hierarchy);
+  }
+  RedisModule_Free(nodes);
+  RedisModule_Free(edges);
+  RedisModule_Free(ids);
+
+  return NULL;
+}
+
+static void *Hierarchy_RDBLoad(RedisModuleIO *io, int encver) {
+  SelvaModify_Hierarchy *hierarchy;
+
+  switch (encver) {
+    case 0:
+      hierarchy = loadHierarchyV0(io);
+      break;
+    case 1:
+      hierarchy = loadHierarchyV1(io);
+      break;
+    default:
+      RedisModule_LogIOError(io, "warning", "selva_hierarchy encoding version %d not supported", encver);
+      return NULL;
+  }
+
+  // The schema key may come later in the RDB, so the hierarchy is computed
+  // only once the loading is done and the timers run again
+  if (hierarchy) {
+    Vector_Push(pending_loads, hierarchy);
+    if (!load_timer_armed) {
+      RedisModule_CreateTimer(RedisModule_GetContextFromIO(io), 0, loadTimerCallback, NULL);
+      load_timer_armed = 1;
+    }
+  }
+
+  return hierarchy;
+}
+
+static void Hierarchy_RDBSave(RedisModuleIO *io, void *value) {
+  SelvaModify_Hierarchy *hierarchy = value;
+  uint32_t *numbers = RedisModule_Alloc(hierarchy->nr_slots * sizeof(uint32_t) + 1);
+  size_t ids_len = 0, edges_len = 0;
+  uint32_t nr = 0;
+
+  // Number the nodes in handle order so that the sorted edge arrays stay sorted
+  for (size_t i = 0; i < hierarchy->nr_slots; i++) {
+    const SelvaModify_HierarchyNode *node = hierarchy->nodes[i];
+
+    if (node) {
+      numbers[i] = nr++;
+      ids_len += 1 + SelvaModify_NodeIdLen(nodeId(node));
+      edges_len += 5 * (1 + node->parents.nr);
+    }
+  }
+
+  unsigned char *ids = RedisModule_Alloc(ids_len + 1);
+  unsigned char *edges = RedisModule_Alloc(edges_len + 1);
+
+  ids_len = 0;
+  edges_len = 0;
+  for (size_t i = 0; i < hierarchy->nr_slots; i++) {
+    const SelvaModify_HierarchyNode *node = hierarchy->nodes[i];
+    uint32_t prev = 0;
+
+    if (!node) {
+      continue;
+    }
+
+    const size_t len = SelvaModify_NodeIdLen(nodeId(node));
+    ids[ids_len++] = (unsigned char)len;
+    memcpy(ids + ids_len, nodeId(node), len);
+    ids_len += len;
+
+    edges_len += putVarint(edges + edges_len, node->parents.nr);
+    for (size_t j = 0; j < node->parents.nr; j++) {
+      const uint32_t parent = numbers[node->parents.nodes[j]->handle];
+
+      edges_len += putVarint(edges + edges_len, parent - prev);
+      prev = parent;
+    }
+  }
+
+  RedisModule_SaveUnsigned(io, nr);
+  RedisModule_SaveStringBuffer(io, (const char *)ids, ids_len);
+  RedisModule_SaveStringBuffer(io, (const char *)edges, edges_len);
+
+  RedisModule_Free(edges);
+  RedisModule_Free(ids);
+  RedisModule_Free(numbers);
+}
+
+// Nodes without parents are emitted first so that an empty node isn't lost
+static void Hierarchy_AOFRewrite(RedisModuleIO *aof, RedisModuleString *key, void *value) {
+  SelvaModify_Hierarchy *hierarchy = value;
+
+  for (size_t i = 0; i < hierarchy->nr_slots; i++) {
+    const SelvaModify_HierarchyNode *node = hierarchy->nodes[i];
+
+    if (node && node->parents.nr == 0) {
+      RedisModule_EmitAOF(aof, "SELVA.HIERARCHY.ADD", "sb", key, nodeId(node), SelvaModify_NodeIdLen(nodeId(node)));
+    }
+  }
+
+  for (size_t i = 0; i < hierarchy->nr_slots; i++) {
+    const SelvaModify_HierarchyNode *node = hierarchy->nodes[i];
+
+    if (!node) {
+      continue;
+    }
+
+    for (size_t j = 0; j < node->parents.nr; j++) {
+      const char *parent_id = nodeId(node->parents.nodes[j]);
+
+      RedisModule_EmitAOF(aof, "SELVA.HIERARCHY.ADD", "sbb", key,
+          nodeId(node), SelvaModify_NodeIdLen(nodeId(node)),
+          parent_id, SelvaModify_NodeIdLen(parent_id));
+    }
+  }
+}
+
+static size_t Hierarchy_MemUsage(const void *value) {
+  const SelvaModify_Hierarchy *hierarchy = value;
+  size_t size = sizeof(*hierarchy) + hierarchy->nr_slots * sizeof(SelvaModify_HierarchyNode *);
+
+  for (size_t i = 0; i < hierarchy->nr_slots; i++) {
+    const SelvaModify_HierarchyNode *node = hierarchy->nodes[i];
+
+    if (node) {
+      size += sizeof(*node) +
+        (node->parents.cap + node->children.cap + node->ancestors.cap) * sizeof(SelvaModify_HierarchyNode *);
+    }
+  }
+
+  return size;
+}
+
+// Every node and edge is its own sequence so that the digest doesn't depend
+// on the handle order, which differs between instances.
+static void Hierarchy_Digest(RedisModuleDigest *md, void *value) {
+  SelvaModify_Hierarchy *hierarchy = value;
+
+  for (size_t i = 0; i < hierarchy->nr_slots; i++) {
+    const SelvaModify_HierarchyNode *node = hierarchy->nodes[i];
+
+    if (!node) {
+      continue;
+    }
+
+    RedisModule_DigestAddStringBuffer(md, (unsigned char *)nodeId(node), SELVA_NODE_ID_SIZE);
+    RedisModule_DigestEndSequence(md);
+
+    for (size_t j = 0; j < node->parents.nr; j++) {
+      RedisModule_DigestAddStringBuffer(md, (unsigned char *)nodeId(node), SELVA_NODE_ID_SIZE);
+      RedisModule_DigestAddStringBuffer(md, (unsigned char *)nodeId(node->parents.nodes[j]), SELVA_NODE_ID_SIZE);
+      RedisModule_DigestEndSequence(md);
+    }
+  }
+}
+
+static void Hierarchy_Free(void *value) {
+  for (size_t i = 0; i < (size_t)Vector_Size(pending_loads); i++) {
+    SelvaModify_Hierarchy *hierarchy;
+
+    Vector_Get(pending_loads, i, &hierarchy);
+    if (hierarchy == value) {
+      Vector_Get(pending_loads, Vector_Size(pending_loads) - 1, &hierarchy);
+      Vector_Put(pending_loads, i, hierarchy);
+      pending_loads->top--;
+      break;
+    }
+  }
+
+  SelvaModify_DestroyHierarchy(value);
+}
+
+int SelvaModify_Hierarchy_OnLoad(RedisModuleCtx *ctx) {
+  RedisModuleTypeMethods tm = {
+    .version = REDISMODULE_TYPE_METHOD_VERSION,
+    .rdb_load = Hierarchy_RDBLoad,
+    .rdb_save = Hierarchy_RDBSave,
+    .aof_rewrite = Hierarchy_AOFRewrite,
+    .mem_usage = Hierarchy_MemUsage,
+    .digest = Hierarchy_Digest,
+    .free = Hierarchy_Free,
+  };
+
+  pending_loads = NewVector(SelvaModify_Hierarchy *, 1);
+
+  HierarchyType = RedisModule_CreateDataType(ctx, "hierarchy", HIERARCHY_ENCODING_VERSION, &tm);
+  if (HierarchyType == NULL) {
+    return REDISMODULE_ERR;
+  }
+
+  if (RedisModule_CreateCommand(ctx, "selva.hierarchy.add", SelvaCommand_HierarchyAdd, "write deny-oom", 1, 1, 1) == REDISMODULE_ERR ||
+      RedisModule_CreateCommand(ctx, "selva.hierarchy.del", SelvaCommand_HierarchyDel, "write", 1, 1, 1) == REDISMODULE_ERR ||
+      RedisModule_CreateCommand(ctx, "selva.hierarchy.parents", SelvaCommand_HierarchyParents, "readonly", 1, 1, 1) == REDISMODULE_ERR ||
+      RedisModule_CreateCommand(ctx, "selva.hierarchy.children", SelvaCommand_HierarchyChildren, "readonly", 1, 1, 1) == REDISMODULE_ERR ||
+      RedisModule_CreateCommand(ctx, "selva.hierarchy.ancestors", SelvaCommand_HierarchyAncestors, "readonly", 1, 1, 1) == REDISMODULE_ERR ||
+      RedisModule_CreateCommand(ctx, "selva.hierarchy.depth", SelvaCommand_HierarchyDepth, "readonly", 1, 1, 1) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  return REDISMODULE_OK;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#ifndef SELVA_MODIFY_HIERARCHY
+#define SELVA_MODIFY_HIERARCHY
+
+#include <stddef.h>
+
+#include "../id/id.h"
+
+#define HIERARCHY_DEFAULT_KEY "___selva_hierarchy"
+
+struct SelvaModify_HierarchyNode;
+typedef struct SelvaModify_HierarchyNode SelvaModify_HierarchyNode;
+
+struct SelvaModify_Hierarchy;
+typedef struct SelvaModify_Hierarchy SelvaModify_Hierarchy;
+
+extern RedisModuleType *HierarchyType;
+
+SelvaModify_Hierarchy *SelvaModify_NewHierarchy(void);
+void SelvaModify_DestroyHierarchy(SelvaModify_Hierarchy *hierarchy);
+
+// Open the hierarchy stored in key_name, or create an empty one if mode is REDISMODULE_WRITE.
+// Replies with an error and returns NULL if the key holds some other type.
+SelvaModify_Hierarchy *SelvaModify_OpenHierarchyKey(RedisModuleCtx *ctx, RedisModuleString *key_name, int mode);
+
+int SelvaModify_ParseNodeId(Selva_NodeId id, RedisModuleString *str);
+size_t SelvaModify_NodeIdLen(const Selva_NodeId id);
+
+SelvaModify_HierarchyNode *SelvaModify_FindNode(SelvaModify_Hierarchy *hierarchy, const Selva_NodeId id);
+int SelvaModify_HierarchyNodeExists(SelvaModify_Hierarchy *hierarchy, const Selva_NodeId id);
+int SelvaModify_GetHierarchyDepth(SelvaModify_Hierarchy *hierarchy, const Selva_NodeId id);
+
+// Edge changes only mark nodes dirty; depth and ancestors are updated by
+// SelvaModify_HierarchyRecompute(), which must be called before the hierarchy is read again.
+
+// Add edges from each of the parents to id, creating the nodes as needed. Returns the number of new edges.
+int SelvaModify_AddHierarchy(SelvaModify_Hierarchy *hierarchy, const Selva_NodeId id, size_t nr_parents, const Selva_NodeId *parents);
+
+// Remove edges from each of the parents to id. Returns the number of edges removed.
+int SelvaModify_DelHierarchy(SelvaModify_Hierarchy *hierarchy, const Selva_NodeId id, size_t nr_parents, const Selva_NodeId *parents);
+
+// Remove a node and all of its edges. Returns 0 if the node didn't exist.
+int SelvaModify_DelHierarchyNode(SelvaModify_Hierarchy *hierarchy, const Selva_NodeId id);
+
+void SelvaModify_HierarchyMarkAllDirty(SelvaModify_Hierarchy *hierarchy);
+
+// Update the subtrees of all dirty nodes in topological order.
+// Returns the number of nodes whose depth or ancestors changed.
+int SelvaModify_HierarchyRecompute(SelvaModify_Hierarchy *hierarchy);
+
+// Return non-zero to stop the traversal
+typedef int (*SelvaModify_HierarchyCallback)(const Selva_NodeId id, void *arg);
+
+// Visit the descendants of the given nodes breadth-first, every node at most once.
+// The given nodes are visited only if they are descendants of one another.
+// A negative max_depth means no depth limit.
+void SelvaModify_TraverseDescendants(SelvaModify_Hierarchy *hierarchy, size_t nr_ids, const Selva_NodeId *ids, int max_depth, SelvaModify_HierarchyCallback cb, void *arg);
+
+// Visit the ancestors of a node breadth-first starting from its deepest parent, every ancestor at most once.
+// Only nodes in the ancestry of id are visited, and nodes at depth 0 are skipped like in $inherit.
+void SelvaModify_TraverseAncestors(SelvaModify_Hierarchy *hierarchy, const Selva_NodeId id, SelvaModify_HierarchyCallback cb, void *arg);
+
+int SelvaModify_Hierarchy_OnLoad(RedisModuleCtx *ctx);
+
+#endif /* SELVA_MODIFY_HIERARCHY */
@@ -2,6 +2,12 @@
 #ifndef SELVA_ID
 #define SELVA_ID
 
+#define SELVA_NODE_ID_SIZE 10
+#define ROOT_NODE_ID "root\0\0\0\0\0\0"
+
+// Node ids are stored in fixed size buffers padded with NUL bytes
+typedef char Selva_NodeId[SELVA_NODE_ID_SIZE];
+
 int SelvaId_GenId(const char* prefix, char* hash_str);
 
 #endif /* SELVA_ID */
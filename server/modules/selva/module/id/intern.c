@@ -0,0 +1,106 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "../../redismodule.h"
+#include "../../rmutil/vector.h"
+#include "./intern.h"
+
+// Entries are allocated in chunks so that the id pointers returned by
+// SelvaId_GetId() don't move when the table grows.
+#define INTERN_CHUNK_SHIFT 12
+#define INTERN_CHUNK_SIZE (1 << INTERN_CHUNK_SHIFT)
+
+struct SelvaId_Entry {
+  Selva_NodeId id;
+  uint32_t refcount;
+};
+
+static RedisModuleDict *intern_index;
+static struct SelvaId_Entry **chunks;
+static size_t nr_chunks;
+static Selva_NodeHandle next_handle;
+static size_t nr_handles;
+static Vector *free_handles;
+
+static struct SelvaId_Entry *getEntry(Selva_NodeHandle handle) {
+  return &chunks[handle >> INTERN_CHUNK_SHIFT][handle & (INTERN_CHUNK_SIZE - 1)];
+}
+
+static Selva_NodeHandle allocHandle(void) {
+  Selva_NodeHandle handle;
+
+  if (free_handles && Vector_Size(free_handles) > 0) {
+    Vector_Pop(free_handles, &handle);
+    return handle;
+  }
+
+  handle = next_handle++;
+  if ((handle >> INTERN_CHUNK_SHIFT) == nr_chunks) {
+    chunks = RedisModule_Realloc(chunks, (nr_chunks + 1) * sizeof(struct SelvaId_Entry *));
+    chunks[nr_chunks++] = RedisModule_Calloc(INTERN_CHUNK_SIZE, sizeof(struct SelvaId_Entry));
+  }
+
+  return handle;
+}
+
+Selva_NodeHandle SelvaId_Intern(const Selva_NodeId id) {
+  Selva_NodeHandle handle = SelvaId_Lookup(id);
+  struct SelvaId_Entry *entry;
+
+  if (handle != SELVA_NODE_HANDLE_NONE) {
+    getEntry(handle)->refcount++;
+    return handle;
+  }
+
+  if (!intern_index) {
+    intern_index = RedisModule_CreateDict(NULL);
+    free_handles = NewVector(Selva_NodeHandle, 0);
+  }
+
+  handle = allocHandle();
+  entry = getEntry(handle);
+  memcpy(entry->id, id, SELVA_NODE_ID_SIZE);
+  entry->refcount = 1;
+  // The dict value is handle + 1 so that handle 0 isn't stored as NULL
+  RedisModule_DictSetC(intern_index, entry->id, SELVA_NODE_ID_SIZE, (void *)((uintptr_t)handle + 1));
+  nr_handles++;
+
+  return handle;
+}
+
+Selva_NodeHandle SelvaId_Lookup(const Selva_NodeId id) {
+  uintptr_t value;
+
+  if (!intern_index) {
+    return SELVA_NODE_HANDLE_NONE;
+  }
+
+  value = (uintptr_t)RedisModule_DictGetC(intern_index, (void *)id, SELVA_NODE_ID_SIZE, NULL);
+
+  return value ? (Selva_NodeHandle)(value - 1) : SELVA_NODE_HANDLE_NONE;
+}
+
+void SelvaId_Release(Selva_NodeHandle handle) {
+  struct SelvaId_Entry *entry = getEntry(handle);
+
+  if (--entry->refcount > 0) {
+    return;
+  }
+
+  RedisModule_DictDelC(intern_index, entry->id, SELVA_NODE_ID_SIZE, NULL);
+  memset(entry->id, '\0', SELVA_NODE_ID_SIZE);
+  Vector_Push(free_handles, handle);
+  nr_handles--;
+}
+
+const char *SelvaId_GetId(Selva_NodeHandle handle) {
+  return getEntry(handle)->id;
+}
+
+size_t SelvaId_Count(void) {
+  return nr_handles;
+}
+
+size_t SelvaId_HandleLimit(void) {
+  return next_handle;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#ifndef SELVA_ID_INTERN
+#define SELVA_ID_INTERN
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "./id.h"
+
+// Node ids interned into small integer handles. Handles are dense, so
+// native structures can index arrays with them and compare them as integers.
+typedef uint32_t Selva_NodeHandle;
+
+#define SELVA_NODE_HANDLE_NONE UINT32_MAX
+
+// Return the handle of id and take a reference to it
+Selva_NodeHandle SelvaId_Intern(const Selva_NodeId id);
+
+// Return the handle of id without taking a reference, or SELVA_NODE_HANDLE_NONE
+Selva_NodeHandle SelvaId_Lookup(const Selva_NodeId id);
+
+// Drop a reference taken with SelvaId_Intern(). The handle may be reused once
+// the last reference is gone.
+void SelvaId_Release(Selva_NodeHandle handle);
+
+// Return the NUL padded id of a handle. The pointer stays valid as long as
+// the handle is referenced.
+const char *SelvaId_GetId(Selva_NodeHandle handle);
+
+// The number of handles in use
+size_t SelvaId_Count(void);
+
+// Every handle in use is below this, so it sizes arrays and bitmaps indexed by handle
+size_t SelvaId_HandleLimit(void);
+
+#endif /* SELVA_ID_INTERN */
@@ -0,0 +1,129 @@
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#include "../../redismodule.h"
+#include "../hierarchy/hierarchy.h"
+#include "../typeindex/typeindex.h"
+#include "./inherit.h"
+
+struct InheritArgs {
+  RedisModuleCtx *ctx;
+  struct SelvaTypeIndex_Filter *types;
+  size_t nr_fields;
+  size_t nr_left;
+  RedisModuleString **fields;
+  RedisModuleString **values;
+  Selva_NodeId *sources;
+};
+
+// Take every still missing field from the ancestor in one key lookup
+static int inheritFromAncestor(const Selva_NodeId id, void *arg) {
+  struct InheritArgs *args = (struct InheritArgs *)arg;
+  RedisModuleString *key_name;
+  RedisModuleKey *key;
+
+  if (!SelvaTypeIndex_FilterMatches(args->types, id)) {
+    return 0;
+  }
+
+  key_name = RedisModule_CreateString(args->ctx, id, SelvaModify_NodeIdLen(id));
+  key = RedisModule_OpenKey(args->ctx, key_name, REDISMODULE_READ);
+  if (RedisModule_KeyType(key) != REDISMODULE_KEYTYPE_HASH) {
+    RedisModule_CloseKey(key);
+    return 0;
+  }
+
+  for (size_t i = 0; i < args->nr_fields; i++) {
+    RedisModuleString *value = NULL;
+    size_t len;
+
+    if (args->values[i]) {
+      continue;
+    }
+
+    RedisModule_HashGet(key, REDISMODULE_HASH_NONE, args->fields[i], &value, NULL);
+    if (value && (RedisModule_StringPtrLen(value, &len), len > 0)) {
+      args->values[i] = value;
+      memcpy(args->sources[i], id, SELVA_NODE_ID_SIZE);
+      args->nr_left--;
+    }
+  }
+
+  RedisModule_CloseKey(key);
+
+  return args->nr_left == 0;
+}
+
+// SELVA.INHERIT key id field [field ...] [TYPES prefix ...]
+// Replies with [ancestor_id, value] or null for each field.
+int SelvaCommand_Inherit(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  RedisModule_AutoMemory(ctx);
+
+  if (argc < 4) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  SelvaModify_Hierarchy *hierarchy = SelvaModify_OpenHierarchyKey(ctx, argv[1], REDISMODULE_READ);
+  if (!hierarchy) {
+    return REDISMODULE_OK;
+  }
+
+  Selva_NodeId id;
+  if (SelvaModify_ParseNodeId(id, argv[2]) == REDISMODULE_ERR) {
+    return RedisModule_ReplyWithError(ctx, "ERR invalid node id");
+  }
+
+  struct InheritArgs args = {
+    .ctx = ctx,
+    .types = RedisModule_PoolAlloc(ctx, sizeof(struct SelvaTypeIndex_Filter)),
+    .fields = argv + 3,
+  };
+
+  SelvaTypeIndex_InitFilter(args.types);
+
+  for (int i = 3; i < argc; i++) {
+    if (!strcasecmp(RedisModule_StringPtrLen(argv[i], NULL), "TYPES")) {
+      for (int j = i + 1; j < argc; j++) {
+        if (SelvaTypeIndex_FilterAdd(args.types, argv[j]) == REDISMODULE_ERR) {
+          return RedisModule_ReplyWithError(ctx, "ERR invalid type prefix");
+        }
+      }
+      break;
+    }
+    args.nr_fields++;
+  }
+
+  if (args.nr_fields == 0) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  args.nr_left = args.nr_fields;
+  args.values = RedisModule_PoolAlloc(ctx, args.nr_fields * sizeof(RedisModuleString *));
+  args.sources = RedisModule_PoolAlloc(ctx, args.nr_fields * sizeof(Selva_NodeId));
+  memset(args.values, 0, args.nr_fields * sizeof(RedisModuleString *));
+
+  SelvaModify_TraverseAncestors(hierarchy, id, inheritFromAncestor, &args);
+
+  RedisModule_ReplyWithArray(ctx, args.nr_fields);
+  for (size_t i = 0; i < args.nr_fields; i++) {
+    if (!args.values[i]) {
+      RedisModule_ReplyWithNull(ctx);
+      continue;
+    }
+
+    RedisModule_ReplyWithArray(ctx, 2);
+    RedisModule_ReplyWithStringBuffer(ctx, args.sources[i], SelvaModify_NodeIdLen(args.sources[i]));
+    RedisModule_ReplyWithString(ctx, args.values[i]);
+  }
+
+  return REDISMODULE_OK;
+}
+
+int SelvaModify_Inherit_OnLoad(RedisModuleCtx *ctx) {
+  if (RedisModule_CreateCommand(ctx, "selva.inherit", SelvaCommand_Inherit, "readonly", 1, 1, 1) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  return REDISMODULE_OK;
+}
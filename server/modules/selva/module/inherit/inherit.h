@@ -0,0 +1,7 @@
+#pragma once
+#ifndef SELVA_MODIFY_INHERIT
+#define SELVA_MODIFY_INHERIT
+
+int SelvaModify_Inherit_OnLoad(RedisModuleCtx *ctx);
+
+#endif /* SELVA_MODIFY_INHERIT */
@@ -0,0 +1,472 @@
+#include <errno.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../redismodule.h"
+#include "./async_task.h"
+
+#define CLIENT_SOCK_FILE "/tmp/selva.sock"
+
+#define ASYNC_QUEUE_DEFAULT_SIZE 4096
+#define ASYNC_BATCH_SIZE 64
+#define ASYNC_RECONNECT_MS 100
+#define ASYNC_IDLE_MS 10
+
+struct asyncTask {
+  struct asyncTask *next;
+  size_t len;
+  char payload[];
+};
+
+// A slot is free for the producer when seq == pos and holds a task for
+// the consumer when seq == pos + 1, as in Vyukov's bounded queue. Any
+// thread may dequeue, which is what drop-oldest needs.
+struct queueSlot {
+  _Atomic size_t seq;
+  struct asyncTask *task;
+};
+
+static struct queueSlot *queue;
+static size_t queue_mask;
+static _Atomic size_t queue_head;
+static _Atomic size_t queue_tail;
+
+static enum SelvaModify_AsyncOverflow overflow_policy = SELVA_MODIFY_ASYNC_OVERFLOW_DROP_OLDEST;
+
+// Tasks that didn't fit in the queue with the spill policy. Once a task
+// is spilled, the following ones are too until the worker takes the list,
+// so that the order is kept.
+static pthread_mutex_t spill_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct asyncTask *spill_first;
+static struct asyncTask *spill_last;
+static _Atomic int spill_nonempty;
+
+static pthread_mutex_t idle_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+static _Atomic int worker_idle;
+
+static _Atomic uint64_t stat_spill_depth;
+static _Atomic uint64_t stat_enqueued;
+static _Atomic uint64_t stat_sent;
+static _Atomic uint64_t stat_dropped;
+static _Atomic uint64_t stat_spilled;
+static _Atomic uint64_t stat_send_errors;
+
+static int queuePush(struct asyncTask *task) {
+  size_t pos = atomic_load_explicit(&queue_head, memory_order_relaxed);
+  struct queueSlot *slot;
+
+  for (;;) {
+    slot = &queue[pos & queue_mask];
+    const size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    const intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+
+    if (dif == 0) {
+      if (atomic_compare_exchange_weak_explicit(&queue_head, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+        break;
+      }
+    } else if (dif < 0) {
+      return -1;
+    } else {
+      pos = atomic_load_explicit(&queue_head, memory_order_relaxed);
+    }
+  }
+
+  slot->task = task;
+  atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+  return 0;
+}
+
+static struct asyncTask *queuePop(void) {
+  size_t pos = atomic_load_explicit(&queue_tail, memory_order_relaxed);
+  struct queueSlot *slot;
+  struct asyncTask *task;
+
+  for (;;) {
+    slot = &queue[pos & queue_mask];
+    const size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    const intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+
+    if (dif == 0) {
+      if (atomic_compare_exchange_weak_explicit(&queue_tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+        break;
+      }
+    } else if (dif < 0) {
+      return NULL;
+    } else {
+      pos = atomic_load_explicit(&queue_tail, memory_order_relaxed);
+    }
+  }
+
+  task = slot->task;
+  atomic_store_explicit(&slot->seq, pos + queue_mask + 1, memory_order_release);
+
+  return task;
+}
+
+static void spillPush(struct asyncTask *task) {
+  task->next = NULL;
+
+  pthread_mutex_lock(&spill_lock);
+  if (spill_last) {
+    spill_last->next = task;
+  } else {
+    spill_first = task;
+  }
+  spill_last = task;
+  atomic_store(&spill_nonempty, 1);
+  pthread_mutex_unlock(&spill_lock);
+
+  atomic_fetch_add(&stat_spill_depth, 1);
+  atomic_fetch_add(&stat_spilled, 1);
+}
+
+static struct asyncTask *spillTake(void) {
+  struct asyncTask *first;
+
+  if (!atomic_load(&spill_nonempty)) {
+    return NULL;
+  }
+
+  pthread_mutex_lock(&spill_lock);
+  // Tasks queued before the first spilled one may have arrived since the
+  // worker found the queue empty
+  if (atomic_load(&queue_head) != atomic_load(&queue_tail)) {
+    pthread_mutex_unlock(&spill_lock);
+    return NULL;
+  }
+
+  first = spill_first;
+  spill_first = NULL;
+  spill_last = NULL;
+  atomic_store(&spill_nonempty, 0);
+  pthread_mutex_unlock(&spill_lock);
+
+  return first;
+}
+
+static void sleepMs(long ms) {
+  struct timespec ts = {
+    .tv_sec = ms / 1000,
+    .tv_nsec = (ms % 1000) * 1000000L,
+  };
+
+  nanosleep(&ts, NULL);
+}
+
+static void dropOldest(void) {
+  struct asyncTask *oldest = queuePop();
+
+  if (oldest) {
+    RedisModule_Free(oldest);
+    atomic_fetch_add_explicit(&stat_dropped, 1, memory_order_relaxed);
+  }
+}
+
+static void wakeWorker(void) {
+  if (atomic_load_explicit(&worker_idle, memory_order_acquire)) {
+    pthread_mutex_lock(&idle_lock);
+    pthread_cond_signal(&idle_cond);
+    pthread_mutex_unlock(&idle_lock);
+  }
+}
+
+char *SelvaModify_NewAsyncTask(size_t len) {
+  struct asyncTask *task = RedisModule_Alloc(sizeof(struct asyncTask) + len);
+
+  task->next = NULL;
+  task->len = len;
+
+  return task->payload;
+}
+
+void SelvaModify_SendAsyncTask(char *payload) {
+  struct asyncTask *task = (struct asyncTask *)(payload - offsetof(struct asyncTask, payload));
+
+  atomic_fetch_add_explicit(&stat_enqueued, 1, memory_order_relaxed);
+
+  if (overflow_policy == SELVA_MODIFY_ASYNC_OVERFLOW_SPILL && atomic_load(&spill_nonempty)) {
+    spillPush(task);
+    goto out;
+  }
+
+  while (queuePush(task)) {
+    switch (overflow_policy) {
+      case SELVA_MODIFY_ASYNC_OVERFLOW_DROP_OLDEST:
+        dropOldest();
+        break;
+      case SELVA_MODIFY_ASYNC_OVERFLOW_SPILL:
+        spillPush(task);
+        goto out;
+    }
+  }
+
+out:
+  wakeWorker();
+}
+
+void SelvaModify_GetAsyncTaskStats(struct SelvaModify_AsyncTaskStats *stats) {
+  const size_t head = atomic_load(&queue_head);
+  const size_t tail = atomic_load(&queue_tail);
+
+  stats->depth = head > tail ? head - tail : 0;
+  stats->spill_depth = atomic_load(&stat_spill_depth);
+  stats->enqueued = atomic_load(&stat_enqueued);
+  stats->sent = atomic_load(&stat_sent);
+  stats->dropped = atomic_load(&stat_dropped);
+  stats->spilled = atomic_load(&stat_spilled);
+  stats->send_errors = atomic_load(&stat_send_errors);
+}
+
+static int connectSocket(void) {
+  struct sockaddr_un addr;
+  int fd = socket(PF_UNIX, SOCK_STREAM, 0);
+
+  if (fd < 0) {
+    return -1;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, CLIENT_SOCK_FILE, sizeof(addr.sun_path) - 1);
+
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+// Write the whole vector, resuming after short writes
+static int writeAll(int fd, struct iovec *iov, int iovcnt) {
+  while (iovcnt > 0) {
+    struct msghdr msg = {
+      .msg_iov = iov,
+      .msg_iovlen = iovcnt,
+    };
+    ssize_t res = sendmsg(fd, &msg, MSG_NOSIGNAL);
+
+    if (res < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+
+    while (iovcnt > 0 && (size_t)res >= iov->iov_len) {
+      res -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = (char *)iov->iov_base + res;
+      iov->iov_len -= res;
+    }
+  }
+
+  return 0;
+}
+
+// Send a batch, reconnecting until it's written. The batch stays in the
+// worker meanwhile, so the queue fills up and the overflow policy applies.
+static void sendBatch(int *fd, struct asyncTask **batch, int n) {
+  struct iovec iov[1 + ASYNC_BATCH_SIZE];
+  char header[SELVA_MODIFY_ASYNC_FRAME_HEADER_SIZE] = { SELVA_MODIFY_ASYNC_FRAME_VERSION };
+  size_t len = 0;
+
+  for (int i = 0; i < n; i++) {
+    len += batch[i]->len;
+  }
+  SelvaModify_PutLe32(header + 4, (uint32_t)n);
+  SelvaModify_PutLe32(header + 8, (uint32_t)len);
+
+  for (;;) {
+    if (*fd < 0 && (*fd = connectSocket()) < 0) {
+      atomic_fetch_add_explicit(&stat_send_errors, 1, memory_order_relaxed);
+      sleepMs(ASYNC_RECONNECT_MS);
+      continue;
+    }
+
+    iov[0].iov_base = header;
+    iov[0].iov_len = sizeof(header);
+    for (int i = 0; i < n; i++) {
+      iov[1 + i].iov_base = batch[i]->payload;
+      iov[1 + i].iov_len = batch[i]->len;
+    }
+
+    // A partially written frame is sent again from the start after
+    // reconnecting, as the consumer has lost the connection with it.
+    if (!writeAll(*fd, iov, 1 + n)) {
+      break;
+    }
+
+    fprintf(stderr, "Error (%s) writing to %s\n", strerror(errno), CLIENT_SOCK_FILE);
+    atomic_fetch_add_explicit(&stat_send_errors, 1, memory_order_relaxed);
+    close(*fd);
+    *fd = -1;
+  }
+
+  for (int i = 0; i < n; i++) {
+    RedisModule_Free(batch[i]);
+  }
+  atomic_fetch_add_explicit(&stat_sent, n, memory_order_relaxed);
+}
+
+static void waitForTasks(void) {
+  struct timespec ts;
+
+  pthread_mutex_lock(&idle_lock);
+  atomic_store_explicit(&worker_idle, 1, memory_order_release);
+
+  if (atomic_load(&queue_head) == atomic_load(&queue_tail) && !atomic_load(&spill_nonempty)) {
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += ASYNC_IDLE_MS * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&idle_cond, &idle_lock, &ts);
+  }
+
+  atomic_store_explicit(&worker_idle, 0, memory_order_release);
+  pthread_mutex_unlock(&idle_lock);
+}
+
+static void *asyncTaskWorker(void *arg) {
+  struct asyncTask *batch[ASYNC_BATCH_SIZE];
+  int fd = -1;
+
+  (void)arg;
+
+  for (;;) {
+    struct asyncTask *task;
+    struct asyncTask *spilled;
+    int n = 0;
+
+    while (n < ASYNC_BATCH_SIZE && (task = queuePop())) {
+      batch[n++] = task;
+    }
+
+    // The queue is drained before the spill list as it holds the older tasks
+    if (n == 0 && (spilled = spillTake())) {
+      while (spilled) {
+        batch[n++] = spilled;
+        spilled = spilled->next;
+        atomic_fetch_sub(&stat_spill_depth, 1);
+
+        if (n == ASYNC_BATCH_SIZE || !spilled) {
+          sendBatch(&fd, batch, n);
+          n = 0;
+        }
+      }
+      continue;
+    }
+
+    if (n > 0) {
+      sendBatch(&fd, batch, n);
+    } else {
+      waitForTasks();
+    }
+  }
+
+  return NULL;
+}
+
+static int parseOverflowPolicy(const char *str, enum SelvaModify_AsyncOverflow *policy) {
+  if (!strcasecmp(str, "drop-oldest")) {
+    *policy = SELVA_MODIFY_ASYNC_OVERFLOW_DROP_OLDEST;
+  } else if (!strcasecmp(str, "spill")) {
+    *policy = SELVA_MODIFY_ASYNC_OVERFLOW_SPILL;
+  } else {
+    return -1;
+  }
+
+  return 0;
+}
+
+// SELVA.ASYNC.STATS
+// Replies with name, value pairs of the async task queue counters.
+int SelvaCommand_AsyncStats(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  struct SelvaModify_AsyncTaskStats stats;
+
+  if (argc != 1) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  SelvaModify_GetAsyncTaskStats(&stats);
+
+  RedisModule_ReplyWithArray(ctx, 14);
+  RedisModule_ReplyWithSimpleString(ctx, "depth");
+  RedisModule_ReplyWithLongLong(ctx, stats.depth);
+  RedisModule_ReplyWithSimpleString(ctx, "spill_depth");
+  RedisModule_ReplyWithLongLong(ctx, stats.spill_depth);
+  RedisModule_ReplyWithSimpleString(ctx, "enqueued");
+  RedisModule_ReplyWithLongLong(ctx, stats.enqueued);
+  RedisModule_ReplyWithSimpleString(ctx, "sent");
+  RedisModule_ReplyWithLongLong(ctx, stats.sent);
+  RedisModule_ReplyWithSimpleString(ctx, "dropped");
+  RedisModule_ReplyWithLongLong(ctx, stats.dropped);
+  RedisModule_ReplyWithSimpleString(ctx, "spilled");
+  RedisModule_ReplyWithLongLong(ctx, stats.spilled);
+  RedisModule_ReplyWithSimpleString(ctx, "send_errors");
+  return RedisModule_ReplyWithLongLong(ctx, stats.send_errors);
+}
+
+int SelvaModify_AsyncTask_OnLoad(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  long long queue_size = ASYNC_QUEUE_DEFAULT_SIZE;
+  pthread_t thread;
+
+  for (int i = 0; i + 1 < argc; i += 2) {
+    const char *opt = RedisModule_StringPtrLen(argv[i], NULL);
+
+    if (!strcasecmp(opt, "ASYNC_QUEUE_SIZE")) {
+      if (RedisModule_StringToLongLong(argv[i + 1], &queue_size) == REDISMODULE_ERR ||
+          queue_size < 2 || queue_size > (1 << 24)) {
+        RedisModule_Log(ctx, "warning", "Invalid ASYNC_QUEUE_SIZE");
+        return REDISMODULE_ERR;
+      }
+    } else if (!strcasecmp(opt, "ASYNC_OVERFLOW")) {
+      if (parseOverflowPolicy(RedisModule_StringPtrLen(argv[i + 1], NULL), &overflow_policy)) {
+        RedisModule_Log(ctx, "warning", "Invalid ASYNC_OVERFLOW");
+        return REDISMODULE_ERR;
+      }
+    }
+  }
+
+  // The queue size must be a power of two for the index mask
+  size_t size = 2;
+  while (size < (size_t)queue_size) {
+    size <<= 1;
+  }
+
+  queue = RedisModule_Alloc(size * sizeof(struct queueSlot));
+  queue_mask = size - 1;
+  for (size_t i = 0; i < size; i++) {
+    atomic_init(&queue[i].seq, i);
+    queue[i].task = NULL;
+  }
+
+  if (pthread_create(&thread, NULL, asyncTaskWorker, NULL)) {
+    RedisModule_Log(ctx, "warning", "Failed to start the async task worker");
+    return REDISMODULE_ERR;
+  }
+  pthread_detach(thread);
+
+  if (RedisModule_CreateCommand(ctx, "selva.async.stats", SelvaCommand_AsyncStats, "readonly fast", 0, 0, 0) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  return REDISMODULE_OK;
+}
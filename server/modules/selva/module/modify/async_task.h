@@ -0,0 +1,143 @@
+#pragma once
+#ifndef SELVA_MODIFY_ASYNC_TASK
+#define SELVA_MODIFY_ASYNC_TASK
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Async tasks are sent to the consumer in frames. All integers are
+ * little-endian and nothing is padded, so a frame can be read in place.
+ *
+ * frame: u8 version, u8 reserved[3], u32 nr_tasks, u32 len, task[nr_tasks]
+ *        where len is the total size of the tasks
+ * task:  u8 type, u8 id_len, u16 field_len, u32 value_len, id, field, value
+ */
+#define SELVA_MODIFY_ASYNC_FRAME_VERSION 1
+#define SELVA_MODIFY_ASYNC_FRAME_HEADER_SIZE 12
+#define SELVA_MODIFY_ASYNC_TASK_HEADER_SIZE 8
+#define SELVA_MODIFY_ASYNC_TASK_MAX_ID_LEN UINT8_MAX
+#define SELVA_MODIFY_ASYNC_TASK_MAX_FIELD_LEN UINT16_MAX
+
+enum SelvaModify_AsyncTaskType {
+  // The field is a comma separated list of the fields changed on the node,
+  // published as "update:<fields>" on ___selva_events:<id>
+  SELVA_MODIFY_ASYNC_TASK_PUBLISH = 0,
+  SELVA_MODIFY_ASYNC_TASK_INDEX = 1,
+  // The field is a comma separated list of the fields of the deleted node,
+  // published as "delete:<fields>" on ___selva_events:<id>
+  SELVA_MODIFY_ASYNC_TASK_PUBLISH_DELETE = 2,
+};
+
+// A task in a received frame; the strings point into the frame
+struct SelvaModify_AsyncTask {
+  enum SelvaModify_AsyncTaskType type;
+  const char *id;
+  size_t id_len;
+  const char *field;
+  size_t field_len;
+  const char *value;
+  size_t value_len;
+};
+
+static inline void SelvaModify_PutLe16(char *buf, uint16_t v) {
+  buf[0] = (char)(v & 0xff);
+  buf[1] = (char)(v >> 8);
+}
+
+static inline void SelvaModify_PutLe32(char *buf, uint32_t v) {
+  for (int i = 0; i < 4; i++) {
+    buf[i] = (char)((v >> (8 * i)) & 0xff);
+  }
+}
+
+static inline uint32_t SelvaModify_GetLe(const char *buf, int size) {
+  uint32_t v = 0;
+
+  for (int i = 0; i < size; i++) {
+    v |= (uint32_t)(uint8_t)buf[i] << (8 * i);
+  }
+
+  return v;
+}
+
+static inline size_t SelvaModify_AsyncTaskSize(size_t id_len, size_t field_len, size_t value_len) {
+  return SELVA_MODIFY_ASYNC_TASK_HEADER_SIZE + id_len + field_len + value_len;
+}
+
+// Encode a task into buf, which must hold SelvaModify_AsyncTaskSize() bytes
+static inline void SelvaModify_EncodeAsyncTask(char *buf, enum SelvaModify_AsyncTaskType type,
+    const char *id, size_t id_len, const char *field, size_t field_len, const char *value, size_t value_len) {
+  buf[0] = (char)type;
+  buf[1] = (char)id_len;
+  SelvaModify_PutLe16(buf + 2, (uint16_t)field_len);
+  SelvaModify_PutLe32(buf + 4, (uint32_t)value_len);
+  buf += SELVA_MODIFY_ASYNC_TASK_HEADER_SIZE;
+
+  memcpy(buf, id, id_len);
+  memcpy(buf + id_len, field, field_len);
+  if (value_len > 0) {
+    memcpy(buf + id_len + field_len, value, value_len);
+  }
+}
+
+// Parse the task at *pos of the tasks of a frame and advance pos past it.
+// Returns -1 if the task is truncated.
+static inline int SelvaModify_ParseAsyncTask(const char *tasks, size_t len, size_t *pos, struct SelvaModify_AsyncTask *task) {
+  const char *p = tasks + *pos;
+  size_t size;
+
+  if (len - *pos < SELVA_MODIFY_ASYNC_TASK_HEADER_SIZE) {
+    return -1;
+  }
+
+  task->type = (enum SelvaModify_AsyncTaskType)(uint8_t)p[0];
+  task->id_len = (uint8_t)p[1];
+  task->field_len = SelvaModify_GetLe(p + 2, 2);
+  task->value_len = SelvaModify_GetLe(p + 4, 4);
+
+  size = SelvaModify_AsyncTaskSize(task->id_len, task->field_len, task->value_len);
+  if (len - *pos < size) {
+    return -1;
+  }
+
+  task->id = p + SELVA_MODIFY_ASYNC_TASK_HEADER_SIZE;
+  task->field = task->id + task->id_len;
+  task->value = task->field + task->field_len;
+  *pos += size;
+
+  return 0;
+}
+
+// What to do when the async task queue is full
+enum SelvaModify_AsyncOverflow {
+  // Drop the oldest queued task; counted in the dropped stat
+  SELVA_MODIFY_ASYNC_OVERFLOW_DROP_OLDEST = 0,
+  // Keep the task in an unbounded overflow list
+  SELVA_MODIFY_ASYNC_OVERFLOW_SPILL = 1,
+};
+
+struct SelvaModify_AsyncTaskStats {
+  uint64_t depth;
+  uint64_t spill_depth;
+  uint64_t enqueued;
+  uint64_t sent;
+  uint64_t dropped;
+  uint64_t spilled;
+  uint64_t send_errors;
+};
+
+// Allocate a task buffer of len bytes to be encoded in place and passed to SelvaModify_SendAsyncTask()
+char *SelvaModify_NewAsyncTask(size_t len);
+
+// Queue a task for the worker thread, which takes the ownership of it
+void SelvaModify_SendAsyncTask(char *payload);
+
+void SelvaModify_GetAsyncTaskStats(struct SelvaModify_AsyncTaskStats *stats);
+
+// Module arguments: ASYNC_QUEUE_SIZE n, ASYNC_OVERFLOW drop-oldest|spill
+// The push never waits for the worker, a missing consumer can't stall Redis.
+int SelvaModify_AsyncTask_OnLoad(RedisModuleCtx *ctx, RedisModuleString **argv, int argc);
+
+#endif /* SELVA_MODIFY_ASYNC_TASK */
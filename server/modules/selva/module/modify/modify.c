@@ -1,106 +1,835 @@
-#include <stdio.h>
-#include <stdlib.h>
+#include <math.h>
 #include <stdint.h>
-#include <unistd.h>
-#include <errno.h>
-#include <sys/un.h>
-#include <sys/socket.h>
 #include <string.h>
 
+#include "../../redismodule.h"
+#include "../hierarchy/hierarchy.h"
+#include "../alias/alias.h"
+#include "../numindex/numindex.h"
+#include "../schema/schema.h"
+#include "../suggestion/suggestion.h"
+#include "./async_task.h"
 #include "./modify.h"
 
-#define CLIENT_SOCK_FILE "/tmp/selva.sock"
+static void sendTask(enum SelvaModify_AsyncTaskType type, const char *id_str, size_t id_len, const char *field_str, size_t field_len, const char *value_str, size_t value_len) {
+  if (id_len > SELVA_MODIFY_ASYNC_TASK_MAX_ID_LEN || field_len > SELVA_MODIFY_ASYNC_TASK_MAX_FIELD_LEN || value_len > UINT32_MAX) {
+    return;
+  }
+
+  char *task = SelvaModify_NewAsyncTask(SelvaModify_AsyncTaskSize(id_len, field_len, value_len));
+  SelvaModify_EncodeAsyncTask(task, type, id_str, id_len, field_str, field_len, value_str, value_len);
+  SelvaModify_SendAsyncTask(task);
+}
+
+// The fields changed on a node during the current command
+struct pendingUpdate {
+  size_t len;
+  size_t cap;
+  char fields[];
+};
+
+// id -> struct pendingUpdate
+static RedisModuleDict *pending_updates;
 
-extern int errno;
+static int hasField(const struct pendingUpdate *update, const char *field_str, size_t field_len) {
+  const char *p = update->fields;
+  const char *end = update->fields + update->len;
 
-int fd = -1;
-struct sockaddr_un addr;
+  while (p < end) {
+    const char *sep = memchr(p, ',', end - p);
+    const size_t len = (sep ? sep : end) - p;
 
-int SelvaModify_SendAsyncTask(int payload_len, char *payload, uint8_t retries) {
-  if (fd == -1) {
-    fd = socket(PF_UNIX, SOCK_STREAM, 0);
-    if (fd < 0) {
-      fprintf(stderr, "Unable to open file descriptor for %s\n", CLIENT_SOCK_FILE);
-      fd = -1;
-      goto error;
+    if (len == field_len && !memcmp(p, field_str, len)) {
+      return 1;
     }
+    p += len + 1;
+  }
+
+  return 0;
+}
 
-    memset(&addr, 0, sizeof(addr));
-    addr.sun_family = AF_UNIX;
-    strncpy(addr.sun_path, CLIENT_SOCK_FILE, sizeof(addr.sun_path)-1);
+void SelvaModify_PublishUpdate(const char *id_str, size_t id_len, const char *field_str, size_t field_len) {
+  struct pendingUpdate *update;
+
+  if (!pending_updates) {
+    pending_updates = RedisModule_CreateDict(NULL);
+  }
+
+  update = RedisModule_DictGetC(pending_updates, (void *)id_str, id_len, NULL);
+  if (update && hasField(update, field_str, field_len)) {
+    return;
+  }
+
+  const size_t len = (update && update->len > 0 ? update->len + 1 : 0) + field_len;
+
+  if (len > SELVA_MODIFY_ASYNC_TASK_MAX_FIELD_LEN) {
+    // Send what we have so far and start a new list
+    if (update && update->len > 0) {
+      sendTask(SELVA_MODIFY_ASYNC_TASK_PUBLISH, id_str, id_len, update->fields, update->len, NULL, 0);
+      update->len = 0;
+    }
+    if (field_len > SELVA_MODIFY_ASYNC_TASK_MAX_FIELD_LEN) {
+      return;
+    }
+  }
 
+  if (!update || update->cap < update->len + 1 + field_len) {
+    const size_t cap = 2 * (update ? update->cap : 0) + field_len + 1;
+    struct pendingUpdate *tmp = RedisModule_Realloc(update, sizeof(struct pendingUpdate) + cap);
 
-    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
-      fprintf(stderr, "Error (%s) connecting to %s\n", strerror(errno), addr.sun_path);
-      goto error;
+    if (!update) {
+      tmp->len = 0;
     }
+    tmp->cap = cap;
+    update = tmp;
+    RedisModule_DictReplaceC(pending_updates, (void *)id_str, id_len, update);
+  }
+
+  if (update->len > 0) {
+    update->fields[update->len++] = ',';
   }
+  memcpy(update->fields + update->len, field_str, field_len);
+  update->len += field_len;
+}
+
+void SelvaModify_PublishDelete(const char *id_str, size_t id_len, const char *fields_str, size_t fields_len) {
+  struct pendingUpdate *update;
 
-  if (write(fd, payload, payload_len) != payload_len) {
-    fprintf(stderr, "Error (%s) writing to socket\n", strerror(errno));
-    goto error;
+  // The node is gone so its pending updates are superseded
+  if (pending_updates && RedisModule_DictDelC(pending_updates, (void *)id_str, id_len, &update) == REDISMODULE_OK) {
+    RedisModule_Free(update);
   }
 
+  if (fields_len > SELVA_MODIFY_ASYNC_TASK_MAX_FIELD_LEN) {
+    fields_len = 0;
+  }
+  sendTask(SELVA_MODIFY_ASYNC_TASK_PUBLISH_DELETE, id_str, id_len, fields_str, fields_len, NULL, 0);
+}
+
+void SelvaModify_FlushUpdates(void) {
+  RedisModuleDictIter *it;
+  char *id_str;
+  size_t id_len;
+  struct pendingUpdate *update;
+
+  if (!pending_updates) {
+    return;
+  }
+
+  it = RedisModule_DictIteratorStartC(pending_updates, "^", NULL, 0);
+  while ((id_str = RedisModule_DictNextC(it, &id_len, (void **)&update))) {
+    if (update->len > 0) {
+      sendTask(SELVA_MODIFY_ASYNC_TASK_PUBLISH, id_str, id_len, update->fields, update->len, NULL, 0);
+    }
+    RedisModule_Free(update);
+  }
+  RedisModule_DictIteratorStop(it);
+
+  RedisModule_FreeDict(NULL, pending_updates);
+  pending_updates = NULL;
+}
+
+void SelvaModify_PublishIndex(const char *id_str, size_t id_len, const char *field_str, size_t field_len, const char *value_str, size_t value_len) {
+  sendTask(SELVA_MODIFY_ASYNC_TASK_INDEX, id_str, id_len, field_str, field_len, value_str, value_len);
+}
+
+// id -> (field -> RedisModuleString *value)
+static RedisModuleDict *pending_index;
+
+int SelvaModify_IndexField(RedisModuleCtx *ctx, RedisModuleKey *id_key, const char *id_str, size_t id_len, RedisModuleString *field, RedisModuleString *value) {
+  const struct SelvaSchema *schema = SelvaSchema_Get();
+  size_t field_len;
+  const char *field_str = RedisModule_StringPtrLen(field, &field_len);
+  unsigned int flags;
+  RedisModuleDict *fields;
+
+  if (!schema || !(flags = SelvaSchema_GetFieldSearchFlags(schema, field_str, field_len) & ~SELVA_SCHEMA_SEARCH_TEXT)) {
+    return 0;
+  }
+
+  if (flags & SELVA_SCHEMA_SEARCH_NUMERIC) {
+    SelvaNumIndex_Update(id_str, id_len, field_str, field_len, value);
+  }
+
+  if (flags & SELVA_SCHEMA_SEARCH_EXISTS) {
+    RedisModule_HashSet(id_key, REDISMODULE_HASH_NONE,
+        RedisModule_CreateStringPrintf(ctx, "_exists_%.*s", (int)field_len, field_str), RedisModule_CreateString(ctx, "T", 1), NULL);
+  }
+
+  if (!pending_index) {
+    pending_index = RedisModule_CreateDict(NULL);
+  }
+
+  fields = RedisModule_DictGetC(pending_index, (void *)id_str, id_len, NULL);
+  if (!fields) {
+    fields = RedisModule_CreateDict(NULL);
+    RedisModule_DictSetC(pending_index, (void *)id_str, id_len, fields);
+  }
+  RedisModule_DictReplaceC(fields, (void *)field_str, field_len, value);
+
+  return 1;
+}
+
+static void addToIndex(RedisModuleCtx *ctx, const struct SelvaSchema_SearchIndex *index, RedisModuleString *id, RedisModuleDict *fields, RedisModuleString **args) {
+  RedisModuleDictIter *it;
+  char *field_str;
+  size_t field_len;
+  RedisModuleString *value;
+  size_t n = 0;
+
+  args[n++] = RedisModule_CreateString(ctx, index->name, strlen(index->name));
+  args[n++] = id;
+  args[n++] = RedisModule_CreateString(ctx, "1", 1);
+  args[n++] = RedisModule_CreateString(ctx, "NOSAVE", 6);
+  args[n++] = RedisModule_CreateString(ctx, "REPLACE", 7);
+  args[n++] = RedisModule_CreateString(ctx, "PARTIAL", 7);
+  args[n++] = RedisModule_CreateString(ctx, "FIELDS", 6);
+  const size_t nr_header = n;
+
+  it = RedisModule_DictIteratorStartC(fields, "^", NULL, 0);
+  while ((field_str = RedisModule_DictNextC(it, &field_len, (void **)&value))) {
+    const unsigned int flags = SelvaSchema_GetSearchFlags(index, field_str, field_len);
+
+    if (flags & SELVA_SCHEMA_SEARCH_VALUE) {
+      args[n++] = RedisModule_CreateString(ctx, field_str, field_len);
+      args[n++] = value;
+    }
+    if (flags & SELVA_SCHEMA_SEARCH_EXISTS) {
+      args[n++] = RedisModule_CreateStringPrintf(ctx, "_exists_%.*s", (int)field_len, field_str);
+      args[n++] = RedisModule_CreateString(ctx, "T", 1);
+    }
+  }
+  RedisModule_DictIteratorStop(it);
+
+  if (n > nr_header) {
+    // Indexing errors are ignored like in the Lua modify
+    RedisModuleCallReply *reply = RedisModule_Call(ctx, "FT.ADD", "v", args, n);
+
+    if (reply) {
+      RedisModule_FreeCallReply(reply);
+    }
+  }
+}
+
+void SelvaModify_FlushIndex(RedisModuleCtx *ctx) {
+  const struct SelvaSchema *schema = SelvaSchema_Get();
+  RedisModuleDictIter *it;
+  char *id_str;
+  size_t id_len;
+  RedisModuleDict *fields;
+
+  if (!pending_index) {
+    return;
+  }
+
+  it = RedisModule_DictIteratorStartC(pending_index, "^", NULL, 0);
+  while ((id_str = RedisModule_DictNextC(it, &id_len, (void **)&fields))) {
+    if (schema) {
+      RedisModuleString *id = RedisModule_CreateString(ctx, id_str, id_len);
+      RedisModuleString **args = RedisModule_Alloc((7 + 4 * RedisModule_DictSize(fields)) * sizeof(RedisModuleString *));
+
+      for (size_t i = 0; i < schema->nr_search_indexes; i++) {
+        addToIndex(ctx, &schema->search_indexes[i], id, fields, args);
+      }
+      RedisModule_Free(args);
+    }
+    RedisModule_FreeDict(NULL, fields);
+  }
+  RedisModule_DictIteratorStop(it);
+
+  RedisModule_FreeDict(NULL, pending_index);
+  pending_index = NULL;
+}
+
+static void publishUpdate(RedisModuleString *id, const char *field_str, size_t field_len) {
+  size_t id_len;
+  const char *id_str = RedisModule_StringPtrLen(id, &id_len);
+
+  SelvaModify_PublishUpdate(id_str, id_len, field_str, field_len);
+}
+
+static uint64_t loadLe(const char *buf, int size) {
+  uint64_t v = 0;
+
+  for (int i = 0; i < size; i++) {
+    v |= (uint64_t)(uint8_t)buf[i] << (8 * i);
+  }
+
+  return v;
+}
+
+// Resolve the offset and length at pos of the set op header into a list
+static int parseOpSetList(const char *str, size_t size, size_t pos, const char **list, size_t *len) {
+  const size_t offset = loadLe(str + pos, 4);
+
+  *len = loadLe(str + pos + 4, 4);
+  if (offset == 0) {
+    *list = NULL;
+    return *len == 0 ? 0 : -1;
+  }
+
+  if (offset < SELVA_MODIFY_OP_SET_HEADER_SIZE || offset > size || *len > size - offset) {
+    return -1;
+  }
+
+  *list = str + offset;
   return 0;
+}
+
+struct SelvaModify_OpSet *SelvaModify_ParseOpSet(RedisModuleCtx *ctx, RedisModuleString *data) {
+  size_t size;
+  const char *str = RedisModule_StringPtrLen(data, &size);
+  struct SelvaModify_OpSet *op;
+
+  if (size < SELVA_MODIFY_OP_SET_HEADER_SIZE) {
+    return NULL;
+  }
+
+  op = RedisModule_PoolAlloc(ctx, sizeof(*op));
+  op->is_reference = str[0] != 0;
+  op->no_root = str[1] != 0;
+
+  if (parseOpSetList(str, size, 2, &op->$add, &op->$add_len) ||
+      parseOpSetList(str, size, 10, &op->$delete, &op->$delete_len) ||
+      parseOpSetList(str, size, 18, &op->$value, &op->$value_len)) {
+    return NULL;
+  }
+
+  return op;
+}
+
+int SelvaModify_ValidateIncrement(RedisModuleKey *id_key, RedisModuleString *field, RedisModuleString *value, int is_double) {
+  RedisModuleString *current = NULL;
+  long long ll;
+  double d;
+  size_t value_len;
+
+  RedisModule_StringPtrLen(value, &value_len);
+  if (value_len != SELVA_MODIFY_OP_INCREMENT_SIZE) {
+    return 0;
+  }
+
+  RedisModule_HashGet(id_key, REDISMODULE_HASH_NONE, field, &current, NULL);
+  if (!current) {
+    return 1;
+  }
+
+  return is_double ? RedisModule_StringToDouble(current, &d) == REDISMODULE_OK : RedisModule_StringToLongLong(current, &ll) == REDISMODULE_OK;
+}
+
+static void setIncremented(RedisModuleCtx *ctx, RedisModuleKey *id_key, RedisModuleString *id, RedisModuleString *field, RedisModuleString *new_value) {
+  size_t id_len;
+  const char *id_str = RedisModule_StringPtrLen(id, &id_len);
+  size_t field_len;
+  const char *field_str = RedisModule_StringPtrLen(field, &field_len);
 
-error:
-  if (fd > 0) {
-    close(fd);
+  RedisModule_HashSet(id_key, REDISMODULE_HASH_NONE, field, new_value, NULL);
+  SelvaModify_IndexField(ctx, id_key, id_str, id_len, field, new_value);
+  publishUpdate(id, field_str, field_len);
+}
+
+int SelvaModify_ModifyIncrement(RedisModuleCtx *ctx, RedisModuleKey *id_key, RedisModuleString *id, RedisModuleString *field, RedisModuleString *value) {
+  struct SelvaModify_OpIncrement op;
+  RedisModuleString *current = NULL;
+  long long num;
+  size_t value_len;
+  const char *value_str = RedisModule_StringPtrLen(value, &value_len);
+
+  if (value_len != SELVA_MODIFY_OP_INCREMENT_SIZE) {
+    return -1;
+  }
+  op.$default = (int64_t)loadLe(value_str, 8);
+  op.$increment = (int64_t)loadLe(value_str + 8, 8);
+
+  RedisModule_HashGet(id_key, REDISMODULE_HASH_NONE, field, &current, NULL);
+  if (!current) {
+    num = op.$default;
+  } else if (RedisModule_StringToLongLong(current, &num) == REDISMODULE_ERR) {
+    return -1;
+  } else {
+    num += op.$increment;
   }
 
-  fd = -1;
+  setIncremented(ctx, id_key, id, field, RedisModule_CreateStringFromLongLong(ctx, num));
 
-  if (retries <= 0) {
-    fprintf(stderr, "Retries exceeded\n");
-    exit(1);
+  return 1;
+}
+
+int SelvaModify_ModifyIncrementDouble(RedisModuleCtx *ctx, RedisModuleKey *id_key, RedisModuleString *id, RedisModuleString *field, RedisModuleString *value) {
+  struct SelvaModify_OpIncrementDouble op;
+  RedisModuleString *current = NULL;
+  uint64_t bits;
+  double num;
+  size_t value_len;
+  const char *value_str = RedisModule_StringPtrLen(value, &value_len);
+
+  if (value_len != SELVA_MODIFY_OP_INCREMENT_SIZE) {
+    return -1;
   }
+  bits = loadLe(value_str, 8);
+  memcpy(&op.$default, &bits, sizeof(double));
+  bits = loadLe(value_str + 8, 8);
+  memcpy(&op.$increment, &bits, sizeof(double));
 
-  return SelvaModify_SendAsyncTask(payload_len, payload, --retries);
+  RedisModule_HashGet(id_key, REDISMODULE_HASH_NONE, field, &current, NULL);
+  if (!current) {
+    num = op.$default;
+  } else if (RedisModule_StringToDouble(current, &num) == REDISMODULE_ERR) {
+    return -1;
+  } else {
+    num += op.$increment;
+  }
+
+  if (isnan(num) || isinf(num)) {
+    return -1;
+  }
+
+  setIncremented(ctx, id_key, id, field, RedisModule_CreateStringPrintf(ctx, "%.17g", num));
+
+  return 1;
 }
 
-void SelvaModify_PreparePublishPayload(char *payload_str, const char *id_str, size_t id_len, const char *field_str, size_t field_len) {
-  size_t struct_len = sizeof(struct SelvaModify_AsyncTask);
+enum referenceField {
+  REFERENCE_NONE,
+  REFERENCE_PARENTS,
+  REFERENCE_CHILDREN,
+  // Not a reference but kept in sync with the alias index
+  REFERENCE_ALIASES,
+};
 
-  struct SelvaModify_AsyncTask publish_task;
-  publish_task.type = SELVA_MODIFY_ASYNC_TASK_PUBLISH;
-  memcpy(publish_task.id, id_str, 10);
-  publish_task.field_name = (const char *)struct_len;
-  publish_task.field_name_len = field_len;
-  publish_task.value = NULL;
-  publish_task.value_len = 0;
+static enum referenceField getReferenceField(const char *field_str, size_t field_len, int is_reference) {
+  if (field_len == sizeof("aliases") - 1 && !memcmp(field_str, "aliases", field_len)) {
+    return REFERENCE_ALIASES;
+  } else if (!is_reference) {
+    return REFERENCE_NONE;
+  } else if (field_len == sizeof("parents") - 1 && !memcmp(field_str, "parents", field_len)) {
+    return REFERENCE_PARENTS;
+  } else if (field_len == sizeof("children") - 1 && !memcmp(field_str, "children", field_len)) {
+    return REFERENCE_CHILDREN;
+  }
+
+  return REFERENCE_NONE;
+}
 
-  char *ptr = payload_str;
+static RedisModuleString *getSetKey(RedisModuleCtx *ctx, RedisModuleString *id, const char *field_str, size_t field_len) {
+  size_t id_len;
+  const char *id_str = RedisModule_StringPtrLen(id, &id_len);
 
-  int32_t total_len = struct_len + field_len;
-  memcpy(ptr, &total_len, sizeof(int32_t));
-  ptr += sizeof(int32_t);
+  return RedisModule_CreateStringPrintf(ctx, "%.*s.%.*s", (int)id_len, id_str, (int)field_len, field_str);
+}
 
-  memcpy(ptr, &publish_task, struct_len);
-  ptr += struct_len;
+static long long setAddOrRem(RedisModuleCtx *ctx, const char *cmd, RedisModuleString *set_key, RedisModuleString *member) {
+  RedisModuleCallReply *reply = RedisModule_Call(ctx, cmd, "ss", set_key, member);
 
-  memcpy(ptr, field_str, field_len);
+  return reply ? RedisModule_CallReplyInteger(reply) : 0;
 }
 
-void SelvaModify_PrepareValueIndexPayload(char *payload_str, const char *id_str, size_t id_len, const char *field_str, size_t field_len, const char *value_str, size_t value_len) {
-  size_t struct_len = sizeof(struct SelvaModify_AsyncTask);
-  struct SelvaModify_AsyncTask publish_task;
-  publish_task.type = SELVA_MODIFY_ASYNC_TASK_INDEX;
-  memcpy(publish_task.id, id_str, 10);
-  publish_task.field_name = (const char *)struct_len;
-  publish_task.field_name_len = field_len;
-  publish_task.value = (const char *)struct_len + field_len;
-  publish_task.value_len = value_len;
+// Split a NUL separated member list into strings
+static RedisModuleString **splitMembers(RedisModuleCtx *ctx, const char *list, size_t len, size_t *nr) {
+  RedisModuleString **members;
+  size_t n = 0;
 
-  char *ptr = payload_str;
+  for (size_t i = 0; i < len; i++) {
+    n += list[i] == '\0';
+  }
+  members = RedisModule_PoolAlloc(ctx, (n + 1) * sizeof(RedisModuleString *));
+
+  n = 0;
+  for (size_t i = 0; i < len;) {
+    const char *end = memchr(list + i, '\0', len - i);
+    const size_t member_len = (end ? (size_t)(end - list) : len) - i;
+
+    if (member_len > 0) {
+      members[n++] = RedisModule_CreateString(ctx, list + i, member_len);
+    }
+    i += member_len + 1;
+  }
+
+  *nr = n;
+  return members;
+}
+
+static RedisModuleString **getMembers(RedisModuleCtx *ctx, RedisModuleString *set_key, size_t *nr) {
+  RedisModuleCallReply *reply = RedisModule_Call(ctx, "SMEMBERS", "s", set_key);
+  RedisModuleString **members;
+  size_t n;
 
-  int32_t total_len = struct_len + field_len + value_len;
-  memcpy(ptr, &total_len, sizeof(int32_t));
-  ptr += sizeof(int32_t);
+  if (!reply || RedisModule_CallReplyType(reply) != REDISMODULE_REPLY_ARRAY) {
+    *nr = 0;
+    return NULL;
+  }
+
+  n = RedisModule_CallReplyLength(reply);
+  members = RedisModule_PoolAlloc(ctx, (n + 1) * sizeof(RedisModuleString *));
+  for (size_t i = 0; i < n; i++) {
+    members[i] = RedisModule_CreateStringFromCallReply(RedisModule_CallReplyArrayElement(reply, i));
+  }
+
+  *nr = n;
+  return members;
+}
+
+// Add id and member to each other's parents and children sets, and the edge to the hierarchy
+static int addReference(RedisModuleCtx *ctx, SelvaModify_Hierarchy *hierarchy, enum referenceField ref, RedisModuleString *id, RedisModuleString *member, int no_root) {
+  RedisModuleString *parent = ref == REFERENCE_PARENTS ? member : id;
+  RedisModuleString *child = ref == REFERENCE_PARENTS ? id : member;
+  Selva_NodeId parent_id, child_id;
+
+  if (SelvaModify_ParseNodeId(parent_id, parent) == REDISMODULE_ERR ||
+      SelvaModify_ParseNodeId(child_id, child) == REDISMODULE_ERR) {
+    return -1;
+  }
 
-  memcpy(ptr, &publish_task, struct_len);
-  ptr += struct_len;
+  if (!setAddOrRem(ctx, "SADD", getSetKey(ctx, child, "parents", 7), parent)) {
+    return 0;
+  }
+  setAddOrRem(ctx, "SADD", getSetKey(ctx, parent, "children", 8), child);
+
+  // A new parent is created under root like any other new node
+  if (ref == REFERENCE_PARENTS && !no_root && memcmp(parent_id, ROOT_NODE_ID, SELVA_NODE_ID_SIZE) &&
+      !SelvaModify_HierarchyNodeExists(hierarchy, parent_id)) {
+    RedisModuleString *root = RedisModule_CreateString(ctx, "root", 4);
+
+    setAddOrRem(ctx, "SADD", getSetKey(ctx, parent, "parents", 7), root);
+    setAddOrRem(ctx, "SADD", getSetKey(ctx, root, "children", 8), parent);
+    SelvaModify_AddHierarchy(hierarchy, parent_id, 1, (const Selva_NodeId *)ROOT_NODE_ID);
+  }
+
+  SelvaModify_AddHierarchy(hierarchy, child_id, 1, (const Selva_NodeId *)&parent_id);
+
+  if (ref == REFERENCE_PARENTS) {
+    publishUpdate(parent, "children", 8);
+  } else {
+    publishUpdate(child, "parents", 7);
+  }
+
+  return 1;
+}
+
+static int removeReference(RedisModuleCtx *ctx, SelvaModify_Hierarchy *hierarchy, enum referenceField ref, RedisModuleString *id, RedisModuleString *member) {
+  RedisModuleString *parent = ref == REFERENCE_PARENTS ? member : id;
+  RedisModuleString *child = ref == REFERENCE_PARENTS ? id : member;
+  Selva_NodeId parent_id, child_id;
+
+  if (SelvaModify_ParseNodeId(parent_id, parent) == REDISMODULE_ERR ||
+      SelvaModify_ParseNodeId(child_id, child) == REDISMODULE_ERR) {
+    return -1;
+  }
+
+  if (!setAddOrRem(ctx, "SREM", getSetKey(ctx, child, "parents", 7), parent)) {
+    return 0;
+  }
+  setAddOrRem(ctx, "SREM", getSetKey(ctx, parent, "children", 8), child);
+  SelvaModify_DelHierarchy(hierarchy, child_id, 1, (const Selva_NodeId *)&parent_id);
+
+  if (ref == REFERENCE_PARENTS) {
+    publishUpdate(parent, "children", 8);
+  } else {
+    publishUpdate(child, "parents", 7);
+  }
+
+  return 1;
+}
+
+static int addAlias(RedisModuleCtx *ctx, RedisModuleString *id, RedisModuleString *alias) {
+  RedisModuleKey *index = SelvaAlias_OpenIndex(ctx);
+  RedisModuleString *prev;
+  int res;
+
+  if (!index) {
+    return -1;
+  }
+
+  res = SelvaAlias_Set(ctx, index, id, alias, 0, &prev);
+  RedisModule_CloseKey(index);
+
+  return res;
+}
+
+static int removeAlias(RedisModuleCtx *ctx, RedisModuleString *id, RedisModuleString *set_key, RedisModuleString *alias) {
+  RedisModuleKey *index = SelvaAlias_OpenIndex(ctx);
+  int res;
+
+  if (!index) {
+    return -1;
+  }
+
+  res = SelvaAlias_Del(ctx, index, alias, id);
+  RedisModule_CloseKey(index);
+
+  // The alias may have been taken over by another node already
+  return res || setAddOrRem(ctx, "SREM", set_key, alias) > 0;
+}
+
+static int addMember(RedisModuleCtx *ctx, SelvaModify_Hierarchy *hierarchy, enum referenceField ref, RedisModuleString *id, RedisModuleString *set_key, RedisModuleString *member, int no_root) {
+  if (ref == REFERENCE_ALIASES) {
+    return addAlias(ctx, id, member);
+  } else if (ref != REFERENCE_NONE) {
+    return addReference(ctx, hierarchy, ref, id, member, no_root);
+  }
+
+  return setAddOrRem(ctx, "SADD", set_key, member) > 0;
+}
+
+static int removeMember(RedisModuleCtx *ctx, SelvaModify_Hierarchy *hierarchy, enum referenceField ref, RedisModuleString *id, RedisModuleString *set_key, RedisModuleString *member) {
+  if (ref == REFERENCE_ALIASES) {
+    return removeAlias(ctx, id, set_key, member);
+  } else if (ref != REFERENCE_NONE) {
+    return removeReference(ctx, hierarchy, ref, id, member);
+  }
+
+  return setAddOrRem(ctx, "SREM", set_key, member) > 0;
+}
+
+void SelvaModify_DiffSet(RedisModuleCtx *ctx, RedisModuleString *set_key, RedisModuleString **value, size_t nr_value, struct SelvaModify_SetDiff *diff) {
+  RedisModuleDict *next = RedisModule_CreateDict(ctx);
+  RedisModuleDict *prev = RedisModule_CreateDict(ctx);
+  RedisModuleString **current;
+  size_t nr_current;
+
+  current = getMembers(ctx, set_key, &nr_current);
+  diff->added = RedisModule_PoolAlloc(ctx, (nr_value + 1) * sizeof(RedisModuleString *));
+  diff->removed = RedisModule_PoolAlloc(ctx, (nr_current + 1) * sizeof(RedisModuleString *));
+  diff->nr_added = 0;
+  diff->nr_removed = 0;
+
+  for (size_t i = 0; i < nr_current; i++) {
+    RedisModule_DictSet(prev, current[i], NULL);
+  }
+
+  for (size_t i = 0; i < nr_value; i++) {
+    int nokey;
+
+    if (RedisModule_DictSet(next, value[i], NULL) == REDISMODULE_ERR) {
+      continue; // A duplicate
+    }
+
+    RedisModule_DictGet(prev, value[i], &nokey);
+    if (nokey) {
+      diff->added[diff->nr_added++] = value[i];
+    }
+  }
+
+  for (size_t i = 0; i < nr_current; i++) {
+    int nokey;
+
+    RedisModule_DictGet(next, current[i], &nokey);
+    if (nokey) {
+      diff->removed[diff->nr_removed++] = current[i];
+    }
+  }
+
+  RedisModule_FreeDict(ctx, prev);
+  RedisModule_FreeDict(ctx, next);
+}
+
+int SelvaModify_ResetSet(RedisModuleCtx *ctx, RedisModuleString *set_key, RedisModuleString **value, size_t nr_value, struct SelvaModify_SetDiff *diff) {
+  SelvaModify_DiffSet(ctx, set_key, value, nr_value, diff);
+
+  if (diff->nr_removed > 0) {
+    RedisModule_Call(ctx, "SREM", "sv", set_key, diff->removed, diff->nr_removed);
+  }
+  if (diff->nr_added > 0) {
+    RedisModule_Call(ctx, "SADD", "sv", set_key, diff->added, diff->nr_added);
+  }
+
+  return diff->nr_added > 0 || diff->nr_removed > 0;
+}
+
+// Replace the members of the set with value, touching only the members that differ
+static int resetSet(RedisModuleCtx *ctx, SelvaModify_Hierarchy *hierarchy, enum referenceField ref, RedisModuleString *id, RedisModuleString *set_key, RedisModuleString **value, size_t nr_value, int no_root) {
+  struct SelvaModify_SetDiff diff;
+  int changed = 0;
+
+  if (ref == REFERENCE_NONE) {
+    return SelvaModify_ResetSet(ctx, set_key, value, nr_value, &diff);
+  }
+
+  SelvaModify_DiffSet(ctx, set_key, value, nr_value, &diff);
+
+  for (size_t i = 0; i < diff.nr_removed && changed >= 0; i++) {
+    int res = removeMember(ctx, hierarchy, ref, id, set_key, diff.removed[i]);
+
+    changed = res < 0 ? res : changed | res;
+  }
+
+  for (size_t i = 0; i < diff.nr_added && changed >= 0; i++) {
+    int res = addMember(ctx, hierarchy, ref, id, set_key, diff.added[i], no_root);
+
+    changed = res < 0 ? res : changed | res;
+  }
+
+  return changed;
+}
+
+static int isNodeIdList(const char *list, size_t len) {
+  for (size_t i = 0; i < len;) {
+    const char *end = memchr(list + i, '\0', len - i);
+    const size_t member_len = (end ? (size_t)(end - list) : len) - i;
+
+    if (member_len > SELVA_NODE_ID_SIZE) {
+      return 0;
+    }
+    i += member_len + 1;
+  }
+
+  return 1;
+}
+
+int SelvaModify_ValidateOpSet(RedisModuleString *id, RedisModuleString *field, const struct SelvaModify_OpSet *setOpts) {
+  size_t field_len;
+  const char *field_str = RedisModule_StringPtrLen(field, &field_len);
+  const enum referenceField ref = getReferenceField(field_str, field_len, setOpts->is_reference);
+  Selva_NodeId node_id;
+
+  if (ref != REFERENCE_PARENTS && ref != REFERENCE_CHILDREN) {
+    return 1;
+  }
+
+  return SelvaModify_ParseNodeId(node_id, id) == REDISMODULE_OK &&
+    isNodeIdList(setOpts->$add, setOpts->$add_len) &&
+    isNodeIdList(setOpts->$delete, setOpts->$delete_len) &&
+    isNodeIdList(setOpts->$value, setOpts->$value_len);
+}
+
+int SelvaModify_ModifySet(RedisModuleCtx *ctx, SelvaModify_Hierarchy *hierarchy, RedisModuleString *id, RedisModuleString *field, const struct SelvaModify_OpSet *setOpts) {
+  size_t field_len;
+  const char *field_str = RedisModule_StringPtrLen(field, &field_len);
+  const enum referenceField ref = getReferenceField(field_str, field_len, setOpts->is_reference);
+  RedisModuleString *set_key = getSetKey(ctx, id, field_str, field_len);
+  RedisModuleString **members;
+  size_t nr_members;
+  int changed = 0;
+
+  if (setOpts->$value) {
+    members = splitMembers(ctx, setOpts->$value, setOpts->$value_len, &nr_members);
+    changed = resetSet(ctx, hierarchy, ref, id, set_key, members, nr_members, setOpts->no_root);
+  } else {
+    members = splitMembers(ctx, setOpts->$add, setOpts->$add_len, &nr_members);
+    for (size_t i = 0; i < nr_members && changed >= 0; i++) {
+      int res = addMember(ctx, hierarchy, ref, id, set_key, members[i], setOpts->no_root);
+
+      changed = res < 0 ? res : changed | res;
+    }
+
+    members = splitMembers(ctx, setOpts->$delete, setOpts->$delete_len, &nr_members);
+    for (size_t i = 0; i < nr_members && changed >= 0; i++) {
+      int res = removeMember(ctx, hierarchy, ref, id, set_key, members[i]);
+
+      changed = res < 0 ? res : changed | res;
+    }
+  }
+
+  if (changed > 0) {
+    publishUpdate(id, field_str, field_len);
+  }
+
+  return changed;
+}
+
+static int isObjectField(const char *key_str, size_t key_len, const char *field_str, size_t field_len) {
+  return key_len > field_len && key_str[field_len] == '.' && !memcmp(key_str, field_str, field_len);
+}
+
+// Delete a field of the node hash. Returns 1 if it existed.
+static int delField(RedisModuleKey *id_key, RedisModuleString *id, RedisModuleString *field) {
+  size_t id_len;
+  const char *id_str = RedisModule_StringPtrLen(id, &id_len);
+  size_t field_len;
+  const char *field_str = RedisModule_StringPtrLen(field, &field_len);
+
+  SelvaNumIndex_Update(id_str, id_len, field_str, field_len, NULL);
+  if (SelvaSuggestion_IsSugField(id_str, field_str, field_len)) {
+    RedisModuleString *current = NULL;
+
+    RedisModule_HashGet(id_key, REDISMODULE_HASH_NONE, field, &current, NULL);
+    if (current) {
+      SelvaSuggestion_Update(current, NULL);
+    }
+  }
+
+  return RedisModule_HashSet(id_key, REDISMODULE_HASH_NONE, field, REDISMODULE_HASH_DELETE, NULL) > 0;
+}
+
+// Delete every field of the object in field except the ones named in keep
+static int delObjectFields(RedisModuleCtx *ctx, RedisModuleKey *id_key, RedisModuleString *id, const char *field_str, size_t field_len, RedisModuleString **keep, int nr_keep) {
+  RedisModuleCallReply *reply = RedisModule_Call(ctx, "HKEYS", "s", id);
+  int changed = 0;
+
+  if (!reply || RedisModule_CallReplyType(reply) != REDISMODULE_REPLY_ARRAY) {
+    return 0;
+  }
+
+  for (size_t i = 0; i < RedisModule_CallReplyLength(reply); i++) {
+    size_t key_len;
+    const char *key_str = RedisModule_CallReplyStringPtr(RedisModule_CallReplyArrayElement(reply, i), &key_len);
+    int skip = 0;
+
+    if (!isObjectField(key_str, key_len, field_str, field_len)) {
+      continue;
+    }
+
+    for (int j = 0; j < nr_keep && !skip; j++) {
+      size_t keep_len;
+      const char *keep_str = RedisModule_StringPtrLen(keep[j], &keep_len);
+
+      skip = keep_len == key_len && !memcmp(keep_str, key_str, key_len);
+    }
+    if (skip) {
+      continue;
+    }
+
+    delField(id_key, id, RedisModule_CreateString(ctx, key_str, key_len));
+    publishUpdate(id, key_str, key_len);
+    changed = 1;
+  }
+
+  return changed;
+}
+
+int SelvaModify_ModifyDel(RedisModuleCtx *ctx, SelvaModify_Hierarchy *hierarchy, RedisModuleKey *id_key, RedisModuleString *id, RedisModuleString *field) {
+  size_t field_len;
+  const char *field_str = RedisModule_StringPtrLen(field, &field_len);
+  const enum referenceField ref = getReferenceField(field_str, field_len, 1);
+  RedisModuleString *set_key = getSetKey(ctx, id, field_str, field_len);
+  int changed = 0;
+
+  if (ref != REFERENCE_NONE) {
+    changed = resetSet(ctx, hierarchy, ref, id, set_key, NULL, 0, 1);
+    if (changed < 0) {
+      return changed;
+    }
+  } else {
+    RedisModuleKey *set = RedisModule_OpenKey(ctx, set_key, REDISMODULE_WRITE);
+
+    if (RedisModule_KeyType(set) != REDISMODULE_KEYTYPE_EMPTY) {
+      RedisModule_DeleteKey(set);
+      changed = 1;
+    }
+    RedisModule_CloseKey(set);
+  }
+
+  changed |= delField(id_key, id, field);
+  RedisModule_HashSet(id_key, REDISMODULE_HASH_NONE,
+      RedisModule_CreateStringPrintf(ctx, "$source_%.*s", (int)field_len, field_str), REDISMODULE_HASH_DELETE, NULL);
+
+  if (changed) {
+    publishUpdate(id, field_str, field_len);
+  }
+  changed |= delObjectFields(ctx, id_key, id, field_str, field_len, NULL, 0);
+
+  return changed;
+}
+
+int SelvaModify_ModifyNoMerge(RedisModuleCtx *ctx, RedisModuleKey *id_key, RedisModuleString *id, RedisModuleString *field, RedisModuleString **rest, int nr_rest) {
+  size_t field_len;
+  const char *field_str = RedisModule_StringPtrLen(field, &field_len);
+  RedisModuleString **keep = RedisModule_PoolAlloc(ctx, (nr_rest / 3 + 1) * sizeof(RedisModuleString *));
+  int nr_keep = 0;
+
+  for (int i = 1; i < nr_rest; i += 3) {
+    keep[nr_keep++] = rest[i];
+  }
 
-  memcpy(ptr, field_str, field_len);
-  ptr += field_len;
-  memcpy(ptr, value_str, value_len);
+  return delObjectFields(ctx, id_key, id, field_str, field_len, keep, nr_keep);
 }
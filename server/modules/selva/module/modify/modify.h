@@ -2,34 +2,107 @@
 #ifndef SELVA_MODIFY
 #define SELVA_MODIFY
 
+#include <stddef.h>
+#include <stdint.h>
+
 enum SelvaModify_ArgType {
   SELVA_MODIFY_ARG_VALUE = '0',
-  SELVA_MODIFY_ARG_INDEXED_VALUE = '1'
+  SELVA_MODIFY_ARG_INDEXED_VALUE = '1',
+  SELVA_MODIFY_ARG_DEFAULT = '2',
+  SELVA_MODIFY_ARG_OP_INCREMENT = '3',
+  SELVA_MODIFY_ARG_REFERENCE = '4',
+  SELVA_MODIFY_ARG_OP_SET = '5',
+  SELVA_MODIFY_ARG_OP_DEL = '6',
+  SELVA_MODIFY_ARG_OP_NO_MERGE = '7',
+  SELVA_MODIFY_ARG_OP_INCREMENT_DOUBLE = '8',
 };
 
-// struct SelvaModify_Basic {
-//   char *$default;
-//   char *$value;
-//   char *$ref;
-//   char *$increment;
-// };
+// The value of SELVA_MODIFY_ARG_OP_INCREMENT is 16 bytes: $default and
+// $increment as little-endian int64.
+// A missing field is set to $default, so without a $default the client sends $increment in it.
+#define SELVA_MODIFY_OP_INCREMENT_SIZE 16
+
+struct SelvaModify_OpIncrement {
+  int64_t $default;
+  int64_t $increment;
+};
 
-enum SelvaModify_AsyncTaskType {
-  SELVA_MODIFY_ASYNC_TASK_PUBLISH = 0,
-  SELVA_MODIFY_ASYNC_TASK_INDEX = 1
+// SELVA_MODIFY_ARG_OP_INCREMENT_DOUBLE is the same for float fields with
+// little-endian IEEE 754 doubles.
+struct SelvaModify_OpIncrementDouble {
+  double $default;
+  double $increment;
 };
 
-struct SelvaModify_AsyncTask {
-  enum SelvaModify_AsyncTaskType type;
-  char id[10];
-  const char *field_name;
-  size_t field_name_len;
-  const char *value;
-  size_t value_len;
+// The value of SELVA_MODIFY_ARG_OP_SET is a 26 byte header followed by the
+// member lists, all integers little-endian:
+//   0  uint8  is_reference
+//   1  uint8  no_root
+//   2  uint32 $add offset, uint32 $add length
+//   10 uint32 $delete offset, uint32 $delete length
+//   18 uint32 $value offset, uint32 $value length
+// Offsets are from the start of the value and 0 means the list is not
+// given. Each list is a sequence of NUL separated members.
+#define SELVA_MODIFY_OP_SET_HEADER_SIZE 26
+
+// A parsed SELVA_MODIFY_ARG_OP_SET, the lists point into the value
+struct SelvaModify_OpSet {
+  int is_reference;
+  int no_root;
+  const char *$add;
+  size_t $add_len;
+  const char *$delete;
+  size_t $delete_len;
+  const char *$value;
+  size_t $value_len;
 };
 
-int SelvaModify_SendAsyncTask(int payload_len, char *payload, uint8_t retries);
-void SelvaModify_PreparePublishPayload(char *payload_str, const char *id_str, size_t id_len, const char *field_str, size_t field_len);
-void SelvaModify_PrepareValueIndexPayload(char *payload_str, const char *id_str, size_t id_len, const char *field_str, size_t field_len, const char *value_str, size_t value_len);
+struct SelvaModify_Hierarchy;
+
+// Record a changed field. The fields changed on each node are published
+// together by SelvaModify_FlushUpdates() at the end of the command.
+void SelvaModify_PublishUpdate(const char *id_str, size_t id_len, const char *field_str, size_t field_len);
+void SelvaModify_FlushUpdates(void);
+
+// Publish the deletion of a node immediately, dropping its pending updates
+void SelvaModify_PublishDelete(const char *id_str, size_t id_len, const char *fields_str, size_t fields_len);
+void SelvaModify_PublishIndex(const char *id_str, size_t id_len, const char *field_str, size_t field_len, const char *value_str, size_t value_len);
+
+// Queue a written field for the search indexes that cover it and set its _exists_ marker.
+// Returns 0 if no index covers the field natively, e.g. text fields indexed per language.
+// The value must stay valid until SelvaModify_FlushIndex(), which sends one FT.ADD per node and index.
+int SelvaModify_IndexField(RedisModuleCtx *ctx, RedisModuleKey *id_key, const char *id_str, size_t id_len, RedisModuleString *field, RedisModuleString *value);
+void SelvaModify_FlushIndex(RedisModuleCtx *ctx);
+
+// The members to add to and remove from a set to make it equal to a new value
+struct SelvaModify_SetDiff {
+  RedisModuleString **added;
+  size_t nr_added;
+  RedisModuleString **removed;
+  size_t nr_removed;
+};
+
+// Diff the set stored in set_key against value. Duplicates in value are ignored.
+void SelvaModify_DiffSet(RedisModuleCtx *ctx, RedisModuleString *set_key, RedisModuleString **value, size_t nr_value, struct SelvaModify_SetDiff *diff);
+
+// Replace the members of a plain set with one SREM and one SADD of the diff. Returns 1 if the set changed.
+int SelvaModify_ResetSet(RedisModuleCtx *ctx, RedisModuleString *set_key, RedisModuleString **value, size_t nr_value, struct SelvaModify_SetDiff *diff);
+
+// Parse the value of SELVA_MODIFY_ARG_OP_SET. Returns NULL if it's malformed.
+struct SelvaModify_OpSet *SelvaModify_ParseOpSet(RedisModuleCtx *ctx, RedisModuleString *data);
+
+// Check an op without applying it. Return 1 if the op can be applied to the node.
+int SelvaModify_ValidateIncrement(RedisModuleKey *id_key, RedisModuleString *field, RedisModuleString *value, int is_double);
+int SelvaModify_ValidateOpSet(RedisModuleString *id, RedisModuleString *field, const struct SelvaModify_OpSet *setOpts);
+
+// The ops return 1 if the node changed, 0 if it didn't, and -1 on error.
+int SelvaModify_ModifyIncrement(RedisModuleCtx *ctx, RedisModuleKey *id_key, RedisModuleString *id, RedisModuleString *field, RedisModuleString *value);
+int SelvaModify_ModifyIncrementDouble(RedisModuleCtx *ctx, RedisModuleKey *id_key, RedisModuleString *id, RedisModuleString *field, RedisModuleString *value);
+int SelvaModify_ModifySet(RedisModuleCtx *ctx, struct SelvaModify_Hierarchy *hierarchy, RedisModuleString *id, RedisModuleString *field, const struct SelvaModify_OpSet *setOpts);
+int SelvaModify_ModifyDel(RedisModuleCtx *ctx, struct SelvaModify_Hierarchy *hierarchy, RedisModuleKey *id_key, RedisModuleString *id, RedisModuleString *field);
+
+// Delete the fields of the object in field that aren't written by the
+// remaining triplets, like $merge: false.
+int SelvaModify_ModifyNoMerge(RedisModuleCtx *ctx, RedisModuleKey *id_key, RedisModuleString *id, RedisModuleString *field, RedisModuleString **rest, int nr_rest);
 
 #endif /* SELVA_MODIFY */
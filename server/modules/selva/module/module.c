@@ -1,3 +1,7 @@
+// For timers, see Hierarchy_RDBLoad(), and keyspace events, see SelvaNumIndex_OnLoad()
+#define REDISMODULE_EXPERIMENTAL_API
+// Define the API pointers here, every other file only declares them
+#define REDISMODULE_API
 #include "../redismodule.h"
 #include "../rmutil/util.h"
 #include "../rmutil/strings.h"
@@ -5,6 +9,17 @@
 
 #include "./id/id.h"
 #include "./modify/modify.h"
+#include "./modify/async_task.h"
+#include "./hierarchy/hierarchy.h"
+#include "./schema/schema.h"
+#include "./find/find.h"
+#include "./inherit/inherit.h"
+#include "./typeindex/typeindex.h"
+#include "./alias/alias.h"
+#include "./delete/delete.h"
+#include "./suggestion/suggestion.h"
+#include "./numindex/numindex.h"
+#include "./get/get.h"
 
 int SelvaCommand_GenId(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
   // init auto memory for created strings
@@ -43,61 +58,385 @@ int SelvaCommand_Flurpy(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
   return REDISMODULE_OK;
 }
 
-// id, type, key, value [, ... type, key, value]]
-int SelvaCommand_Modify(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
-  RedisModule_AutoMemory(ctx);
+static int isParentsOp(RedisModuleString *type, RedisModuleString *field) {
+  size_t field_len;
+  const char *field_str = RedisModule_StringPtrLen(field, &field_len);
+
+  return *RedisModule_StringPtrLen(type, NULL) == SELVA_MODIFY_ARG_OP_SET &&
+    field_len == sizeof("parents") - 1 && !memcmp(field_str, "parents", field_len);
+}
+
+static SelvaModify_Hierarchy *openDefaultHierarchy(RedisModuleCtx *ctx) {
+  if (!SelvaSchema_Get()) {
+    SelvaSchema_Load(ctx);
+  }
+
+  RedisModuleString *hkey_name = RedisModule_CreateString(ctx, HIERARCHY_DEFAULT_KEY, sizeof(HIERARCHY_DEFAULT_KEY) - 1);
+  return SelvaModify_OpenHierarchyKey(ctx, hkey_name, REDISMODULE_WRITE);
+}
+
+// Set createdAt of a new node and updatedAt of a changed one if its type has the field.
+// The timestamps are written as value triplets to stamps for replication; returns their argc.
+static int stampNode(RedisModuleCtx *ctx, RedisModuleKey *id_key, const char *id_str, size_t id_len, int is_created, int is_updated, RedisModuleString **stamps) {
+  const struct SelvaSchema *schema = SelvaSchema_Get();
+  const unsigned int flags = schema ? SelvaSchema_GetTypeFlags(schema, id_str) : 0;
+  const int set_created = is_created && (flags & SELVA_SCHEMA_TYPE_CREATED_AT);
+  const int set_updated = is_updated && (flags & SELVA_SCHEMA_TYPE_UPDATED_AT);
+  const char value_type[] = { SELVA_MODIFY_ARG_VALUE };
+  int n = 0;
 
-  RedisModuleString *id = argv[1];
+  if (!set_created && !set_updated) {
+    return 0;
+  }
+
+  RedisModuleString *now = RedisModule_CreateStringFromLongLong(ctx, RedisModule_Milliseconds());
+
+  if (set_created && set_updated) {
+    RedisModule_HashSet(id_key, REDISMODULE_HASH_CFIELDS, "createdAt", now, "updatedAt", now, NULL);
+  } else {
+    RedisModule_HashSet(id_key, REDISMODULE_HASH_CFIELDS, set_created ? "createdAt" : "updatedAt", now, NULL);
+  }
+
+  if (set_created) {
+    SelvaModify_PublishUpdate(id_str, id_len, "createdAt", sizeof("createdAt") - 1);
+    stamps[n++] = RedisModule_CreateString(ctx, value_type, sizeof(value_type));
+    stamps[n++] = RedisModule_CreateString(ctx, "createdAt", sizeof("createdAt") - 1);
+    stamps[n++] = now;
+    SelvaModify_IndexField(ctx, id_key, id_str, id_len, stamps[n - 2], now);
+  }
+  if (set_updated) {
+    SelvaModify_PublishUpdate(id_str, id_len, "updatedAt", sizeof("updatedAt") - 1);
+    stamps[n++] = RedisModule_CreateString(ctx, value_type, sizeof(value_type));
+    stamps[n++] = RedisModule_CreateString(ctx, "updatedAt", sizeof("updatedAt") - 1);
+    stamps[n++] = now;
+    SelvaModify_IndexField(ctx, id_key, id_str, id_len, stamps[n - 2], now);
+  }
+
+  return n;
+}
+
+// Replicate the applied ops of a node as selva.modify, followed by the timestamps
+static void replicateNode(RedisModuleCtx *ctx, RedisModuleString *id, RedisModuleString **ops, int nr_ops, RedisModuleString **stamps, int nr_stamps) {
+  if (nr_stamps == 0) {
+    RedisModule_Replicate(ctx, "selva.modify", "sv", id, ops, (size_t)nr_ops);
+  } else {
+    RedisModuleString **rep = RedisModule_PoolAlloc(ctx, (nr_ops + nr_stamps) * sizeof(RedisModuleString *));
+
+    memcpy(rep, ops, nr_ops * sizeof(RedisModuleString *));
+    memcpy(rep + nr_ops, stamps, nr_stamps * sizeof(RedisModuleString *));
+    RedisModule_Replicate(ctx, "selva.modify", "sv", id, rep, (size_t)(nr_ops + nr_stamps));
+  }
+}
+
+// Check every triplet of a node before anything is written. Returns the
+// parsed set ops by triplet, or NULL if an op is invalid.
+static struct SelvaModify_OpSet **validateOps(RedisModuleCtx *ctx, RedisModuleKey *id_key, RedisModuleString *id, RedisModuleString **argv, int argc) {
+  struct SelvaModify_OpSet **set_ops = RedisModule_PoolAlloc(ctx, (argc / 3 + 1) * sizeof(struct SelvaModify_OpSet *));
+
+  for (int i = 1; i < argc; i += 3) {
+    const char *type_str = RedisModule_StringPtrLen(argv[i], NULL);
+    int valid;
+
+    set_ops[i / 3] = NULL;
+    switch (*type_str) {
+      case SELVA_MODIFY_ARG_VALUE:
+      case SELVA_MODIFY_ARG_INDEXED_VALUE:
+      case SELVA_MODIFY_ARG_DEFAULT:
+      case SELVA_MODIFY_ARG_REFERENCE:
+      case SELVA_MODIFY_ARG_OP_DEL:
+      case SELVA_MODIFY_ARG_OP_NO_MERGE:
+        valid = 1;
+        break;
+      case SELVA_MODIFY_ARG_OP_INCREMENT:
+      case SELVA_MODIFY_ARG_OP_INCREMENT_DOUBLE:
+        valid = SelvaModify_ValidateIncrement(id_key, argv[i + 1], argv[i + 2], *type_str == SELVA_MODIFY_ARG_OP_INCREMENT_DOUBLE);
+        break;
+      case SELVA_MODIFY_ARG_OP_SET:
+        set_ops[i / 3] = SelvaModify_ParseOpSet(ctx, argv[i + 2]);
+        valid = set_ops[i / 3] && SelvaModify_ValidateOpSet(id, argv[i + 1], set_ops[i / 3]);
+        break;
+      default:
+        valid = 0;
+    }
+
+    if (!valid) {
+      return NULL;
+    }
+  }
+
+  return set_ops;
+}
+
+// Apply the triplets of one node and replicate them as selva.modify.
+// argv starts from the id. Returns the id or NULL if an op is invalid, in
+// which case nothing is written. The hierarchy must be recomputed afterwards.
+static RedisModuleString *modifyNode(RedisModuleCtx *ctx, SelvaModify_Hierarchy *hierarchy, RedisModuleString **argv, int argc) {
+  RedisModuleString *id = argv[0];
   size_t id_len;
   const char *id_str = RedisModule_StringPtrLen(id, &id_len);
 
   if (id_len == 2) {
     char hash_str[37];
     SelvaId_GenId(id_str, hash_str);
-    id_str = hash_str;
     id = RedisModule_CreateString(ctx, hash_str, strlen(hash_str) * sizeof(char));
+    id_str = RedisModule_StringPtrLen(id, &id_len);
   }
 
-  RedisModuleKey *id_key = RedisModule_OpenKey(ctx, id, REDISMODULE_WRITE);
-  for (int i = 2; i < argc; i += 3) {
+  RedisModuleKey *id_key = RedisModule_OpenKey(ctx, id, REDISMODULE_READ | REDISMODULE_WRITE);
+  const int key_type = RedisModule_KeyType(id_key);
+  const int is_new = key_type == REDISMODULE_KEYTYPE_EMPTY;
+  struct SelvaModify_OpSet **set_ops;
+  int changed = 0;
+  int has_created_at = 0;
+  int has_updated_at = 0;
+  RedisModuleString *stamps[6];
+  int nr_stamps;
+
+  if ((!is_new && key_type != REDISMODULE_KEYTYPE_HASH) ||
+      !(set_ops = validateOps(ctx, id_key, id, argv, argc))) {
+    RedisModule_CloseKey(id_key);
+    return NULL;
+  }
+
+  SelvaTypeIndex_Add(id_str, id_len);
+
+  // New nodes are created under root unless the parents are given
+  if (is_new && !(id_len == 4 && !memcmp(id_str, "root", 4))) {
+    int has_parents = 0;
+
+    for (int i = 1; i < argc && !has_parents; i += 3) {
+      has_parents = isParentsOp(argv[i], argv[i + 1]);
+    }
+
+    if (!has_parents) {
+      struct SelvaModify_OpSet opSet = {
+        .is_reference = 1,
+        .$add = "root",
+        .$add_len = 4,
+      };
+
+      changed |= SelvaModify_ModifySet(ctx, hierarchy, id, RedisModule_CreateString(ctx, "parents", 7), &opSet) > 0;
+    }
+  }
+
+  for (int i = 1; i < argc; i += 3) {
     RedisModuleString *type = argv[i];
     RedisModuleString *field = argv[i + 1];
     RedisModuleString *value = argv[i + 2];
 
-    RedisModule_HashSet(id_key, REDISMODULE_HASH_NONE, field, value, NULL);
-
     size_t field_len;
     const char *field_str = RedisModule_StringPtrLen(field, &field_len);
 
     size_t type_len;
     const char *type_str = RedisModule_StringPtrLen(type, &type_len);
 
-    if (*type_str == SELVA_MODIFY_ARG_INDEXED_VALUE) {
-      size_t value_len;
-      const char *value_str = RedisModule_StringPtrLen(value, &value_len);
-      int indexing_str_len = sizeof(int32_t) + sizeof(struct SelvaModify_AsyncTask) + field_len + value_len;
-      char indexing_str[indexing_str_len];
-      SelvaModify_PrepareValueIndexPayload(indexing_str, id_str, id_len, field_str, field_len, value_str, value_len);
-      SelvaModify_SendAsyncTask(indexing_str_len, indexing_str, 3);
+    size_t value_len;
+    const char *value_str = RedisModule_StringPtrLen(value, &value_len);
+
+    int res = 0;
+
+    // Timestamps given by the client take precedence
+    if (field_len == sizeof("createdAt") - 1 && !memcmp(field_str, "createdAt", field_len)) {
+      has_created_at = 1;
+    } else if (field_len == sizeof("updatedAt") - 1 && !memcmp(field_str, "updatedAt", field_len)) {
+      has_updated_at = 1;
     }
 
-    int payload_len = sizeof(int32_t) + sizeof(struct SelvaModify_AsyncTask) + field_len;
-    char payload_str[payload_len];
-    SelvaModify_PreparePublishPayload(payload_str, id_str, id_len, field_str, field_len);
+    switch (*type_str) {
+      case SELVA_MODIFY_ARG_VALUE:
+      case SELVA_MODIFY_ARG_INDEXED_VALUE:
+      case SELVA_MODIFY_ARG_DEFAULT: {
+        RedisModuleString *current = NULL;
+
+        RedisModule_HashGet(id_key, REDISMODULE_HASH_NONE, field, &current, NULL);
+        if (current && (*type_str == SELVA_MODIFY_ARG_DEFAULT || !RedisModule_StringCompare(current, value))) {
+          break;
+        }
+
+        if (SelvaSuggestion_IsSugField(id_str, field_str, field_len)) {
+          SelvaSuggestion_Update(current, value);
+        }
+        RedisModule_HashSet(id_key, REDISMODULE_HASH_NONE, field, value, NULL);
+        if (!SelvaModify_IndexField(ctx, id_key, id_str, id_len, field, value) && *type_str == SELVA_MODIFY_ARG_INDEXED_VALUE) {
+          SelvaModify_PublishIndex(id_str, id_len, field_str, field_len, value_str, value_len);
+        }
+        SelvaModify_PublishUpdate(id_str, id_len, field_str, field_len);
+        res = 1;
+        break;
+      }
+      case SELVA_MODIFY_ARG_OP_INCREMENT:
+        res = SelvaModify_ModifyIncrement(ctx, id_key, id, field, value);
+        break;
+      case SELVA_MODIFY_ARG_OP_INCREMENT_DOUBLE:
+        res = SelvaModify_ModifyIncrementDouble(ctx, id_key, id, field, value);
+        break;
+      case SELVA_MODIFY_ARG_REFERENCE: {
+        RedisModuleString *ref_field = RedisModule_CreateStringPrintf(ctx, "%.*s.$ref", (int)field_len, field_str);
+        RedisModuleString *current = NULL;
+
+        RedisModule_HashGet(id_key, REDISMODULE_HASH_NONE, ref_field, &current, NULL);
+        if (!current || RedisModule_StringCompare(current, value)) {
+          RedisModule_HashSet(id_key, REDISMODULE_HASH_NONE, ref_field, value, NULL);
+          SelvaModify_PublishUpdate(id_str, id_len, field_str, field_len);
+          res = 1;
+        }
+        break;
+      }
+      case SELVA_MODIFY_ARG_OP_SET:
+        res = SelvaModify_ModifySet(ctx, hierarchy, id, field, set_ops[i / 3]);
+        break;
+      case SELVA_MODIFY_ARG_OP_DEL:
+        res = SelvaModify_ModifyDel(ctx, hierarchy, id_key, id, field);
+        break;
+      case SELVA_MODIFY_ARG_OP_NO_MERGE:
+        res = SelvaModify_ModifyNoMerge(ctx, id_key, id, field, argv + i + 3, argc - i - 3);
+        break;
+      default:
+        res = -1;
+    }
 
-    // publish
-    printf("Sending async task with struct %zu and field %zu\n", sizeof(struct SelvaModify_AsyncTask), field_len);
-    SelvaModify_SendAsyncTask(payload_len, payload_str, 3);
+    if (res < 0) {
+      nr_stamps = stampNode(ctx, id_key, id_str, id_len, is_new && !has_created_at, changed && !has_updated_at, stamps);
+      RedisModule_CloseKey(id_key);
+      replicateNode(ctx, id, argv + 1, i - 1, stamps, nr_stamps);
+      return NULL;
+    }
+    changed |= res > 0;
   }
 
+  nr_stamps = stampNode(ctx, id_key, id_str, id_len, is_new && !has_created_at, changed && !has_updated_at, stamps);
   RedisModule_CloseKey(id_key);
 
-  RedisModule_ReplyWithString(ctx, id);
+  // Replicate with the generated id, not the type prefix
+  replicateNode(ctx, id, argv + 1, argc - 1, stamps, nr_stamps);
+
+  return id;
+}
+
+// id, type, key, value [, ... type, key, value]]
+int SelvaCommand_Modify(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  RedisModule_AutoMemory(ctx);
+
+  if (argc < 2 || (argc - 2) % 3) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  SelvaModify_Hierarchy *hierarchy = openDefaultHierarchy(ctx);
+  if (!hierarchy) {
+    return REDISMODULE_OK;
+  }
+
+  RedisModuleString *id = modifyNode(ctx, hierarchy, argv + 1, argc - 1);
+  SelvaModify_HierarchyRecompute(hierarchy);
+  SelvaModify_FlushUpdates();
+  SelvaModify_FlushIndex(ctx);
+  SelvaSuggestion_Flush(ctx);
+
+  if (!id) {
+    return RedisModule_ReplyWithError(ctx, "ERR invalid modify operation");
+  }
+
+  return RedisModule_ReplyWithString(ctx, id);
+}
+
+// nr_triplets, id, type, key, value [, ... type, key, value] [, nr_triplets, id, ...]
+// Replies with the id or an error for each node. A malformed group header
+// ends the batch with an error in place of the remaining nodes.
+int SelvaCommand_ModifyBatch(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  RedisModule_AutoMemory(ctx);
+
+  // The ids are the keys, the group headers tell where they are
+  if (RedisModule_IsKeysPositionRequest(ctx)) {
+    long long nr_triplets;
+
+    for (int i = 1; i + 1 < argc && RedisModule_StringToLongLong(argv[i], &nr_triplets) == REDISMODULE_OK &&
+         nr_triplets >= 0 && nr_triplets <= (argc - i - 2) / 3; i += 2 + 3 * (int)nr_triplets) {
+      RedisModule_KeyAtPos(ctx, i + 1);
+    }
+    return REDISMODULE_OK;
+  }
+
+  if (argc < 3) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  SelvaModify_Hierarchy *hierarchy = openDefaultHierarchy(ctx);
+  if (!hierarchy) {
+    return REDISMODULE_OK;
+  }
+
+  long nr_replies = 0;
+  int i = 1;
+
+  RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
+  while (i < argc) {
+    long long nr_triplets;
+
+    if (i + 1 >= argc || RedisModule_StringToLongLong(argv[i], &nr_triplets) == REDISMODULE_ERR ||
+        nr_triplets < 0 || nr_triplets > (argc - i - 2) / 3) {
+      RedisModule_ReplyWithError(ctx, "ERR invalid batch group");
+      nr_replies++;
+      break;
+    }
+
+    const int group_argc = 1 + 3 * (int)nr_triplets;
+    RedisModuleString *id = modifyNode(ctx, hierarchy, argv + i + 1, group_argc);
+
+    if (id) {
+      RedisModule_ReplyWithString(ctx, id);
+    } else {
+      RedisModule_ReplyWithError(ctx, "ERR invalid modify operation");
+    }
+    nr_replies++;
+    i += 1 + group_argc;
+  }
+  RedisModule_ReplySetArrayLength(ctx, nr_replies);
+
+  SelvaModify_HierarchyRecompute(hierarchy);
+  SelvaModify_FlushUpdates();
+  SelvaModify_FlushIndex(ctx);
+  SelvaSuggestion_Flush(ctx);
+
+  return REDISMODULE_OK;
+}
+
+// key [member ...]
+// Replace the members of a set and reply with the added and removed members.
+int SelvaCommand_SetReset(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  RedisModule_AutoMemory(ctx);
+
+  if (argc < 2) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  RedisModuleKey *key = RedisModule_OpenKey(ctx, argv[1], REDISMODULE_READ);
+  const int type = RedisModule_KeyType(key);
+
+  RedisModule_CloseKey(key);
+  if (type != REDISMODULE_KEYTYPE_EMPTY && type != REDISMODULE_KEYTYPE_SET) {
+    return RedisModule_ReplyWithError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
+  }
+
+  struct SelvaModify_SetDiff diff;
+
+  if (SelvaModify_ResetSet(ctx, argv[1], argv + 2, argc - 2, &diff)) {
+    RedisModule_ReplicateVerbatim(ctx);
+  }
+
+  RedisModule_ReplyWithArray(ctx, 2);
+  RedisModule_ReplyWithArray(ctx, diff.nr_added);
+  for (size_t i = 0; i < diff.nr_added; i++) {
+    RedisModule_ReplyWithString(ctx, diff.added[i]);
+  }
+  RedisModule_ReplyWithArray(ctx, diff.nr_removed);
+  for (size_t i = 0; i < diff.nr_removed; i++) {
+    RedisModule_ReplyWithString(ctx, diff.removed[i]);
+  }
 
   return REDISMODULE_OK;
 }
 
-int RedisModule_OnLoad(RedisModuleCtx *ctx) {
+int RedisModule_OnLoad(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
 
   // Register the module itself
   if (RedisModule_Init(ctx, "selva", 1, REDISMODULE_APIVER_1) == REDISMODULE_ERR) {
@@ -109,7 +448,15 @@ int RedisModule_OnLoad(RedisModuleCtx *ctx) {
   }
 
 
-  if (RedisModule_CreateCommand(ctx, "selva.modify", SelvaCommand_Modify, "readonly", 1, 1, 1) == REDISMODULE_ERR) {
+  if (RedisModule_CreateCommand(ctx, "selva.modify", SelvaCommand_Modify, "write deny-oom", 1, 1, 1) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  if (RedisModule_CreateCommand(ctx, "selva.modify.batch", SelvaCommand_ModifyBatch, "write deny-oom getkeys-api", 0, 0, 0) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  if (RedisModule_CreateCommand(ctx, "selva.set.reset", SelvaCommand_SetReset, "write deny-oom", 1, 1, 1) == REDISMODULE_ERR) {
     return REDISMODULE_ERR;
   }
 
@@ -117,5 +464,50 @@ int RedisModule_OnLoad(RedisModuleCtx *ctx) {
     return REDISMODULE_ERR;
   }
 
+  if (SelvaModify_AsyncTask_OnLoad(ctx, argv, argc) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  // Registers the hierarchy type that loading the schema looks for
+  if (SelvaModify_Hierarchy_OnLoad(ctx) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  if (SelvaSchema_OnLoad(ctx) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  if (SelvaTypeIndex_OnLoad(ctx) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  if (SelvaAlias_OnLoad(ctx) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  if (SelvaSuggestion_OnLoad(ctx) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  if (SelvaNumIndex_OnLoad(ctx) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  if (SelvaGet_OnLoad(ctx) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  if (SelvaModify_Delete_OnLoad(ctx) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  if (SelvaModify_Find_OnLoad(ctx) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  if (SelvaModify_Inherit_OnLoad(ctx) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
   return REDISMODULE_OK;
 }
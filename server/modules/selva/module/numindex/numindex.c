@@ -0,0 +1,478 @@
+// For keyspace events
+#define REDISMODULE_EXPERIMENTAL_API
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#include "../../redismodule.h"
+#include "../hierarchy/hierarchy.h"
+#include "../schema/schema.h"
+#include "../typeindex/typeindex.h"
+#include "./numindex.h"
+#include "./skiplist.h"
+
+struct numIndex {
+  char *field;
+  struct SelvaSkiplist *list;
+  // Selva_NodeId -> struct SelvaSkiplist_Node *
+  RedisModuleDict *nodes;
+  // Selva_NodeId -> NULL; the nodes known not to have a value. A node in
+  // neither dict was written before the index was built by something that
+  // doesn't update the type index, and is read when it's first needed.
+  RedisModuleDict *no_value;
+};
+
+// field -> struct numIndex *; only the indexes that have been built
+static RedisModuleDict *num_indexes;
+
+static int toNodeId(Selva_NodeId id, const char *id_str, size_t id_len) {
+  if (id_len == 0 || id_len > SELVA_NODE_ID_SIZE) {
+    return 0;
+  }
+
+  memset(id, '\0', SELVA_NODE_ID_SIZE);
+  memcpy(id, id_str, id_len);
+
+  return 1;
+}
+
+static struct numIndex *getIndex(const char *field_str, size_t field_len) {
+  return num_indexes ? RedisModule_DictGetC(num_indexes, (void *)field_str, field_len, NULL) : NULL;
+}
+
+// Remove the value of a node, which is still known to the index if it exists
+static void removeNode(struct numIndex *index, const Selva_NodeId id, int exists) {
+  struct SelvaSkiplist_Node *node = NULL;
+
+  if (exists) {
+    RedisModule_DictReplaceC(index->no_value, (void *)id, SELVA_NODE_ID_SIZE, NULL);
+  } else {
+    RedisModule_DictDelC(index->no_value, (void *)id, SELVA_NODE_ID_SIZE, NULL);
+  }
+
+  if (RedisModule_DictDelC(index->nodes, (void *)id, SELVA_NODE_ID_SIZE, &node) == REDISMODULE_OK) {
+    const Selva_NodeHandle handle = node->handle;
+
+    SelvaSkiplist_Delete(index->list, node->value, handle);
+    SelvaId_Release(handle);
+  }
+}
+
+static void setNode(struct numIndex *index, const Selva_NodeId id, double value) {
+  struct SelvaSkiplist_Node *node = RedisModule_DictGetC(index->nodes, (void *)id, SELVA_NODE_ID_SIZE, NULL);
+  Selva_NodeHandle handle;
+
+  RedisModule_DictDelC(index->no_value, (void *)id, SELVA_NODE_ID_SIZE, NULL);
+  if (node) {
+    if (node->value == value) {
+      return;
+    }
+
+    // The node keeps its reference to the handle
+    handle = node->handle;
+    SelvaSkiplist_Delete(index->list, node->value, handle);
+  } else {
+    handle = SelvaId_Intern(id);
+  }
+
+  node = SelvaSkiplist_Insert(index->list, value, handle);
+  RedisModule_DictReplaceC(index->nodes, (void *)id, SELVA_NODE_ID_SIZE, node);
+}
+
+static int parseValue(RedisModuleString *value, double *d) {
+  return value && RedisModule_StringToDouble(value, d) == REDISMODULE_OK && !isnan(*d);
+}
+
+void SelvaNumIndex_Update(const char *id_str, size_t id_len, const char *field_str, size_t field_len, RedisModuleString *value) {
+  struct numIndex *index = getIndex(field_str, field_len);
+  Selva_NodeId id;
+  double d;
+
+  if (!index || !toNodeId(id, id_str, id_len)) {
+    return;
+  }
+
+  if (parseValue(value, &d)) {
+    setNode(index, id, d);
+  } else {
+    removeNode(index, id, 1);
+  }
+}
+
+void SelvaNumIndex_DelNode(const char *id_str, size_t id_len) {
+  RedisModuleDictIter *it;
+  struct numIndex *index;
+  Selva_NodeId id;
+
+  if (!num_indexes || !toNodeId(id, id_str, id_len)) {
+    return;
+  }
+
+  it = RedisModule_DictIteratorStartC(num_indexes, "^", NULL, 0);
+  while (RedisModule_DictNextC(it, NULL, (void **)&index)) {
+    removeNode(index, id, 0);
+  }
+  RedisModule_DictIteratorStop(it);
+}
+
+static void freeIndex(struct numIndex *index) {
+  RedisModuleDictIter *it;
+  struct SelvaSkiplist_Node *node;
+
+  it = RedisModule_DictIteratorStartC(index->nodes, "^", NULL, 0);
+  while (RedisModule_DictNextC(it, NULL, (void **)&node)) {
+    SelvaId_Release(node->handle);
+  }
+  RedisModule_DictIteratorStop(it);
+
+  RedisModule_FreeDict(NULL, index->nodes);
+  RedisModule_FreeDict(NULL, index->no_value);
+  SelvaSkiplist_Free(index->list);
+  RedisModule_Free(index->field);
+  RedisModule_Free(index);
+}
+
+void SelvaNumIndex_Clear(void) {
+  RedisModuleDictIter *it;
+  struct numIndex *index;
+
+  if (!num_indexes) {
+    return;
+  }
+
+  it = RedisModule_DictIteratorStartC(num_indexes, "^", NULL, 0);
+  while (RedisModule_DictNextC(it, NULL, (void **)&index)) {
+    freeIndex(index);
+  }
+  RedisModule_DictIteratorStop(it);
+
+  RedisModule_FreeDict(NULL, num_indexes);
+  num_indexes = NULL;
+}
+
+// Writes that bypass selva.modify, e.g. hset from Lua scripts, hdel, del and
+// expiry, are picked up from the keyspace events of the key.
+static int onKeyspaceEvent(RedisModuleCtx *ctx, int type __attribute__((unused)), const char *event __attribute__((unused)), RedisModuleString *key_name) {
+  size_t id_len;
+  const char *id_str = RedisModule_StringPtrLen(key_name, &id_len);
+  RedisModuleDictIter *it;
+  RedisModuleKey *key;
+  struct numIndex *index;
+  Selva_NodeId id;
+
+  if (!num_indexes || !toNodeId(id, id_str, id_len)) {
+    return 0;
+  }
+
+  key = RedisModule_OpenKey(ctx, key_name, REDISMODULE_READ);
+  const int is_hash = RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_HASH;
+
+  it = RedisModule_DictIteratorStartC(num_indexes, "^", NULL, 0);
+  while (RedisModule_DictNextC(it, NULL, (void **)&index)) {
+    RedisModuleString *value = NULL;
+    double d;
+
+    if (is_hash) {
+      RedisModule_HashGet(key, REDISMODULE_HASH_CFIELDS, index->field, &value, NULL);
+    }
+
+    if (parseValue(value, &d)) {
+      setNode(index, id, d);
+    } else {
+      removeNode(index, id, is_hash);
+    }
+
+    if (value) {
+      RedisModule_FreeString(ctx, value);
+    }
+  }
+  RedisModule_DictIteratorStop(it);
+  RedisModule_CloseKey(key);
+
+  return 0;
+}
+
+struct buildArgs {
+  RedisModuleCtx *ctx;
+  struct numIndex *index;
+};
+
+static void buildNode(const char *id_str, size_t id_len, void *arg) {
+  struct buildArgs *args = (struct buildArgs *)arg;
+  RedisModuleString *key_name = RedisModule_CreateString(args->ctx, id_str, id_len);
+  RedisModuleKey *key = RedisModule_OpenKey(args->ctx, key_name, REDISMODULE_READ);
+  const int is_hash = RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_HASH;
+  RedisModuleString *value = NULL;
+  Selva_NodeId id;
+  double d;
+
+  if (is_hash) {
+    RedisModule_HashGet(key, REDISMODULE_HASH_CFIELDS, args->index->field, &value, NULL);
+  }
+
+  if (toNodeId(id, id_str, id_len)) {
+    if (parseValue(value, &d)) {
+      setNode(args->index, id, d);
+    } else if (is_hash) {
+      removeNode(args->index, id, 1);
+    }
+  }
+
+  if (value) {
+    RedisModule_FreeString(args->ctx, value);
+  }
+  RedisModule_CloseKey(key);
+  RedisModule_FreeString(args->ctx, key_name);
+}
+
+long long SelvaNumIndex_Open(RedisModuleCtx *ctx, const char *field_str, size_t field_len) {
+  const struct SelvaSchema *schema = SelvaSchema_Get();
+  struct numIndex *index = getIndex(field_str, field_len);
+
+  if (index) {
+    return (long long)index->list->len;
+  }
+
+  if (!schema || !(SelvaSchema_GetFieldSearchFlags(schema, field_str, field_len) & SELVA_SCHEMA_SEARCH_NUMERIC)) {
+    return -1;
+  }
+
+  index = RedisModule_Alloc(sizeof(struct numIndex));
+  index->field = RedisModule_Alloc(field_len + 1);
+  memcpy(index->field, field_str, field_len);
+  index->field[field_len] = '\0';
+  index->list = SelvaSkiplist_New();
+  index->nodes = RedisModule_CreateDict(NULL);
+  index->no_value = RedisModule_CreateDict(NULL);
+
+  // root isn't in the type index
+  struct buildArgs args = { .ctx = ctx, .index = index };
+  buildNode("root", 4, &args);
+  SelvaTypeIndex_Foreach(buildNode, &args);
+
+  if (!num_indexes) {
+    num_indexes = RedisModule_CreateDict(NULL);
+  }
+  RedisModule_DictSetC(num_indexes, (void *)field_str, field_len, index);
+
+  return (long long)index->list->len;
+}
+
+int SelvaNumIndex_Has(RedisModuleCtx *ctx, const char *field_str, size_t field_len, const char *id_str, size_t id_len) {
+  struct numIndex *index = getIndex(field_str, field_len);
+  Selva_NodeId id;
+  int nokey = 1;
+
+  if (!index || !toNodeId(id, id_str, id_len)) {
+    return 0;
+  }
+
+  RedisModule_DictGetC(index->nodes, (void *)id, SELVA_NODE_ID_SIZE, &nokey);
+  if (nokey) {
+    RedisModule_DictGetC(index->no_value, (void *)id, SELVA_NODE_ID_SIZE, &nokey);
+    if (!nokey) {
+      return 0;
+    }
+
+    struct buildArgs args = { .ctx = ctx, .index = index };
+    buildNode(id_str, id_len, &args);
+    RedisModule_DictGetC(index->nodes, (void *)id, SELVA_NODE_ID_SIZE, &nokey);
+  }
+
+  return !nokey;
+}
+
+int SelvaNumIndex_Scan(const char *field_str, size_t field_len, double min, double max, int rev, SelvaNumIndex_ScanCallback cb, void *arg) {
+  struct numIndex *index = getIndex(field_str, field_len);
+  struct SelvaSkiplist_Node *node;
+
+  if (!index) {
+    return -1;
+  }
+
+  if (rev) {
+    for (node = SelvaSkiplist_Last(index->list, max); node && node->value >= min; node = SelvaSkiplist_Prev(node)) {
+      if (cb(node->handle, node->value, arg)) {
+        break;
+      }
+    }
+  } else {
+    for (node = SelvaSkiplist_First(index->list, min); node && node->value <= max; node = SelvaSkiplist_Next(node)) {
+      if (cb(node->handle, node->value, arg)) {
+        break;
+      }
+    }
+  }
+
+  return 0;
+}
+
+int SelvaNumIndex_ScanAfter(const char *field_str, size_t field_len, double value, const Selva_NodeId id, int rev, SelvaNumIndex_ScanCallback cb, void *arg) {
+  struct numIndex *index = getIndex(field_str, field_len);
+  struct SelvaSkiplist_Node *node;
+
+  if (!index) {
+    return -1;
+  }
+
+  node = rev ? SelvaSkiplist_Before(index->list, value, id) : SelvaSkiplist_After(index->list, value, id);
+  while (node && !cb(node->handle, node->value, arg)) {
+    node = rev ? SelvaSkiplist_Prev(node) : SelvaSkiplist_Next(node);
+  }
+
+  return 0;
+}
+
+struct rangeArgs {
+  RedisModuleCtx *ctx;
+  // A bitmap of the candidate handles, or NULL to match every node
+  uint64_t *candidates;
+  size_t nr_candidate_words;
+  long long offset;
+  long long limit;
+  long long nr_ids;
+};
+
+static int setCandidate(const Selva_NodeId id, void *arg) {
+  struct rangeArgs *args = (struct rangeArgs *)arg;
+  const Selva_NodeHandle handle = SelvaId_Lookup(id);
+
+  if (handle != SELVA_NODE_HANDLE_NONE && handle / 64 < args->nr_candidate_words) {
+    args->candidates[handle / 64] |= UINT64_C(1) << (handle % 64);
+  }
+
+  return 0;
+}
+
+static int replyWithNode(Selva_NodeHandle handle, double value __attribute__((unused)), void *arg) {
+  struct rangeArgs *args = (struct rangeArgs *)arg;
+
+  if (args->candidates && !(args->candidates[handle / 64] & (UINT64_C(1) << (handle % 64)))) {
+    return 0;
+  }
+
+  if (args->offset > 0) {
+    args->offset--;
+    return 0;
+  }
+
+  const char *id = SelvaId_GetId(handle);
+  RedisModule_ReplyWithStringBuffer(args->ctx, id, SelvaModify_NodeIdLen(id));
+  args->nr_ids++;
+
+  return args->limit >= 0 && args->nr_ids >= args->limit;
+}
+
+// SELVA.NUMINDEX.RANGE key field min max [REV] [OFFSET n] [LIMIT n] [IDS ids | DESCENDANTS id [id ...]]
+// Reply with the ids of the nodes with min <= field <= max ordered by the
+// value, or in reverse order with REV. The range is inclusive and accepts
+// -inf and +inf. IDS restricts the result to a NUL separated list of ids and
+// DESCENDANTS to the descendants of the given nodes in the hierarchy at key.
+int SelvaCommand_NumIndexRange(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  RedisModule_AutoMemory(ctx);
+
+  struct rangeArgs args = {
+    .ctx = ctx,
+    .limit = -1,
+  };
+  double min, max;
+  int rev = 0;
+  int i = 5;
+
+  if (argc < 5) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  size_t field_len;
+  const char *field_str = RedisModule_StringPtrLen(argv[2], &field_len);
+
+  if (RedisModule_StringToDouble(argv[3], &min) == REDISMODULE_ERR ||
+      RedisModule_StringToDouble(argv[4], &max) == REDISMODULE_ERR) {
+    return RedisModule_ReplyWithError(ctx, "ERR invalid range");
+  }
+
+  if (SelvaNumIndex_Open(ctx, field_str, field_len) < 0) {
+    return RedisModule_ReplyWithError(ctx, "ERR field is not a numeric index field");
+  }
+
+  while (i < argc) {
+    const char *opt = RedisModule_StringPtrLen(argv[i], NULL);
+
+    if (!strcasecmp(opt, "REV")) {
+      rev = 1;
+      i++;
+    } else if (!strcasecmp(opt, "OFFSET") && i + 1 < argc) {
+      if (RedisModule_StringToLongLong(argv[i + 1], &args.offset) == REDISMODULE_ERR || args.offset < 0) {
+        return RedisModule_ReplyWithError(ctx, "ERR invalid offset");
+      }
+      i += 2;
+    } else if (!strcasecmp(opt, "LIMIT") && i + 1 < argc) {
+      if (RedisModule_StringToLongLong(argv[i + 1], &args.limit) == REDISMODULE_ERR || args.limit < 0) {
+        return RedisModule_ReplyWithError(ctx, "ERR invalid limit");
+      }
+      i += 2;
+    } else {
+      break;
+    }
+  }
+
+  if (i < argc) {
+    const char *opt = RedisModule_StringPtrLen(argv[i], NULL);
+
+    args.nr_candidate_words = (SelvaId_HandleLimit() + 63) / 64;
+    args.candidates = RedisModule_PoolAlloc(ctx, (args.nr_candidate_words + 1) * sizeof(uint64_t));
+    memset(args.candidates, 0, (args.nr_candidate_words + 1) * sizeof(uint64_t));
+
+    if (!strcasecmp(opt, "IDS") && i + 2 == argc) {
+      size_t ids_len;
+      const char *ids = RedisModule_StringPtrLen(argv[i + 1], &ids_len);
+      const char *p = ids;
+
+      while (p < ids + ids_len) {
+        const char *end = memchr(p, '\0', ids + ids_len - p);
+        const size_t len = (end ? end : ids + ids_len) - p;
+        Selva_NodeId id;
+
+        if (toNodeId(id, p, len)) {
+          setCandidate(id, &args);
+        }
+        p += len + 1;
+      }
+    } else if (!strcasecmp(opt, "DESCENDANTS") && i + 1 < argc) {
+      SelvaModify_Hierarchy *hierarchy = SelvaModify_OpenHierarchyKey(ctx, argv[1], REDISMODULE_READ);
+      const size_t nr_ids = argc - i - 1;
+      Selva_NodeId *ids = RedisModule_PoolAlloc(ctx, nr_ids * sizeof(Selva_NodeId));
+
+      if (!hierarchy) {
+        return RedisModule_ReplyWithArray(ctx, 0);
+      }
+
+      for (size_t j = 0; j < nr_ids; j++) {
+        if (SelvaModify_ParseNodeId(ids[j], argv[i + 1 + j]) == REDISMODULE_ERR) {
+          return RedisModule_ReplyWithError(ctx, "ERR invalid node id");
+        }
+      }
+      SelvaModify_TraverseDescendants(hierarchy, nr_ids, (const Selva_NodeId *)ids, -1, setCandidate, &args);
+    } else {
+      return RedisModule_WrongArity(ctx);
+    }
+  }
+
+  RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
+  if (args.limit != 0) {
+    SelvaNumIndex_Scan(field_str, field_len, min, max, rev, replyWithNode, &args);
+  }
+  RedisModule_ReplySetArrayLength(ctx, args.nr_ids);
+
+  return REDISMODULE_OK;
+}
+
+int SelvaNumIndex_OnLoad(RedisModuleCtx *ctx) {
+  if (RedisModule_CreateCommand(ctx, "selva.numindex.range", SelvaCommand_NumIndexRange, "readonly", 1, 1, 1) == REDISMODULE_ERR ||
+      RedisModule_SubscribeToKeyspaceEvents(ctx, REDISMODULE_NOTIFY_GENERIC | REDISMODULE_NOTIFY_HASH | REDISMODULE_NOTIFY_EXPIRED | REDISMODULE_NOTIFY_EVICTED, onKeyspaceEvent) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  return REDISMODULE_OK;
+}
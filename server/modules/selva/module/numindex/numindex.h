@@ -0,0 +1,47 @@
+#pragma once
+#ifndef SELVA_NUMINDEX
+#define SELVA_NUMINDEX
+
+#include <stddef.h>
+
+#include "../id/intern.h"
+
+// Ordered indexes of the fields declared NUMERIC in the search indexes of
+// the schema. An index is built from the type index the first time it's
+// used and kept up to date by selva.modify and selva.delete after that.
+// Writes made with plain hash commands are picked up from the keyspace
+// events, and the indexes are dropped when the hierarchy they follow is
+// flushed or loaded. Nodes that are in neither the index nor the type
+// index, e.g. written by Lua before the index was built, are read by
+// SelvaNumIndex_Has() when they're first looked up.
+
+// Return non-zero to stop the scan
+typedef int (*SelvaNumIndex_ScanCallback)(Selva_NodeHandle handle, double value, void *arg);
+
+// Set the indexed value of a field of a node, or remove it if value is NULL or not a number.
+// Writes to indexes that haven't been built yet are ignored.
+void SelvaNumIndex_Update(const char *id_str, size_t id_len, const char *field_str, size_t field_len, RedisModuleString *value);
+void SelvaNumIndex_DelNode(const char *id_str, size_t id_len);
+
+// Drop every index, e.g. when the schema changes
+void SelvaNumIndex_Clear(void);
+
+// Build the index of field if needed. Returns the number of indexed nodes,
+// or -1 if the field isn't NUMERIC in the schema.
+long long SelvaNumIndex_Open(RedisModuleCtx *ctx, const char *field_str, size_t field_len);
+
+// Returns 1 if the node has a value in an open index. A node the index
+// doesn't know yet is read and added to it first.
+int SelvaNumIndex_Has(RedisModuleCtx *ctx, const char *field_str, size_t field_len, const char *id_str, size_t id_len);
+
+// Visit the nodes with min <= value <= max of an open index in (value, id) order, or in reverse if rev.
+// Returns -1 if the index isn't open.
+int SelvaNumIndex_Scan(const char *field_str, size_t field_len, double min, double max, int rev, SelvaNumIndex_ScanCallback cb, void *arg);
+
+// Like SelvaNumIndex_Scan() but from the first node after (value, id) in the order of the scan.
+// The node itself doesn't need to be in the index anymore.
+int SelvaNumIndex_ScanAfter(const char *field_str, size_t field_len, double value, const Selva_NodeId id, int rev, SelvaNumIndex_ScanCallback cb, void *arg);
+
+int SelvaNumIndex_OnLoad(RedisModuleCtx *ctx);
+
+#endif /* SELVA_NUMINDEX */
@@ -0,0 +1,178 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../redismodule.h"
+#include "./skiplist.h"
+
+static struct SelvaSkiplist_Node *newNode(int level, double value, Selva_NodeHandle handle) {
+  struct SelvaSkiplist_Node *node = RedisModule_Calloc(1, sizeof(struct SelvaSkiplist_Node) + level * sizeof(struct SelvaSkiplist_Node *));
+
+  node->value = value;
+  node->handle = handle;
+  node->level = level;
+
+  return node;
+}
+
+struct SelvaSkiplist *SelvaSkiplist_New(void) {
+  struct SelvaSkiplist *sl = RedisModule_Calloc(1, sizeof(struct SelvaSkiplist));
+
+  sl->head = newNode(SELVA_SKIPLIST_MAX_LEVEL, 0, SELVA_NODE_HANDLE_NONE);
+  sl->level = 1;
+
+  return sl;
+}
+
+void SelvaSkiplist_Free(struct SelvaSkiplist *sl) {
+  struct SelvaSkiplist_Node *node = sl->head;
+
+  while (node) {
+    struct SelvaSkiplist_Node *next = node->next[0];
+
+    RedisModule_Free(node);
+    node = next;
+  }
+  RedisModule_Free(sl);
+}
+
+// Each level has a 1/4 chance of being promoted like in the Redis zset
+static int randomLevel(void) {
+  int level = 1;
+
+  while (level < SELVA_SKIPLIST_MAX_LEVEL && (random() & 0xffff) < 0xffff / 4) {
+    level++;
+  }
+
+  return level;
+}
+
+static inline int compareKey(const struct SelvaSkiplist_Node *node, double value, const char *id) {
+  if (node->value != value) {
+    return node->value < value ? -1 : 1;
+  }
+
+  return memcmp(SelvaId_GetId(node->handle), id, SELVA_NODE_ID_SIZE);
+}
+
+struct SelvaSkiplist_Node *SelvaSkiplist_Insert(struct SelvaSkiplist *sl, double value, Selva_NodeHandle handle) {
+  struct SelvaSkiplist_Node *update[SELVA_SKIPLIST_MAX_LEVEL];
+  struct SelvaSkiplist_Node *x = sl->head;
+  const char *id = SelvaId_GetId(handle);
+
+  for (int i = sl->level - 1; i >= 0; i--) {
+    while (x->next[i] && compareKey(x->next[i], value, id) < 0) {
+      x = x->next[i];
+    }
+    update[i] = x;
+  }
+
+  const int level = randomLevel();
+  if (level > sl->level) {
+    for (int i = sl->level; i < level; i++) {
+      update[i] = sl->head;
+    }
+    sl->level = level;
+  }
+
+  struct SelvaSkiplist_Node *node = newNode(level, value, handle);
+  for (int i = 0; i < level; i++) {
+    node->next[i] = update[i]->next[i];
+    update[i]->next[i] = node;
+  }
+
+  node->prev = update[0] == sl->head ? NULL : update[0];
+  if (node->next[0]) {
+    node->next[0]->prev = node;
+  } else {
+    sl->tail = node;
+  }
+  sl->len++;
+
+  return node;
+}
+
+int SelvaSkiplist_Delete(struct SelvaSkiplist *sl, double value, Selva_NodeHandle handle) {
+  struct SelvaSkiplist_Node *update[SELVA_SKIPLIST_MAX_LEVEL];
+  struct SelvaSkiplist_Node *x = sl->head;
+  const char *id = SelvaId_GetId(handle);
+
+  for (int i = sl->level - 1; i >= 0; i--) {
+    while (x->next[i] && compareKey(x->next[i], value, id) < 0) {
+      x = x->next[i];
+    }
+    update[i] = x;
+  }
+
+  x = x->next[0];
+  if (!x || x->value != value || x->handle != handle) {
+    return 0;
+  }
+
+  for (int i = 0; i < sl->level; i++) {
+    if (update[i]->next[i] == x) {
+      update[i]->next[i] = x->next[i];
+    }
+  }
+
+  if (x->next[0]) {
+    x->next[0]->prev = x->prev;
+  } else {
+    sl->tail = x->prev;
+  }
+
+  while (sl->level > 1 && !sl->head->next[sl->level - 1]) {
+    sl->level--;
+  }
+  sl->len--;
+  RedisModule_Free(x);
+
+  return 1;
+}
+
+struct SelvaSkiplist_Node *SelvaSkiplist_First(const struct SelvaSkiplist *sl, double min) {
+  struct SelvaSkiplist_Node *x = sl->head;
+
+  for (int i = sl->level - 1; i >= 0; i--) {
+    while (x->next[i] && x->next[i]->value < min) {
+      x = x->next[i];
+    }
+  }
+
+  return x->next[0];
+}
+
+struct SelvaSkiplist_Node *SelvaSkiplist_Last(const struct SelvaSkiplist *sl, double max) {
+  struct SelvaSkiplist_Node *x = sl->head;
+
+  for (int i = sl->level - 1; i >= 0; i--) {
+    while (x->next[i] && x->next[i]->value <= max) {
+      x = x->next[i];
+    }
+  }
+
+  return x == sl->head ? NULL : x;
+}
+
+struct SelvaSkiplist_Node *SelvaSkiplist_After(const struct SelvaSkiplist *sl, double value, const Selva_NodeId id) {
+  struct SelvaSkiplist_Node *x = sl->head;
+
+  for (int i = sl->level - 1; i >= 0; i--) {
+    while (x->next[i] && compareKey(x->next[i], value, id) <= 0) {
+      x = x->next[i];
+    }
+  }
+
+  return x->next[0];
+}
+
+struct SelvaSkiplist_Node *SelvaSkiplist_Before(const struct SelvaSkiplist *sl, double value, const Selva_NodeId id) {
+  struct SelvaSkiplist_Node *x = sl->head;
+
+  for (int i = sl->level - 1; i >= 0; i--) {
+    while (x->next[i] && compareKey(x->next[i], value, id) < 0) {
+      x = x->next[i];
+    }
+  }
+
+  return x == sl->head ? NULL : x;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#ifndef SELVA_SKIPLIST
+#define SELVA_SKIPLIST
+
+#include <stddef.h>
+
+#include "../id/intern.h"
+
+#define SELVA_SKIPLIST_MAX_LEVEL 32
+
+// Entries are ordered by (value, node id), so every entry is unique and
+// nodes with equal values come out in a stable order that a cursor of
+// (value, id) can resume from.
+struct SelvaSkiplist_Node {
+  double value;
+  Selva_NodeHandle handle;
+  // The previous entry for reverse scans, NULL for the first one
+  struct SelvaSkiplist_Node *prev;
+  int level;
+  struct SelvaSkiplist_Node *next[];
+};
+
+struct SelvaSkiplist {
+  // The sentinel before the first entry, with every level
+  struct SelvaSkiplist_Node *head;
+  struct SelvaSkiplist_Node *tail;
+  int level;
+  size_t len;
+};
+
+struct SelvaSkiplist *SelvaSkiplist_New(void);
+void SelvaSkiplist_Free(struct SelvaSkiplist *sl);
+
+struct SelvaSkiplist_Node *SelvaSkiplist_Insert(struct SelvaSkiplist *sl, double value, Selva_NodeHandle handle);
+// Returns 0 if the entry wasn't found
+int SelvaSkiplist_Delete(struct SelvaSkiplist *sl, double value, Selva_NodeHandle handle);
+
+// The first entry with a value >= min, or NULL
+struct SelvaSkiplist_Node *SelvaSkiplist_First(const struct SelvaSkiplist *sl, double min);
+// The last entry with a value <= max, or NULL
+struct SelvaSkiplist_Node *SelvaSkiplist_Last(const struct SelvaSkiplist *sl, double max);
+// The first entry after (value, id), or NULL
+struct SelvaSkiplist_Node *SelvaSkiplist_After(const struct SelvaSkiplist *sl, double value, const Selva_NodeId id);
+// The last entry before (value, id), or NULL
+struct SelvaSkiplist_Node *SelvaSkiplist_Before(const struct SelvaSkiplist *sl, double value, const Selva_NodeId id);
+
+static inline struct SelvaSkiplist_Node *SelvaSkiplist_Next(const struct SelvaSkiplist_Node *node) {
+  return node->next[0];
+}
+
+static inline struct SelvaSkiplist_Node *SelvaSkiplist_Prev(const struct SelvaSkiplist_Node *node) {
+  return node->prev;
+}
+
+#endif /* SELVA_SKIPLIST */
@@ -0,0 +1,95 @@
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "../../redismodule.h"
+#include "./json.h"
+
+// 0 if the byte is copied as is, otherwise the character after the backslash
+static const char escapes[256] = {
+  ['\b'] = 'b', ['\t'] = 't', ['\n'] = 'n', ['\f'] = 'f', ['\r'] = 'r',
+  [0x00] = 'u', [0x01] = 'u', [0x02] = 'u', [0x03] = 'u', [0x04] = 'u', [0x05] = 'u', [0x06] = 'u', [0x07] = 'u',
+  [0x0b] = 'u', [0x0e] = 'u', [0x0f] = 'u',
+  [0x10] = 'u', [0x11] = 'u', [0x12] = 'u', [0x13] = 'u', [0x14] = 'u', [0x15] = 'u', [0x16] = 'u', [0x17] = 'u',
+  [0x18] = 'u', [0x19] = 'u', [0x1a] = 'u', [0x1b] = 'u', [0x1c] = 'u', [0x1d] = 'u', [0x1e] = 'u', [0x1f] = 'u',
+  ['"'] = '"', ['\\'] = '\\',
+};
+
+sds SelvaJsonReply_New(size_t size_hint) {
+  return sdsMakeRoomFor(sdsempty(), size_hint);
+}
+
+// Length of the prefix of str that needs no escaping
+static size_t plainLen(const char *str, size_t len) {
+  size_t i = 0;
+
+#ifdef __SSE2__
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i ctrl_max = _mm_set1_epi8(0x1f);
+
+  for (; i + 16 <= len; i += 16) {
+    const __m128i v = _mm_loadu_si128((const __m128i *)(str + i));
+    // An unsigned byte is a control character if max(byte, 0x1f) == 0x1f
+    const __m128i special = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+        _mm_cmpeq_epi8(_mm_max_epu8(v, ctrl_max), ctrl_max));
+    const int mask = _mm_movemask_epi8(special);
+
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+#endif
+
+  while (i < len && !escapes[(unsigned char)str[i]]) {
+    i++;
+  }
+
+  return i;
+}
+
+static sds appendEscaped(sds s, unsigned char c) {
+  static const char hex[] = "0123456789abcdef";
+  char esc[6] = { '\\', escapes[c] };
+
+  if (esc[1] != 'u') {
+    return sdscatlen(s, esc, 2);
+  }
+
+  esc[2] = '0';
+  esc[3] = '0';
+  esc[4] = hex[c >> 4];
+  esc[5] = hex[c & 0xf];
+
+  return sdscatlen(s, esc, 6);
+}
+
+sds SelvaJsonReply_AppendString(sds s, const char *str, size_t len) {
+  s = sdsMakeRoomFor(s, len + 2);
+  s = sdscatlen(s, "\"", 1);
+
+  for (;;) {
+    const size_t n = plainLen(str, len);
+
+    s = sdscatlen(s, str, n);
+    if (n == len) {
+      break;
+    }
+
+    s = appendEscaped(s, str[n]);
+    str += n + 1;
+    len -= n + 1;
+  }
+
+  return sdscatlen(s, "\"", 1);
+}
+
+int SelvaJsonReply_Send(RedisModuleCtx *ctx, sds s) {
+  const int err = RedisModule_ReplyWithStringBuffer(ctx, s, sdslen(s));
+
+  sdsfree(s);
+
+  return err;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#ifndef SELVA_REPLY_JSON
+#define SELVA_REPLY_JSON
+
+#include <stddef.h>
+#include "../../rmutil/sds.h"
+
+// Start a reply of about size_hint bytes so that it's built without regrowing
+sds SelvaJsonReply_New(size_t size_hint);
+
+static inline sds SelvaJsonReply_AppendRaw(sds s, const char *str, size_t len) {
+  return sdscatlen(s, str, len);
+}
+
+// Append str as a quoted and escaped JSON string. str is expected to be UTF-8
+// and only the characters JSON requires are escaped.
+sds SelvaJsonReply_AppendString(sds s, const char *str, size_t len);
+
+// Reply with the buffer as a single bulk string and free it
+int SelvaJsonReply_Send(RedisModuleCtx *ctx, sds s);
+
+#endif /* SELVA_REPLY_JSON */
@@ -0,0 +1,192 @@
+#include <string.h>
+
+#include "../../redismodule.h"
+#include "./json.h"
+
+struct parser {
+  const char *js;
+  size_t len;
+  size_t pos;
+  struct SelvaJson_Token *tokens;
+  int nr_tokens;
+  int cap;
+  int depth;
+};
+
+static int newToken(struct parser *p, enum SelvaJson_Type type, int start) {
+  if (p->nr_tokens == p->cap) {
+    p->cap = p->cap ? 2 * p->cap : 64;
+    p->tokens = RedisModule_Realloc(p->tokens, p->cap * sizeof(struct SelvaJson_Token));
+  }
+
+  struct SelvaJson_Token *t = &p->tokens[p->nr_tokens];
+  t->type = type;
+  t->start = start;
+  t->end = start;
+  t->size = 0;
+
+  return p->nr_tokens++;
+}
+
+static void skipSpace(struct parser *p) {
+  while (p->pos < p->len && p->js[p->pos] && strchr(" \t\r\n", p->js[p->pos])) {
+    p->pos++;
+  }
+}
+
+static int parseValue(struct parser *p);
+
+static int parseString(struct parser *p) {
+  const int start = ++p->pos;
+
+  while (p->pos < p->len && p->js[p->pos] != '"') {
+    if (p->js[p->pos] == '\\') {
+      p->pos++;
+    }
+    p->pos++;
+  }
+
+  if (p->pos >= p->len) {
+    return -1;
+  }
+
+  int i = newToken(p, SELVA_JSON_STRING, start);
+  p->tokens[i].end = p->pos++;
+
+  return i;
+}
+
+static int parseContainer(struct parser *p, enum SelvaJson_Type type) {
+  const char close = type == SELVA_JSON_OBJECT ? '}' : ']';
+
+  if (++p->depth > SELVA_JSON_MAX_DEPTH) {
+    return -1;
+  }
+
+  int i = newToken(p, type, p->pos++);
+
+  skipSpace(p);
+  if (p->pos < p->len && p->js[p->pos] == close) {
+    p->tokens[i].end = ++p->pos;
+    p->depth--;
+    return i;
+  }
+
+  for (;;) {
+    skipSpace(p);
+
+    if (type == SELVA_JSON_OBJECT) {
+      if (p->pos >= p->len || p->js[p->pos] != '"' || parseString(p) < 0) {
+        return -1;
+      }
+
+      skipSpace(p);
+      if (p->pos >= p->len || p->js[p->pos++] != ':') {
+        return -1;
+      }
+    }
+
+    if (parseValue(p) < 0) {
+      return -1;
+    }
+    p->tokens[i].size++;
+
+    skipSpace(p);
+    if (p->pos >= p->len) {
+      return -1;
+    }
+
+    char c = p->js[p->pos++];
+    if (c == close) {
+      break;
+    } else if (c != ',') {
+      return -1;
+    }
+  }
+
+  p->tokens[i].end = p->pos;
+  p->depth--;
+  return i;
+}
+
+static int parseValue(struct parser *p) {
+  skipSpace(p);
+  if (p->pos >= p->len) {
+    return -1;
+  }
+
+  switch (p->js[p->pos]) {
+    case '{':
+      return parseContainer(p, SELVA_JSON_OBJECT);
+    case '[':
+      return parseContainer(p, SELVA_JSON_ARRAY);
+    case '"':
+      return parseString(p);
+    default: {
+      const int start = p->pos;
+
+      while (p->pos < p->len && p->js[p->pos] && !strchr(" \t\r\n,:]}", p->js[p->pos])) {
+        p->pos++;
+      }
+
+      if (p->pos == (size_t)start) {
+        return -1;
+      }
+
+      int i = newToken(p, SELVA_JSON_PRIMITIVE, start);
+      p->tokens[i].end = p->pos;
+      return i;
+    }
+  }
+}
+
+struct SelvaJson_Token *SelvaJson_Parse(const char *js, size_t len, int *nr_tokens) {
+  struct parser p = {
+    .js = js,
+    .len = len,
+  };
+
+  if (parseValue(&p) < 0) {
+    RedisModule_Free(p.tokens);
+    return NULL;
+  }
+
+  *nr_tokens = p.nr_tokens;
+  return p.tokens;
+}
+
+void SelvaJson_Free(struct SelvaJson_Token *tokens) {
+  RedisModule_Free(tokens);
+}
+
+int SelvaJson_Next(const struct SelvaJson_Token *tokens, int nr_tokens, int i) {
+  const int end = tokens[i].end;
+
+  for (i++; i < nr_tokens && tokens[i].start < end; i++);
+
+  return i;
+}
+
+int SelvaJson_StrEq(const char *js, const struct SelvaJson_Token *token, const char *str) {
+  const size_t len = token->end - token->start;
+
+  return token->type == SELVA_JSON_STRING && strlen(str) == len && !memcmp(js + token->start, str, len);
+}
+
+int SelvaJson_ObjectGet(const char *js, const struct SelvaJson_Token *tokens, int nr_tokens, int obj, const char *key) {
+  if (obj < 0 || obj >= nr_tokens || tokens[obj].type != SELVA_JSON_OBJECT) {
+    return -1;
+  }
+
+  int i = obj + 1;
+  for (int n = 0; n < tokens[obj].size; n++) {
+    int value = i + 1;
+
+    if (SelvaJson_StrEq(js, &tokens[i], key)) {
+      return value;
+    }
+    i = SelvaJson_Next(tokens, nr_tokens, value);
+  }
+
+  return -1;
+}
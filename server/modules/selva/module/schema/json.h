@@ -0,0 +1,39 @@
+#pragma once
+#ifndef SELVA_SCHEMA_JSON
+#define SELVA_SCHEMA_JSON
+
+#include <stddef.h>
+
+enum SelvaJson_Type {
+  SELVA_JSON_OBJECT,
+  SELVA_JSON_ARRAY,
+  SELVA_JSON_STRING,
+  SELVA_JSON_PRIMITIVE
+};
+
+// Tokens point into the parsed buffer and are stored in document order.
+// Strings are not unescaped; start and end exclude the quotes.
+struct SelvaJson_Token {
+  enum SelvaJson_Type type;
+  int start;
+  int end;
+  // Number of keys in an object or elements in an array
+  int size;
+};
+
+// Deeper nesting is rejected so that the parser and the walkers built on the
+// token tree can't exhaust the stack.
+#define SELVA_JSON_MAX_DEPTH 64
+
+struct SelvaJson_Token *SelvaJson_Parse(const char *js, size_t len, int *nr_tokens);
+void SelvaJson_Free(struct SelvaJson_Token *tokens);
+
+// Index of the token following i and all of its children
+int SelvaJson_Next(const struct SelvaJson_Token *tokens, int nr_tokens, int i);
+
+int SelvaJson_StrEq(const char *js, const struct SelvaJson_Token *token, const char *str);
+
+// Index of the value of key in the object at obj, or -1
+int SelvaJson_ObjectGet(const char *js, const struct SelvaJson_Token *tokens, int nr_tokens, int obj, const char *key);
+
+#endif /* SELVA_SCHEMA_JSON */
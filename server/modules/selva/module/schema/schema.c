@@ -0,0 +1,405 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "../../redismodule.h"
+#include "../hierarchy/hierarchy.h"
+#include "../numindex/numindex.h"
+#include "./json.h"
+#include "./schema.h"
+
+static struct SelvaSchema *schema;
+
+struct SelvaSchema *SelvaSchema_Get(void) {
+  return schema;
+}
+
+static void freeStrList(struct SelvaSchema_StrList *list) {
+  for (size_t i = 0; i < list->nr; i++) {
+    RedisModule_Free(list->strs[i]);
+  }
+  RedisModule_Free(list->strs);
+}
+
+static void freeSchema(struct SelvaSchema *s) {
+  if (s) {
+    for (unsigned int i = 0; i < s->nr_types; i++) {
+      freeStrList(&s->sug_fields[i]);
+    }
+    freeStrList(&s->languages);
+    for (size_t i = 0; i < s->nr_search_indexes; i++) {
+      RedisModule_Free(s->search_indexes[i].name);
+      RedisModule_FreeDict(NULL, s->search_indexes[i].fields);
+    }
+    RedisModule_Free(s->search_indexes);
+    RedisModule_Free(s->ancestry_rules);
+    RedisModule_Free(s);
+  }
+}
+
+static void strListAdd(struct SelvaSchema_StrList *list, const char *str, size_t len) {
+  char *dup = RedisModule_Alloc(len + 1);
+
+  memcpy(dup, str, len);
+  dup[len] = '\0';
+  list->strs = RedisModule_Realloc(list->strs, (list->nr + 1) * sizeof(char *));
+  list->strs[list->nr++] = dup;
+}
+
+static unsigned int findTypeByName(const char *js, const struct SelvaJson_Token *tokens, int nr_tokens, int types, const struct SelvaJson_Token *name) {
+  const size_t len = name->end - name->start;
+  int i = types + 1;
+
+  if (len == 4 && !memcmp(js + name->start, "root", 4)) {
+    return SCHEMA_TYPE_ROOT;
+  }
+
+  for (int n = 0; n < tokens[types].size; n++) {
+    if ((size_t)(tokens[i].end - tokens[i].start) == len && !memcmp(js + tokens[i].start, js + name->start, len)) {
+      return SCHEMA_TYPE_ROOT + 1 + n;
+    }
+    i = SelvaJson_Next(tokens, nr_tokens, i + 1);
+  }
+
+  return SCHEMA_TYPE_UNKNOWN;
+}
+
+static void compileRule(struct SelvaSchema_AncestryRule *rule, const char *js, const struct SelvaJson_Token *tokens, int nr_tokens, int types, int value) {
+  const struct SelvaJson_Token *t = &tokens[value];
+  int list;
+
+  memset(rule, 0, sizeof(*rule));
+
+  if (t->type == SELVA_JSON_PRIMITIVE && t->end - t->start == 5 && !memcmp(js + t->start, "false", 5)) {
+    rule->type = SELVA_SCHEMA_ANCESTRY_NONE;
+    return;
+  }
+
+  if ((list = SelvaJson_ObjectGet(js, tokens, nr_tokens, value, "includeAncestryWith")) >= 0) {
+    rule->type = SELVA_SCHEMA_ANCESTRY_INCLUDE;
+  } else if ((list = SelvaJson_ObjectGet(js, tokens, nr_tokens, value, "excludeAncestryWith")) >= 0) {
+    rule->type = SELVA_SCHEMA_ANCESTRY_EXCLUDE;
+  } else {
+    rule->type = SELVA_SCHEMA_ANCESTRY_ALL;
+    return;
+  }
+
+  if (tokens[list].type != SELVA_JSON_ARRAY) {
+    return;
+  }
+
+  for (int i = list + 1, n = 0; n < tokens[list].size; n++, i = SelvaJson_Next(tokens, nr_tokens, i)) {
+    unsigned int type = findTypeByName(js, tokens, nr_tokens, types, &tokens[i]);
+
+    if (type != SCHEMA_TYPE_UNKNOWN) {
+      rule->types[type / 64] |= UINT64_C(1) << (type % 64);
+    }
+  }
+}
+
+static int isTimestampField(const char *js, const struct SelvaJson_Token *tokens, int nr_tokens, int fields, const char *name) {
+  const int field = SelvaJson_ObjectGet(js, tokens, nr_tokens, fields, name);
+  const int type = SelvaJson_ObjectGet(js, tokens, nr_tokens, field, "type");
+
+  return type >= 0 && SelvaJson_StrEq(js, &tokens[type], "timestamp");
+}
+
+static uint8_t compileTypeFlags(const char *js, const struct SelvaJson_Token *tokens, int nr_tokens, int type) {
+  const int fields = SelvaJson_ObjectGet(js, tokens, nr_tokens, type, "fields");
+  uint8_t flags = 0;
+
+  if (isTimestampField(js, tokens, nr_tokens, fields, "createdAt")) {
+    flags |= SELVA_SCHEMA_TYPE_CREATED_AT;
+  }
+  if (isTimestampField(js, tokens, nr_tokens, fields, "updatedAt")) {
+    flags |= SELVA_SCHEMA_TYPE_UPDATED_AT;
+  }
+
+  return flags;
+}
+
+static int isSugField(const char *js, const struct SelvaJson_Token *tokens, int nr_tokens, int field) {
+  const int type = SelvaJson_ObjectGet(js, tokens, nr_tokens, field, "type");
+  const int search = SelvaJson_ObjectGet(js, tokens, nr_tokens, field, "search");
+  const int search_type = SelvaJson_ObjectGet(js, tokens, nr_tokens, search, "type");
+
+  return type >= 0 && SelvaJson_StrEq(js, &tokens[type], "text") &&
+    search_type >= 0 && tokens[search_type].type == SELVA_JSON_ARRAY && tokens[search_type].size > 0 &&
+    SelvaJson_StrEq(js, &tokens[search_type + 1], "TEXT-LANGUAGE-SUG");
+}
+
+// Collect the suggestion fields of a fields object, descending into object properties
+static void compileSugFields(struct SelvaSchema_StrList *list, char *path, size_t path_len, const char *js, const struct SelvaJson_Token *tokens, int nr_tokens, int fields) {
+  if (fields < 0 || tokens[fields].type != SELVA_JSON_OBJECT) {
+    return;
+  }
+
+  for (int i = fields + 1, n = 0; n < tokens[fields].size; n++) {
+    const int value = i + 1;
+    const size_t name_len = tokens[i].end - tokens[i].start;
+    size_t len = path_len;
+
+    if (len + 1 + name_len < SCHEMA_MAX_PATH_LEN) {
+      if (len > 0) {
+        path[len++] = '.';
+      }
+      memcpy(path + len, js + tokens[i].start, name_len);
+      len += name_len;
+
+      if (isSugField(js, tokens, nr_tokens, value)) {
+        strListAdd(list, path, len);
+      }
+      compileSugFields(list, path, len, js, tokens, nr_tokens, SelvaJson_ObjectGet(js, tokens, nr_tokens, value, "properties"));
+    }
+    i = SelvaJson_Next(tokens, nr_tokens, value);
+  }
+}
+
+static void compileSearch(struct SelvaSchema *s, unsigned int type, const char *js, const struct SelvaJson_Token *tokens, int nr_tokens, int type_value) {
+  char path[SCHEMA_MAX_PATH_LEN];
+
+  compileSugFields(&s->sug_fields[type], path, 0, js, tokens, nr_tokens, SelvaJson_ObjectGet(js, tokens, nr_tokens, type_value, "fields"));
+}
+
+// Compile the hierarchy rules of a type into a row of the rule table.
+// Explicit parent type rules take precedence over $default.
+static void compileHierarchy(struct SelvaSchema *s, unsigned int child_type, const char *js, const struct SelvaJson_Token *tokens, int nr_tokens, int types, int hierarchy) {
+  struct SelvaSchema_AncestryRule *row = &s->ancestry_rules[child_type * s->nr_types];
+  int def;
+
+  if (hierarchy < 0 || tokens[hierarchy].type != SELVA_JSON_OBJECT) {
+    return;
+  }
+
+  // $default: false is no rule, unlike false for a parent type
+  if ((def = SelvaJson_ObjectGet(js, tokens, nr_tokens, hierarchy, "$default")) >= 0) {
+    compileRule(&row[0], js, tokens, nr_tokens, types, def);
+    if (row[0].type == SELVA_SCHEMA_ANCESTRY_NONE) {
+      row[0].type = SELVA_SCHEMA_ANCESTRY_ALL;
+    }
+    for (unsigned int i = 1; i < s->nr_types; i++) {
+      row[i] = row[0];
+    }
+  }
+
+  for (int i = hierarchy + 1, n = 0; n < tokens[hierarchy].size; n++) {
+    const int value = i + 1;
+
+    if (!SelvaJson_StrEq(js, &tokens[i], "$default")) {
+      unsigned int parent_type = findTypeByName(js, tokens, nr_tokens, types, &tokens[i]);
+      struct SelvaSchema_AncestryRule rule;
+
+      // A parent type rule that doesn't filter falls back to $default
+      compileRule(&rule, js, tokens, nr_tokens, types, value);
+      if (parent_type != SCHEMA_TYPE_UNKNOWN && rule.type != SELVA_SCHEMA_ANCESTRY_ALL) {
+        row[parent_type] = rule;
+      }
+    }
+    i = SelvaJson_Next(tokens, nr_tokens, value);
+  }
+}
+
+static struct SelvaSchema *compileSchema(const char *js, size_t len) {
+  struct SelvaJson_Token *tokens;
+  struct SelvaSchema *s;
+  int nr_tokens;
+  int types;
+
+  tokens = SelvaJson_Parse(js, len, &nr_tokens);
+  if (!tokens) {
+    return NULL;
+  }
+
+  types = SelvaJson_ObjectGet(js, tokens, nr_tokens, 0, "types");
+  if (types < 0 || tokens[types].type != SELVA_JSON_OBJECT ||
+      tokens[types].size > SCHEMA_MAX_TYPES - SCHEMA_TYPE_ROOT - 1) {
+    SelvaJson_Free(tokens);
+    return NULL;
+  }
+
+  s = RedisModule_Calloc(1, sizeof(struct SelvaSchema));
+  s->nr_types = SCHEMA_TYPE_ROOT + 1 + tokens[types].size;
+  s->ancestry_rules = RedisModule_Calloc(s->nr_types * s->nr_types, sizeof(struct SelvaSchema_AncestryRule));
+  s->type_flags[SCHEMA_TYPE_ROOT] = compileTypeFlags(js, tokens, nr_tokens, SelvaJson_ObjectGet(js, tokens, nr_tokens, 0, "rootType"));
+  compileSearch(s, SCHEMA_TYPE_ROOT, js, tokens, nr_tokens, SelvaJson_ObjectGet(js, tokens, nr_tokens, 0, "rootType"));
+
+  const int languages = SelvaJson_ObjectGet(js, tokens, nr_tokens, 0, "languages");
+  if (languages >= 0 && tokens[languages].type == SELVA_JSON_ARRAY) {
+    for (int i = languages + 1, n = 0; n < tokens[languages].size; n++, i = SelvaJson_Next(tokens, nr_tokens, i)) {
+      if (tokens[i].type == SELVA_JSON_STRING) {
+        strListAdd(&s->languages, js + tokens[i].start, tokens[i].end - tokens[i].start);
+      }
+    }
+  }
+
+  for (int i = types + 1, n = 0; n < tokens[types].size; n++) {
+    const unsigned int type = SCHEMA_TYPE_ROOT + 1 + n;
+    const int value = i + 1;
+    int prefix = SelvaJson_ObjectGet(js, tokens, nr_tokens, value, "prefix");
+
+    if (prefix >= 0 && tokens[prefix].end - tokens[prefix].start == 2) {
+      const char *p = js + tokens[prefix].start;
+
+      s->prefix_to_type[(uint8_t)p[0] << 8 | (uint8_t)p[1]] = type;
+    }
+
+    s->type_flags[type] = compileTypeFlags(js, tokens, nr_tokens, value);
+    compileSearch(s, type, js, tokens, nr_tokens, value);
+    compileHierarchy(s, type, js, tokens, nr_tokens, types, SelvaJson_ObjectGet(js, tokens, nr_tokens, value, "hierarchy"));
+    i = SelvaJson_Next(tokens, nr_tokens, value);
+  }
+
+  SelvaJson_Free(tokens);
+  return s;
+}
+
+static unsigned int compileSearchField(const char *js, const struct SelvaJson_Token *tokens, int nr_tokens, int value) {
+  unsigned int flags = 0;
+
+  if (tokens[value].type != SELVA_JSON_ARRAY || tokens[value].size == 0) {
+    return 0;
+  }
+
+  for (int i = value + 1, n = 0; n < tokens[value].size; n++, i = SelvaJson_Next(tokens, nr_tokens, i)) {
+    if (SelvaJson_StrEq(js, &tokens[i], "EXISTS")) {
+      flags |= SELVA_SCHEMA_SEARCH_EXISTS;
+    }
+  }
+
+  if (SelvaJson_StrEq(js, &tokens[value + 1], "TEXT-LANGUAGE") || SelvaJson_StrEq(js, &tokens[value + 1], "TEXT-LANGUAGE-SUG")) {
+    flags |= SELVA_SCHEMA_SEARCH_TEXT;
+  } else if (!SelvaJson_StrEq(js, &tokens[value + 1], "EXISTS")) {
+    flags |= SELVA_SCHEMA_SEARCH_VALUE;
+  }
+
+  if (SelvaJson_StrEq(js, &tokens[value + 1], "NUMERIC")) {
+    flags |= SELVA_SCHEMA_SEARCH_NUMERIC;
+  }
+
+  return flags;
+}
+
+// Compile the searchIndexes of the schema: { index: { field: [type, options...] } }
+static void compileSearchIndexes(struct SelvaSchema *s, const char *js, size_t len) {
+  struct SelvaJson_Token *tokens;
+  int nr_tokens;
+
+  tokens = SelvaJson_Parse(js, len, &nr_tokens);
+  if (!tokens) {
+    return;
+  }
+
+  if (tokens[0].type == SELVA_JSON_OBJECT) {
+    s->search_indexes = RedisModule_Calloc(tokens[0].size + 1, sizeof(struct SelvaSchema_SearchIndex));
+
+    for (int i = 1, n = 0; n < tokens[0].size; n++) {
+      const int index = i + 1;
+
+      if (tokens[index].type == SELVA_JSON_OBJECT) {
+        struct SelvaSchema_SearchIndex *si = &s->search_indexes[s->nr_search_indexes++];
+        const size_t name_len = tokens[i].end - tokens[i].start;
+
+        si->name = RedisModule_Alloc(name_len + 1);
+        memcpy(si->name, js + tokens[i].start, name_len);
+        si->name[name_len] = '\0';
+        si->fields = RedisModule_CreateDict(NULL);
+
+        for (int j = index + 1, m = 0; m < tokens[index].size; m++) {
+          const int value = j + 1;
+          const unsigned int flags = compileSearchField(js, tokens, nr_tokens, value);
+
+          if (flags) {
+            RedisModule_DictSetC(si->fields, (void *)(js + tokens[j].start), tokens[j].end - tokens[j].start, (void *)(uintptr_t)flags);
+          }
+          j = SelvaJson_Next(tokens, nr_tokens, value);
+        }
+      }
+      i = SelvaJson_Next(tokens, nr_tokens, index);
+    }
+  }
+
+  SelvaJson_Free(tokens);
+}
+
+int SelvaSchema_Load(RedisModuleCtx *ctx) {
+  RedisModuleString *key_name = RedisModule_CreateString(ctx, SCHEMA_KEY, sizeof(SCHEMA_KEY) - 1);
+  RedisModuleKey *key = RedisModule_OpenKey(ctx, key_name, REDISMODULE_READ);
+  RedisModuleString *types = NULL;
+  RedisModuleString *search_indexes = NULL;
+  struct SelvaSchema *new_schema;
+  size_t len;
+
+  if (RedisModule_KeyType(key) != REDISMODULE_KEYTYPE_HASH ||
+      RedisModule_HashGet(key, REDISMODULE_HASH_CFIELDS, "types", &types, NULL) == REDISMODULE_ERR ||
+      !types) {
+    RedisModule_CloseKey(key);
+    RedisModule_FreeString(ctx, key_name);
+    return REDISMODULE_ERR;
+  }
+
+  const char *js = RedisModule_StringPtrLen(types, &len);
+  new_schema = compileSchema(js, len);
+
+  RedisModule_HashGet(key, REDISMODULE_HASH_CFIELDS, "searchIndexes", &search_indexes, NULL);
+  if (new_schema && search_indexes) {
+    js = RedisModule_StringPtrLen(search_indexes, &len);
+    compileSearchIndexes(new_schema, js, len);
+  }
+  if (search_indexes) {
+    RedisModule_FreeString(ctx, search_indexes);
+  }
+
+  RedisModule_FreeString(ctx, types);
+  RedisModule_CloseKey(key);
+  RedisModule_FreeString(ctx, key_name);
+
+  if (!new_schema) {
+    return REDISMODULE_ERR;
+  }
+
+  freeSchema(schema);
+  schema = new_schema;
+  // The NUMERIC fields may have changed; indexes are rebuilt when they're used
+  SelvaNumIndex_Clear();
+
+  // Ancestors depend on the rules so everything must be recomputed
+  key_name = RedisModule_CreateString(ctx, HIERARCHY_DEFAULT_KEY, sizeof(HIERARCHY_DEFAULT_KEY) - 1);
+  key = RedisModule_OpenKey(ctx, key_name, REDISMODULE_READ | REDISMODULE_WRITE);
+  if (RedisModule_KeyType(key) == REDISMODULE_KEYTYPE_MODULE && RedisModule_ModuleTypeGetType(key) == HierarchyType) {
+    SelvaModify_Hierarchy *hierarchy = RedisModule_ModuleTypeGetValue(key);
+
+    if (hierarchy) {
+      SelvaModify_HierarchyMarkAllDirty(hierarchy);
+      SelvaModify_HierarchyRecompute(hierarchy);
+    }
+  }
+  RedisModule_CloseKey(key);
+  RedisModule_FreeString(ctx, key_name);
+
+  return REDISMODULE_OK;
+}
+
+// SELVA.SCHEMA.LOAD
+int SelvaCommand_SchemaLoad(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  if (argc != 1) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  if (SelvaSchema_Load(ctx) == REDISMODULE_ERR) {
+    return RedisModule_ReplyWithError(ctx, "ERR failed to load the schema");
+  }
+
+  RedisModule_ReplicateVerbatim(ctx);
+  return RedisModule_ReplyWithSimpleString(ctx, "OK");
+}
+
+int SelvaSchema_OnLoad(RedisModuleCtx *ctx) {
+  if (RedisModule_CreateCommand(ctx, "selva.schema.load", SelvaCommand_SchemaLoad, "write", 0, 0, 0) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  // The key exists already if the module is loaded at runtime, at startup
+  // the schema is loaded after the RDB, see Hierarchy_RDBLoad()
+  SelvaSchema_Load(ctx);
+
+  return REDISMODULE_OK;
+}
@@ -0,0 +1,110 @@
+#pragma once
+#ifndef SELVA_SCHEMA
+#define SELVA_SCHEMA
+
+#include <stdint.h>
+#include <string.h>
+
+#define SCHEMA_KEY "___selva_schema"
+#define SCHEMA_MAX_TYPES 256
+#define SCHEMA_MAX_PATH_LEN 256
+
+#define SCHEMA_TYPE_UNKNOWN 0
+#define SCHEMA_TYPE_ROOT 1
+
+// Type flags for the timestamp fields maintained by selva.modify
+#define SELVA_SCHEMA_TYPE_CREATED_AT 0x01
+#define SELVA_SCHEMA_TYPE_UPDATED_AT 0x02
+
+enum SelvaSchema_AncestryRuleType {
+  SELVA_SCHEMA_ANCESTRY_ALL = 0,
+  // The hierarchy rule is false; only root is inherited through the parent
+  SELVA_SCHEMA_ANCESTRY_NONE,
+  SELVA_SCHEMA_ANCESTRY_INCLUDE,
+  SELVA_SCHEMA_ANCESTRY_EXCLUDE,
+};
+
+struct SelvaSchema_AncestryRule {
+  enum SelvaSchema_AncestryRuleType type;
+  uint64_t types[SCHEMA_MAX_TYPES / 64];
+};
+
+struct SelvaSchema_StrList {
+  size_t nr;
+  char **strs;
+};
+
+// Search index field flags
+#define SELVA_SCHEMA_SEARCH_VALUE  0x01 // The value is indexed as is
+#define SELVA_SCHEMA_SEARCH_TEXT   0x02 // Indexed per language from ___escaped:<field>.<lang>
+#define SELVA_SCHEMA_SEARCH_EXISTS 0x04 // _exists_<field> is indexed as a tag
+#define SELVA_SCHEMA_SEARCH_NUMERIC 0x08 // Also kept in an ordered index by the module
+
+struct SelvaSchema_SearchIndex {
+  char *name;
+  // field -> flags
+  RedisModuleDict *fields;
+};
+
+struct SelvaSchema {
+  unsigned int nr_types;
+  // Type index by the first two bytes of a node id
+  uint8_t prefix_to_type[1 << 16];
+  uint8_t type_flags[SCHEMA_MAX_TYPES];
+  // Dotted paths of the text fields of each type indexed as TEXT-LANGUAGE-SUG
+  struct SelvaSchema_StrList sug_fields[SCHEMA_MAX_TYPES];
+  struct SelvaSchema_StrList languages;
+  size_t nr_search_indexes;
+  struct SelvaSchema_SearchIndex *search_indexes;
+  // nr_types * nr_types rules indexed by [child type][parent type]
+  struct SelvaSchema_AncestryRule *ancestry_rules;
+};
+
+// Returns the compiled schema or NULL if it hasn't been loaded yet
+struct SelvaSchema *SelvaSchema_Get(void);
+
+// Compile the schema stored in SCHEMA_KEY and recompute the default hierarchy
+int SelvaSchema_Load(RedisModuleCtx *ctx);
+
+static inline unsigned int SelvaSchema_GetTypeIndex(const struct SelvaSchema *schema, const char *id) {
+  if (!memcmp(id, "root", 5)) {
+    return SCHEMA_TYPE_ROOT;
+  }
+
+  return schema->prefix_to_type[(uint8_t)id[0] << 8 | (uint8_t)id[1]];
+}
+
+static inline const struct SelvaSchema_StrList *SelvaSchema_GetSugFields(const struct SelvaSchema *schema, const char *id) {
+  return &schema->sug_fields[SelvaSchema_GetTypeIndex(schema, id)];
+}
+
+static inline unsigned int SelvaSchema_GetTypeFlags(const struct SelvaSchema *schema, const char *id) {
+  return schema->type_flags[SelvaSchema_GetTypeIndex(schema, id)];
+}
+
+static inline const struct SelvaSchema_AncestryRule *SelvaSchema_GetAncestryRule(const struct SelvaSchema *schema, unsigned int child_type, unsigned int parent_type) {
+  return &schema->ancestry_rules[child_type * schema->nr_types + parent_type];
+}
+
+static inline int SelvaSchema_AncestryRuleHasType(const struct SelvaSchema_AncestryRule *rule, unsigned int type) {
+  return !!(rule->types[type / 64] & (UINT64_C(1) << (type % 64)));
+}
+
+static inline unsigned int SelvaSchema_GetSearchFlags(const struct SelvaSchema_SearchIndex *index, const char *field, size_t len) {
+  return (unsigned int)(uintptr_t)RedisModule_DictGetC(index->fields, (void *)field, len, NULL);
+}
+
+// The flags of a field in every search index
+static inline unsigned int SelvaSchema_GetFieldSearchFlags(const struct SelvaSchema *schema, const char *field, size_t len) {
+  unsigned int flags = 0;
+
+  for (size_t i = 0; i < schema->nr_search_indexes; i++) {
+    flags |= SelvaSchema_GetSearchFlags(&schema->search_indexes[i], field, len);
+  }
+
+  return flags;
+}
+
+int SelvaSchema_OnLoad(RedisModuleCtx *ctx);
+
+#endif /* SELVA_SCHEMA */
@@ -0,0 +1,168 @@
+#include <ctype.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../../redismodule.h"
+#include "../schema/schema.h"
+#include "./suggestion.h"
+
+// phrase -> intptr_t change of its count
+static RedisModuleDict *pending_sugs;
+
+int SelvaSuggestion_IsSugField(const char *id_str, const char *field_str, size_t field_len) {
+  const struct SelvaSchema *schema = SelvaSchema_Get();
+  size_t base_len = field_len;
+
+  while (base_len > 0 && field_str[base_len - 1] != '.') {
+    base_len--;
+  }
+  if (!schema || base_len-- == 0) {
+    return 0;
+  }
+
+  const char *lang = field_str + base_len + 1;
+  const size_t lang_len = field_len - base_len - 1;
+  const struct SelvaSchema_StrList *fields = SelvaSchema_GetSugFields(schema, id_str);
+  int found = 0;
+
+  for (size_t i = 0; i < fields->nr && !found; i++) {
+    found = strlen(fields->strs[i]) == base_len && !memcmp(fields->strs[i], field_str, base_len);
+  }
+  if (!found) {
+    return 0;
+  }
+
+  for (size_t i = 0; i < schema->languages.nr; i++) {
+    if (strlen(schema->languages.strs[i]) == lang_len && !memcmp(schema->languages.strs[i], lang, lang_len)) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+static void countPhrase(const char *phrase, size_t len, intptr_t delta) {
+  intptr_t count = (intptr_t)RedisModule_DictGetC(pending_sugs, (void *)phrase, len, NULL) + delta;
+
+  // A zero change is the same as no change, which keeps replaced words out of the flush
+  if (count == 0) {
+    RedisModule_DictDelC(pending_sugs, (void *)phrase, len, NULL);
+  } else {
+    RedisModule_DictReplaceC(pending_sugs, (void *)phrase, len, (void *)count);
+  }
+}
+
+static void countPhrases(RedisModuleString *value, intptr_t delta) {
+  size_t len;
+  const char *str = RedisModule_StringPtrLen(value, &len);
+  char *buf = RedisModule_Alloc(len + 1);
+  size_t n = 0;
+
+  // Lowercase and collapse the spaces so that the words are separated by exactly one
+  for (size_t i = 0; i < len; i++) {
+    if (str[i] != ' ') {
+      buf[n++] = (char)tolower((unsigned char)str[i]);
+    } else if (n > 0 && buf[n - 1] != ' ') {
+      buf[n++] = ' ';
+    }
+  }
+  if (n > 0 && buf[n - 1] == ' ') {
+    n--;
+  }
+
+  for (size_t i = 0, start = 0; i <= n; i++) {
+    if (i == n || buf[i] == ' ') {
+      if (i > start) {
+        countPhrase(buf + start, i - start, delta);
+        if (i < n) {
+          countPhrase(buf + start, n - start, delta);
+        }
+      }
+      start = i + 1;
+    }
+  }
+
+  RedisModule_Free(buf);
+}
+
+void SelvaSuggestion_Update(RedisModuleString *old_value, RedisModuleString *new_value) {
+  if (!pending_sugs) {
+    pending_sugs = RedisModule_CreateDict(NULL);
+  }
+
+  if (old_value) {
+    countPhrases(old_value, -1);
+  }
+  if (new_value) {
+    countPhrases(new_value, 1);
+  }
+}
+
+void SelvaSuggestion_Flush(RedisModuleCtx *ctx) {
+  RedisModuleDictIter *it;
+  char *phrase;
+  size_t len;
+  void *p;
+
+  if (!pending_sugs) {
+    return;
+  }
+
+  it = RedisModule_DictIteratorStartC(pending_sugs, "^", NULL, 0);
+  while ((phrase = RedisModule_DictNextC(it, &len, &p))) {
+    const long long delta = (intptr_t)p;
+    RedisModuleCallReply *reply = RedisModule_Call(ctx, "HINCRBY", "cbl", SELVA_SUGGESTION_COUNTS_KEY, phrase, len, delta);
+    long long count;
+
+    if (!reply || RedisModule_CallReplyType(reply) != REDISMODULE_REPLY_INTEGER) {
+      continue;
+    }
+
+    count = RedisModule_CallReplyInteger(reply);
+    if (count <= 0) {
+      RedisModule_Call(ctx, "HDEL", "cb", SELVA_SUGGESTION_COUNTS_KEY, phrase, len);
+      RedisModule_Call(ctx, "FT.SUGDEL", "cb", SELVA_SUGGESTION_DICT_KEY, phrase, len);
+    } else if (count == delta) {
+      RedisModule_Call(ctx, "FT.SUGADD", "cbc", SELVA_SUGGESTION_DICT_KEY, phrase, len, "1");
+    }
+  }
+  RedisModule_DictIteratorStop(it);
+
+  RedisModule_FreeDict(NULL, pending_sugs);
+  pending_sugs = NULL;
+}
+
+// [old_text new_text]...
+// An empty string stands for no text. Replies with the number of phrases whose count changed.
+int SelvaCommand_SuggestionUpdate(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  RedisModule_AutoMemory(ctx);
+
+  if (argc < 3 || (argc - 1) % 2) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  for (int i = 1; i < argc; i += 2) {
+    size_t old_len, new_len;
+
+    RedisModule_StringPtrLen(argv[i], &old_len);
+    RedisModule_StringPtrLen(argv[i + 1], &new_len);
+    SelvaSuggestion_Update(old_len > 0 ? argv[i] : NULL, new_len > 0 ? argv[i + 1] : NULL);
+  }
+
+  const long long nr_changed = pending_sugs ? (long long)RedisModule_DictSize(pending_sugs) : 0;
+
+  SelvaSuggestion_Flush(ctx);
+  if (nr_changed > 0) {
+    RedisModule_ReplicateVerbatim(ctx);
+  }
+
+  return RedisModule_ReplyWithLongLong(ctx, nr_changed);
+}
+
+int SelvaSuggestion_OnLoad(RedisModuleCtx *ctx) {
+  if (RedisModule_CreateCommand(ctx, "selva.suggestion.update", SelvaCommand_SuggestionUpdate, "write deny-oom", 0, 0, 0) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  return REDISMODULE_OK;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#ifndef SELVA_SUGGESTION
+#define SELVA_SUGGESTION
+
+#include <stddef.h>
+
+// phrase -> number of text values containing it
+#define SELVA_SUGGESTION_COUNTS_KEY "sug_counts"
+// The FT.SUGADD dictionary
+#define SELVA_SUGGESTION_DICT_KEY "sug"
+
+// Returns 1 if field is <field>.<lang> of a TEXT-LANGUAGE-SUG field of the type of id.
+int SelvaSuggestion_IsSugField(const char *id_str, const char *field_str, size_t field_len);
+
+// Queue the phrase count changes of a text value changing from old_value to
+// new_value. Either can be NULL. The phrases are the lowercased words and
+// every run of two or more words ending at the last word.
+void SelvaSuggestion_Update(RedisModuleString *old_value, RedisModuleString *new_value);
+
+// Apply the queued changes with one HINCRBY per phrase, adding phrases to the
+// dictionary when their count becomes positive and removing them when it drops to zero.
+void SelvaSuggestion_Flush(RedisModuleCtx *ctx);
+
+int SelvaSuggestion_OnLoad(RedisModuleCtx *ctx);
+
+#endif /* SELVA_SUGGESTION */
@@ -0,0 +1,209 @@
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#include "../../redismodule.h"
+#include "./typeindex.h"
+
+#define TYPE_SCAN_DEFAULT_COUNT 100
+
+// Node ids of every type by the type prefix; created on the first insert
+static RedisModuleDict *type_index[SELVA_TYPE_PREFIX_MAX];
+
+void SelvaTypeIndex_InitFilter(struct SelvaTypeIndex_Filter *filter) {
+  memset(filter, 0, sizeof(*filter));
+}
+
+int SelvaTypeIndex_FilterAdd(struct SelvaTypeIndex_Filter *filter, RedisModuleString *prefix) {
+  size_t len;
+  const char *str = RedisModule_StringPtrLen(prefix, &len);
+
+  if (len != SELVA_TYPE_PREFIX_SIZE) {
+    return REDISMODULE_ERR;
+  }
+
+  const unsigned int p = SelvaTypeIndex_Prefix(str);
+  filter->prefixes[p / 64] |= UINT64_C(1) << (p % 64);
+  filter->nr_types++;
+
+  return REDISMODULE_OK;
+}
+
+void SelvaTypeIndex_Add(const char *id, size_t len) {
+  if (len < SELVA_TYPE_PREFIX_SIZE || (len == 4 && !memcmp(id, "root", 4))) {
+    return;
+  }
+
+  const unsigned int prefix = SelvaTypeIndex_Prefix(id);
+  if (!type_index[prefix]) {
+    type_index[prefix] = RedisModule_CreateDict(NULL);
+  }
+
+  RedisModule_DictSetC(type_index[prefix], (void *)id, len, NULL);
+}
+
+void SelvaTypeIndex_Del(const char *id, size_t len) {
+  if (len < SELVA_TYPE_PREFIX_SIZE) {
+    return;
+  }
+
+  RedisModuleDict *d = type_index[SelvaTypeIndex_Prefix(id)];
+  if (d) {
+    RedisModule_DictDelC(d, (void *)id, len, NULL);
+  }
+}
+
+int SelvaTypeIndex_Has(const char *id, size_t len) {
+  int nokey = 1;
+
+  if (len < SELVA_TYPE_PREFIX_SIZE) {
+    return 0;
+  }
+
+  RedisModuleDict *d = type_index[SelvaTypeIndex_Prefix(id)];
+  if (d) {
+    RedisModule_DictGetC(d, (void *)id, len, &nokey);
+  }
+
+  return !nokey;
+}
+
+void SelvaTypeIndex_Clear(void) {
+  for (size_t i = 0; i < SELVA_TYPE_PREFIX_MAX; i++) {
+    if (type_index[i]) {
+      RedisModule_FreeDict(NULL, type_index[i]);
+      type_index[i] = NULL;
+    }
+  }
+}
+
+void SelvaTypeIndex_Foreach(SelvaTypeIndex_Callback cb, void *arg) {
+  for (size_t i = 0; i < SELVA_TYPE_PREFIX_MAX; i++) {
+    RedisModuleDictIter *it;
+    char *id;
+    size_t len;
+
+    if (!type_index[i]) {
+      continue;
+    }
+
+    it = RedisModule_DictIteratorStartC(type_index[i], "^", NULL, 0);
+    while ((id = RedisModule_DictNextC(it, &len, NULL))) {
+      cb(id, len, arg);
+    }
+    RedisModule_DictIteratorStop(it);
+  }
+}
+
+// SELVA.TYPE.FILTER prefixes id [id ...]
+// prefixes is a concatenation of two byte type prefixes. Replies with the
+// ids that exist and are of one of the given types.
+int SelvaCommand_TypeFilter(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  struct SelvaTypeIndex_Filter filter;
+  size_t len;
+
+  if (argc < 2) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  const char *prefixes = RedisModule_StringPtrLen(argv[1], &len);
+  if (len == 0 || len % SELVA_TYPE_PREFIX_SIZE) {
+    return RedisModule_ReplyWithError(ctx, "ERR invalid type prefixes");
+  }
+
+  SelvaTypeIndex_InitFilter(&filter);
+  for (size_t i = 0; i < len; i += SELVA_TYPE_PREFIX_SIZE) {
+    const unsigned int p = SelvaTypeIndex_Prefix(prefixes + i);
+
+    filter.prefixes[p / 64] |= UINT64_C(1) << (p % 64);
+    filter.nr_types++;
+  }
+
+  long nr_ids = 0;
+  RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
+  for (int i = 2; i < argc; i++) {
+    const char *id = RedisModule_StringPtrLen(argv[i], &len);
+
+    if (len >= SELVA_TYPE_PREFIX_SIZE && SelvaTypeIndex_FilterMatches(&filter, id) && SelvaTypeIndex_Has(id, len)) {
+      RedisModule_ReplyWithString(ctx, argv[i]);
+      nr_ids++;
+    }
+  }
+  RedisModule_ReplySetArrayLength(ctx, nr_ids);
+
+  return REDISMODULE_OK;
+}
+
+// SELVA.TYPE.SCAN prefix cursor [COUNT n]
+// Iterates the ids of a type in id order. Like SCAN the reply is
+// [cursor, [ids]]. The cursor is the last id of the reply, "0" starts a new
+// scan and is returned when it's complete.
+int SelvaCommand_TypeScan(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  long long count = TYPE_SCAN_DEFAULT_COUNT;
+  size_t prefix_len, cursor_len;
+
+  if (argc != 3 && argc != 5) {
+    return RedisModule_WrongArity(ctx);
+  }
+
+  const char *prefix = RedisModule_StringPtrLen(argv[1], &prefix_len);
+  const char *cursor = RedisModule_StringPtrLen(argv[2], &cursor_len);
+  if (prefix_len != SELVA_TYPE_PREFIX_SIZE) {
+    return RedisModule_ReplyWithError(ctx, "ERR invalid type prefix");
+  }
+
+  if (argc == 5) {
+    if (strcasecmp(RedisModule_StringPtrLen(argv[3], NULL), "COUNT") ||
+        RedisModule_StringToLongLong(argv[4], &count) == REDISMODULE_ERR || count <= 0) {
+      return RedisModule_ReplyWithError(ctx, "ERR invalid count");
+    }
+  }
+
+  RedisModuleDict *d = type_index[SelvaTypeIndex_Prefix(prefix)];
+  if (!d) {
+    RedisModule_ReplyWithArray(ctx, 2);
+    RedisModule_ReplyWithSimpleString(ctx, "0");
+    return RedisModule_ReplyWithArray(ctx, 0);
+  }
+
+  const int start = cursor_len == 1 && cursor[0] == '0';
+  RedisModuleDictIter *it = RedisModule_DictIteratorStartC(d, start ? "^" : ">", (void *)cursor, cursor_len);
+  const size_t max = (uint64_t)count < RedisModule_DictSize(d) ? (size_t)count : RedisModule_DictSize(d);
+  // The iterator reuses its key buffer so the ids are copied
+  char **ids = RedisModule_PoolAlloc(ctx, max * sizeof(char *) + 1);
+  size_t *ids_len = RedisModule_PoolAlloc(ctx, max * sizeof(size_t) + 1);
+  size_t n = 0;
+  char *id;
+  size_t id_len;
+
+  while (n < max && (id = RedisModule_DictNextC(it, &id_len, NULL))) {
+    ids[n] = RedisModule_PoolAlloc(ctx, id_len + 1);
+    memcpy(ids[n], id, id_len);
+    ids_len[n] = id_len;
+    n++;
+  }
+  const int more = n > 0 && RedisModule_DictNextC(it, NULL, NULL) != NULL;
+  RedisModule_DictIteratorStop(it);
+
+  RedisModule_ReplyWithArray(ctx, 2);
+  if (more) {
+    RedisModule_ReplyWithStringBuffer(ctx, ids[n - 1], ids_len[n - 1]);
+  } else {
+    RedisModule_ReplyWithSimpleString(ctx, "0");
+  }
+  RedisModule_ReplyWithArray(ctx, n);
+  for (size_t i = 0; i < n; i++) {
+    RedisModule_ReplyWithStringBuffer(ctx, ids[i], ids_len[i]);
+  }
+
+  return REDISMODULE_OK;
+}
+
+int SelvaTypeIndex_OnLoad(RedisModuleCtx *ctx) {
+  if (RedisModule_CreateCommand(ctx, "selva.type.filter", SelvaCommand_TypeFilter, "readonly", 0, 0, 0) == REDISMODULE_ERR ||
+      RedisModule_CreateCommand(ctx, "selva.type.scan", SelvaCommand_TypeScan, "readonly", 0, 0, 0) == REDISMODULE_ERR) {
+    return REDISMODULE_ERR;
+  }
+
+  return REDISMODULE_OK;
+}
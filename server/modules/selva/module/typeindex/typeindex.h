@@ -0,0 +1,42 @@
+#pragma once
+#ifndef SELVA_TYPEINDEX
+#define SELVA_TYPEINDEX
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SELVA_TYPE_PREFIX_SIZE 2
+#define SELVA_TYPE_PREFIX_MAX (1 << 16)
+
+// A set of type prefixes tested with a single bit lookup per id
+struct SelvaTypeIndex_Filter {
+  size_t nr_types;
+  uint64_t prefixes[SELVA_TYPE_PREFIX_MAX / 64];
+};
+
+static inline unsigned int SelvaTypeIndex_Prefix(const char *id) {
+  return (uint8_t)id[0] << 8 | (uint8_t)id[1];
+}
+
+void SelvaTypeIndex_InitFilter(struct SelvaTypeIndex_Filter *filter);
+int SelvaTypeIndex_FilterAdd(struct SelvaTypeIndex_Filter *filter, RedisModuleString *prefix);
+
+// An empty filter matches everything
+static inline int SelvaTypeIndex_FilterMatches(const struct SelvaTypeIndex_Filter *filter, const char *id) {
+  const unsigned int prefix = SelvaTypeIndex_Prefix(id);
+
+  return filter->nr_types == 0 || (filter->prefixes[prefix / 64] & (UINT64_C(1) << (prefix % 64)));
+}
+
+void SelvaTypeIndex_Add(const char *id, size_t len);
+void SelvaTypeIndex_Del(const char *id, size_t len);
+int SelvaTypeIndex_Has(const char *id, size_t len);
+void SelvaTypeIndex_Clear(void);
+
+// Visit every indexed node id, type by type
+typedef void (*SelvaTypeIndex_Callback)(const char *id, size_t len, void *arg);
+void SelvaTypeIndex_Foreach(SelvaTypeIndex_Callback cb, void *arg);
+
+int SelvaTypeIndex_OnLoad(RedisModuleCtx *ctx);
+
+#endif /* SELVA_TYPEINDEX */
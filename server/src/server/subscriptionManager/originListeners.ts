@@ -2,12 +2,12 @@ import { SubscriptionManager, Subscription } from './types'
 import { constants } from '@saulx/selva'
 import traverseTree from './update/traverseTree'
 import addUpdate from './update/addUpdate'
+import parseEvent from './update/parseEvent'
 import { ServerSelector } from '@saulx/selva/dist/src/types'
 
 const { EVENTS } = constants
 
 const prefixLength = EVENTS.length
-const deleteLength = 'delete:'.length
 
 // pass subscription
 const addOriginListeners = async (
@@ -34,16 +34,10 @@ const addOriginListeners = async (
         }
       } else {
         const eventName = channel.slice(prefixLength)
+        const event = message && parseEvent(message)
 
-        // make this batch as well (the check)
-        if (message === 'update') {
-          traverseTree(subsManager, eventName, name)
-        } else if (message && message.startsWith('delete')) {
-          const fields = message.slice(deleteLength).split(',')
-
-          fields.forEach((v: string) => {
-            traverseTree(subsManager, eventName + '.' + v, name)
-          })
+        if (event) {
+          traverseTree(subsManager, eventName, name, event.fields)
         }
       }
 
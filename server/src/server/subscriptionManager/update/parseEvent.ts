@@ -0,0 +1,23 @@
+export type Event = {
+  type: 'update' | 'delete'
+  fields: string[]
+}
+
+// Messages on ___selva_events:<id> list the changed fields of the node
+// after the type, e.g. 'update:title,children'. A bare type has no fields,
+// the field is in the channel instead.
+const parseEvent = (message: string): Event | undefined => {
+  const i = message.indexOf(':')
+  const type = i === -1 ? message : message.slice(0, i)
+
+  if (type !== 'update' && type !== 'delete') {
+    return
+  }
+
+  return {
+    type,
+    fields: i === -1 ? [] : message.slice(i + 1).split(',')
+  }
+}
+
+export default parseEvent
@@ -1,75 +1,103 @@
-import { SubscriptionManager } from '../types'
+import { SubscriptionManager, Subscription } from '../types'
 import addUpdate from './addUpdate'
 import contains from './contains'
 
+// Walks the tree of dbName once for all changed fields of a node. The
+// channel is the node id, optionally followed by a field path when the
+// event has no field list. Segments shared by several fields are visited
+// once, and every subscription and contains check is triggered once.
 const traverse = (
   subscriptionManager: SubscriptionManager,
   channel: string,
-  dbName: string
+  dbName: string,
+  fields: string[] = []
 ) => {
-  const path = channel.split('.')
-  const id = path[0]
-  if (
-    subscriptionManager.memberMemCache[dbName] &&
-    subscriptionManager.memberMemCache[dbName][channel]
-  ) {
-    delete subscriptionManager.memberMemCache[dbName][channel]
-    subscriptionManager.memberMemCacheSize--
+  const base = channel.split('.')
+  const id = base[0]
+  const paths: string[][] = []
+
+  if (fields.length === 0) {
+    paths.push(base)
+  } else {
+    for (const field of fields) {
+      paths.push(base.concat(field.split('.')))
+    }
   }
 
-  let segment = subscriptionManager.tree[dbName]
-  if (!segment) {
+  const memCache = subscriptionManager.memberMemCache[dbName]
+  if (memCache) {
+    for (const path of paths) {
+      const key = path.join('.')
+      if (memCache[key]) {
+        delete memCache[key]
+        subscriptionManager.memberMemCacheSize--
+      }
+    }
+  }
+
+  const root = subscriptionManager.tree[dbName]
+  if (!root) {
     return
   }
 
-  let prefix: string | undefined
-  for (let i = 1; i < path.length; i++) {
-    segment = segment[path[i]]
-    if (segment) {
+  const prefix = id.slice(0, 2)
+  const visited = new Set()
+  const updates: Set<Subscription> = new Set()
+  const containsChecks: Record<string, any> = {}
+
+  for (const path of paths) {
+    let segment = root
+    for (let i = 1; i < path.length; i++) {
+      segment = segment[path[i]]
+      if (!segment) {
+        break
+      }
+      if (visited.has(segment)) {
+        continue
+      }
+      visited.add(segment)
+
       if (segment.___ids) {
         const subs = segment.___ids[id]
         if (subs) {
           subs.forEach(subscription => {
-            if (!subscription.inProgress) {
-              // @ts-ignore
-              addUpdate(subscriptionManager, subscription)
-            }
+            updates.add(subscription)
           })
         }
       }
 
       if (segment.___types) {
-        if (!prefix) {
-          prefix = id.slice(0, 2)
-        }
         const match = segment.___types[prefix]
-
         if (match) {
-          for (let containsId in match) {
-            contains(
-              subscriptionManager,
-              containsId,
-              { id, db: dbName },
-              match[containsId]
-            )
+          for (const containsId in match) {
+            containsChecks[containsId] = match[containsId]
           }
         }
       }
+
       if (segment.__any) {
-        // @ts-ignore
-        for (let containsId in segment.__any) {
-          contains(
-            subscriptionManager,
-            containsId,
-            { id, db: dbName },
-            segment.__any[containsId]
-          )
+        for (const containsId in segment.__any) {
+          containsChecks[containsId] = segment.__any[containsId]
         }
       }
-    } else {
-      break
     }
   }
+
+  updates.forEach(subscription => {
+    if (!subscription.inProgress) {
+      // @ts-ignore
+      addUpdate(subscriptionManager, subscription)
+    }
+  })
+
+  for (const containsId in containsChecks) {
+    contains(
+      subscriptionManager,
+      containsId,
+      { id, db: dbName },
+      containsChecks[containsId]
+    )
+  }
 }
 
 export default traverse